@@ -0,0 +1,357 @@
+/**
+ * @file async.hpp
+ * Asynchronous parsing. \b Executor is a small pool of worker threads
+ * working off a queue of tasks. \b AsyncParser runs parses on such a pool
+ * and hands out a std::future for every sentence. A parse never occupies a
+ * worker for more than a fixed number of chart cells at a time: after that
+ * it is put back at the end of the queue, so that many long and short
+ * sentences interleave on few threads. An event loop can either poll the
+ * future or have a callback invoked once the result is available.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __ASYNC__HPP
+#define __ASYNC__HPP
+
+#include "declarations.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tokenizer.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  Executor                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief fixed size pool of worker threads executing tasks in the order
+ *        they were posted
+ */
+class Executor
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef std::function<void()>                                              Task;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief starts @p threads worker threads
+     * @param threads number of workers; 0 selects the number of cores
+     */
+    explicit Executor(unsigned threads=0)
+    :stopped(false)
+    {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            workers.push_back(std::thread(&Executor::work, this));
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// stops the workers; tasks still queued are dropped
+    ~Executor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        wakeup.notify_all();
+        for (auto w = workers.begin(); w != workers.end(); ++w) w->join();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// appends @p task to the queue
+    void post(Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wakeup.notify_one();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of tasks waiting to be executed
+    std::size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tasks.size();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of worker threads
+    std::size_t size() const
+    {
+        return workers.size();
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// worker loop; takes tasks from the front of the queue until stopped
+    void work()
+    {
+        for (;;)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this]{ return stopped || !tasks.empty(); });
+                if (stopped) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::vector<std::thread> workers;   ///< worker threads
+    std::deque<Task> tasks;             ///< tasks waiting to be executed
+    std::mutex mutex;                   ///< guards \b tasks and \b stopped
+    std::condition_variable wakeup;     ///< signals new tasks or stopping
+    bool stopped;                       ///< set when the pool shuts down
+////////////////////////////////////////////////////////////////////////////////
+}; // Executor
+
+////////////////////////////////////////////////////////////////////////////////
+/// thrown through the future of a parse that has been cancelled
+struct ParseCancelled : public std::exception
+{
+    const char* what() const throw() { return "parse cancelled"; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                 AsyncParser                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief runs parses of a parser type @p PARSER on an \b Executor
+ * @details every request gets its own copy of a prototype parser, hence
+ *          its own chart on the shared grammar. A request is processed
+ *          \b slice chart cells at a time, then it yields its worker.
+ * @tparam PARSER parser type, e.g. \b Earley::EarleyParser<GRAMMAR>
+ */
+template <typename PARSER>
+class AsyncParser
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef PARSER                                                           Parser;
+typedef typename Parser::Grammar::ESVec                                   ESVec;
+/// tokens pointing into text owned by the caller
+typedef std::vector<helper::StrView>                                     Tokens;
+/// sentence of a binary corpus
+typedef typename Parser::Corpus::Sentence                        CorpusSentence;
+/// called with the result once a parse has finished
+typedef std::function<void(bool)>                                      Callback;
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+    /// state of a single request
+    struct Job
+    {
+        Job(const Parser& p, ESVec s, Tokens t, CorpusSentence c, Callback cb)
+        :parser(p), sentence(std::move(s)), tokens(std::move(t)), indexed(c),
+         callback(std::move(cb)), started(false), finished(false),
+         cancelled(false)
+        {
+        }
+
+        Parser parser;                ///< private copy of the prototype
+        ESVec sentence;               ///< sentence to parse, or
+        Tokens tokens;                ///< tokens to parse, if not empty, or
+        CorpusSentence indexed;       ///< sentence to parse, if from a corpus
+        Callback callback;            ///< may be empty
+        std::promise<bool> result;    ///< fulfilled when finished
+        std::mutex mutex;             ///< held while the job is worked on
+        bool started;                 ///< whether begin() has been called
+        bool finished;                ///< whether \b result has been set
+        std::atomic<bool> cancelled;  ///< set by Request::cancel()
+    };
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC TYPES
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief handle for a submitted sentence
+     */
+    class Request
+    {
+    public:
+        Request() {}
+        explicit Request(std::shared_ptr<Job> j)
+        :job(j), future(j->result.get_future().share())
+        {
+        }
+        /// @returns true, if the result is available
+        bool ready() const
+        {
+            return future.wait_for(std::chrono::seconds(0)) ==
+                   std::future_status::ready;
+        }
+        /// waits for and @returns the result; throws \b ParseCancelled if
+        /// the request has been cancelled
+        bool get() const { return future.get(); }
+        /// @returns the future of the result
+        const std::shared_future<bool>& get_future() const { return future; }
+        /**
+         * @brief cancels the parse. If no worker is on the request right
+         *        now its chart is freed before returning, otherwise the
+         *        worker frees it after the current slice.
+         */
+        void cancel()
+        {
+            if (!job) return;
+            job->cancelled = true;
+            std::unique_lock<std::mutex> lock(job->mutex, std::try_to_lock);
+            if (lock.owns_lock()) AsyncParser::abort(*job);
+        }
+    private:
+        std::shared_ptr<Job> job;
+        std::shared_future<bool> future;
+    };
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs an asynchronous parser
+     * @param prototype parser every request gets a copy of
+     * @param threads number of worker threads; 0 selects the number of cores
+     * @param slice number of chart cells processed before a request yields
+     */
+    AsyncParser(const Parser& prototype, unsigned threads=0, unsigned slice=4)
+    :prototype(prototype),
+    slice(slice > 0 ? slice : 1),
+    executor(threads)
+    {
+        // parsers on different threads must not draw busy indicators
+        this->prototype.set_busy_indicator(false);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief submits @p sentence for parsing
+     * @param sentence the tokens to parse
+     * @param callback if set, is called on a worker thread with the result
+     */
+    Request parse(ESVec sentence, Callback callback=Callback())
+    {
+        std::shared_ptr<Job> job(new Job(prototype, std::move(sentence), Tokens(),
+                                          CorpusSentence(), std::move(callback)));
+        Request request(job);
+        schedule(job);
+        return request;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief submits @p tokens for parsing without copying the text they
+     *        point to, which must stay valid until the request has finished
+     * @param tokens the tokens to parse
+     * @param callback if set, is called on a worker thread with the result
+     */
+    Request parse(Tokens tokens, Callback callback=Callback())
+    {
+        std::shared_ptr<Job> job(new Job(prototype, ESVec(), std::move(tokens),
+                                          CorpusSentence(), std::move(callback)));
+        Request request(job);
+        schedule(job);
+        return request;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief submits sentence @p s of a binary corpus for parsing; the
+     *        corpus must stay open until the request has finished
+     * @param s the sentence to parse
+     * @param callback if set, is called on a worker thread with the result
+     */
+    Request parse(const CorpusSentence& s, Callback callback=Callback())
+    {
+        std::shared_ptr<Job> job(new Job(prototype, ESVec(), Tokens(), s,
+                                          std::move(callback)));
+        Request request(job);
+        schedule(job);
+        return request;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of slices waiting for a worker
+    std::size_t pending()
+    {
+        return executor.pending();
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// puts the next slice of @p job into the queue of the executor
+    void schedule(std::shared_ptr<Job> job)
+    {
+        executor.post([this, job]{ run(job); });
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// processes one slice of @p job and reschedules it, if unfinished
+    void run(std::shared_ptr<Job> job)
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        if (job->finished) return;
+        if (job->cancelled) { abort(*job); return; }
+        if (!job->started)
+        {
+            if (job->indexed.corpus) job->parser.begin(job->indexed);
+            else if (job->tokens.empty()) job->parser.begin(job->sentence);
+            else job->parser.begin(job->tokens.data(), job->tokens.size());
+            job->started = true;
+        }
+        if (!job->parser.advance(slice))
+        {
+            schedule(job);
+            return;
+        }
+        bool accepted = job->parser.accepted();
+        job->parser.release();
+        job->finished = true;
+        job->result.set_value(accepted);
+        if (job->callback) job->callback(accepted);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// frees the chart of @p job and fails its future
+    /// @pre requires the mutex of @p job to be held
+    static void abort(Job& job)
+    {
+        if (job.finished) return;
+        job.parser.release();
+        ESVec().swap(job.sentence);
+        Tokens().swap(job.tokens);
+        job.finished = true;
+        job.result.set_exception(std::make_exception_ptr(ParseCancelled()));
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    Parser prototype;        ///< copied for every request
+    const unsigned slice;    ///< chart cells per slice
+    Executor executor;       ///< worker threads; destroyed first
+////////////////////////////////////////////////////////////////////////////////
+}; // AsyncParser
+
+} // Earley
+
+#endif // __ASYNC__HPP
@@ -13,8 +13,11 @@
 #ifndef __BUSY__HPP
 #define __BUSY__HPP
 
+#include <memory>
+
 #include "helper.hpp"
 #include "declarations.hpp"
+#include "render.hpp"
 
 namespace BUSY
 {
@@ -69,11 +72,7 @@ public:                                                     //    PUBLIC METHODS
     void cancel(sost& o=std::cerr)
     {
         // do not display anything, if stdout is redirected to a file
-        #ifdef _WIN32
-        if (!_isatty(_fileno(stdout))) return;
-        #else
-        if (!isatty(fileno(stdout))) return;
-        #endif
+        if (!helper::stdout_is_terminal()) return;
         blank_line(o);
         #ifdef UNIXLIKE
         o << "\e[?25h";
@@ -90,48 +89,64 @@ public:                                                     //    PUBLIC METHODS
                     sost& o=std::cerr)
     {
         // do not display anything, if stdout is redirected to a file
-        #ifdef _WIN32
-        if (!_isatty(_fileno(stdout))) return;
-        #else
-        if (!isatty(fileno(stdout))) return;
-        #endif
+        if (!helper::stdout_is_terminal()) return;
         // if an interval is over, update
         if(tick == interval)
         {
-            #ifdef UNIXLIKE
-            o << "\e[?25l";
-            #endif
-            // if moving right
-            if(right)
+            advance(cf, cb, tfl, tfr, tbl, tbr, o);
+            tick = 0;
+        }
+        ++tick;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// draws the next frame of the indicator bar, regardless of \b tick;
+    /// used by a render thread that draws at a fixed rate
+    virtual void step(sost& o=std::cerr) = 0;
+////////////////////////////////////////////////////////////////////////////////
+    virtual ~BusyBar()
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+protected:                                                  // PROTECTED METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// moves the indicator bar by one position
+    template <typename T>
+    void advance(const T& cf , const T& cb,
+                 const T& tfl, const T& tfr,
+                 const T& tbl, const T& tbr,
+                 sost& o=std::cerr)
+    {
+        #ifdef UNIXLIKE
+        o << "\e[?25l";
+        #endif
+        // if moving right
+        if(right)
+        {
+            // test whether the is still capacity left for 1 more update
+            if(capacity-occupied >= 1)
             {
-                // test whether the is still capacity left for 1 more update
-                if(capacity-occupied >= 1)
-                {
-                    // if so, update
-                    next(tfl, cf, tfr, ocup);
-                }
-                // if not blank the line and reverse the direction
-                else { blank_line(o); right = false; }
+                // if so, update
+                next(tfl, cf, tfr, ocup);
             }
-            // if moving left
-            if(!right)
+            // if not blank the line and reverse the direction
+            else { blank_line(o); right = false; }
+        }
+        // if moving left
+        if(!right)
+        {
+            // test whether the is still capacity left for 1 more update
+            if(occupied-1 >= 0)
             {
-                // test whether the is still capacity left for 1 more update
-                if(occupied-1 >= 0)
-                {
-                    // if so, update
-                    next(tbl, cb, tbr, ocdown);
-                }
-                // if not blank the line and reverse the direction
-                else
-                {
-                    blank_line(o); right = true;
-                    next(tfl, cf, tfr, ocup);
-                }
+                // if so, update
+                next(tbl, cb, tbr, ocdown);
+            }
+            // if not blank the line and reverse the direction
+            else
+            {
+                blank_line(o); right = true;
+                next(tfl, cf, tfr, ocup);
             }
-            tick = 0;
         }
-        ++tick;
     }
 ////////////////////////////////////////////////////////////////////////////////
 private:                                                    //   PRIVATE METHODS
@@ -313,6 +328,11 @@ public:                                                     //   PUBCLIC METHODS
     {
         BusyBar::run(s2,s1,s3,s3,s3,s3);
     }
+////////////////////////////////////////////////////////////////////////////////
+    virtual void step(sost& o=std::cerr)
+    {
+        advance(s2,s1,s3,s3,s3,s3,o);
+    }
 ////////////////////////////////////////////////////////////////////////////////
 private:                                                    //   PRIVATE METHODS
 ////////////////////////////////////////////////////////////////////////////////
@@ -381,6 +401,11 @@ public:                                                     //    PUBLIC METHODS
     {
         BusyBar::run(s2,s2,s1,s3,s1,s3);
     }
+////////////////////////////////////////////////////////////////////////////////
+    virtual void step(sost& o=std::cerr)
+    {
+        advance(s2,s2,s1,s3,s1,s3,o);
+    }
 ////////////////////////////////////////////////////////////////////////////////
 private:                                                    //   PRIVATE METHODS
 ////////////////////////////////////////////////////////////////////////////////
@@ -412,6 +437,103 @@ private:                                                    //   PRIVATE METHODS
 ////////////////////////////////////////////////////////////////////////////////
 };
 
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  Indicator                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief busy indicator for a loop that only counts its steps through
+ *        tick(); the bar is moved by a render thread at a fixed rate, as
+ *        long as the count changes
+ * @tparam BAR indicator bar, \b Variant1 or \b Variant2
+ */
+template <typename BAR>
+class Indicator
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                     //    PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// constructs indicator drawing @p hz frames per second once started
+    explicit Indicator(unsigned hz=10)
+    :hz(hz),
+    drawn(0),
+    shown(false),
+    renderer(hz)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// copies get an indicator of their own, which has not been started
+    Indicator(const Indicator& i)
+    :Indicator(i.hz)
+    {
+    }
+
+    Indicator& operator=(const Indicator&)
+    {
+        return *this;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// stops the render thread and clears the line
+    ~Indicator()
+    {
+        renderer.stop();
+        if (shown) bar->cancel();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the indicator can be shown at all; false, if
+    /// stdout is not a terminal
+    static bool available()
+    {
+        return helper::stdout_is_terminal();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// counts a step of the loop; only to be called by one thread
+    void tick()
+    {
+        counter.add();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// starts the render thread, unless it runs already or the indicator
+    /// is not available
+    void start()
+    {
+        if (renderer.running() || !available()) return;
+        if (!bar) bar.reset(new BAR);
+        renderer.start([this]()
+        {
+            unsigned long n = counter.get();
+            if (n == drawn) return;   // the loop is idle
+            drawn = n;
+            bar->step();
+            shown = true;
+        });
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// clears the line, e.g. before output is written; the bar shows up
+    /// again once the loop counts again
+    void pause()
+    {
+        if (!renderer.running()) return;
+        renderer.locked([this]()
+        {
+            if (shown) bar->cancel();
+            shown = false;
+            drawn = counter.get();
+        });
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                    //    PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    unsigned hz;                   ///< frames per second
+    RENDER::Counter counter;       ///< steps of the loop
+    unsigned long drawn;           ///< \b counter at the last frame
+    bool shown;                    ///< whether the bar is on the line
+    std::unique_ptr<BAR> bar;      ///< the bar, once started
+    RENDER::Renderer renderer;     ///< draws \b bar; destroyed first
+////////////////////////////////////////////////////////////////////////////////
+}; // Indicator
+
 } // BUSY
 
 #endif // __BUSY__HPP
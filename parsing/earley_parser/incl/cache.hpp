@@ -0,0 +1,352 @@
+/**
+ * @file cache.hpp
+ * Cache of recognition results. Whether a sentence is recognised depends
+ * only on the ambiguity classes of its words, not on the words, so many
+ * sentences share a result. \b ResultCache holds the results of the most
+ * recently parsed class sequences, their signatures, for any number of
+ * parsers at once, and can be saved to a file and loaded in the next run.
+ *
+ * A saved cache starts with a \b ResultCacheHeader followed by a record
+ * [length, result, classes...] of 32 bit numbers for every signature, the
+ * least recently used first. The results are valid for the rules of one
+ * grammar and the ambiguity classes of one lexicon only; a cache saved with
+ * others is refused by its fingerprint.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __CACHE__HPP
+#define __CACHE__HPP
+
+#include "declarations.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "helper.hpp"
+#include "grammar.hpp"
+#include "mapped.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+/// ambiguity class of every word of a sentence; Lexicon::none() for
+/// unknown words
+typedef std::vector<std::uint32_t>                                    Signature;
+
+/// header of a saved result cache
+struct ResultCacheHeader
+{
+    char magic[8];                 ///< "EARLEYR" and the byte order mark
+    std::uint32_t version;         ///< format version, see \b current()
+    std::uint32_t header_size;     ///< sizeof(ResultCacheHeader)
+    std::uint64_t size;            ///< size of the whole file in bytes
+    std::uint64_t checksum;        ///< FNV-1a of all bytes after the header
+    std::uint64_t fingerprint;     ///< see \b ResultCache::fingerprint()
+    std::uint64_t entry_count;     ///< number of records
+
+    /// @returns version of the format written by this code
+    static std::uint32_t current() { return 1; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                 ResultCache                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief bounded LRU cache of recognition results by signature
+ * @details the signatures are spread over shards by their hash; every shard
+ *          has a lock of its own and evicts its least recently used entry
+ *          once it holds its share of the capacity. Any number of threads
+ *          may use the cache at once.
+ */
+class ResultCache
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs cache holding up to about @p capacity results in
+     *        @p shard_count shards
+     */
+    explicit ResultCache(std::size_t capacity=1 << 16, unsigned shard_count=16)
+    :shards(shard_count > 0 ? shard_count : 1),
+    shard_capacity(std::max<std::size_t>(1, capacity / shards.size())),
+    hit_count(0),
+    miss_count(0)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief looks up signature @p s
+     * @param result set to the result of @p s, if found
+     * @return true, if found
+     */
+    bool find(const Signature& s, bool& result)
+    {
+        Shard& shard = shard_of(s);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto e = shard.index.find(s);
+        if (e == shard.index.end())
+        {
+            miss_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // the entry becomes the most recently used one
+        shard.order.splice(shard.order.begin(), shard.order, e->second);
+        result = e->second->second;
+        hit_count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// stores @p result for signature @p s
+    void insert(const Signature& s, bool result)
+    {
+        Shard& shard = shard_of(s);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto e = shard.index.find(s);
+        if (e != shard.index.end())
+        {
+            e->second->second = result;
+            shard.order.splice(shard.order.begin(), shard.order, e->second);
+            return;
+        }
+        shard.order.push_front(Entry(s, result));
+        shard.index.insert(std::make_pair(s, shard.order.begin()));
+        if (shard.order.size() > shard_capacity)
+        {
+            shard.index.erase(shard.order.back().first);
+            shard.order.pop_back();
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of signatures found by find()
+    std::uint64_t hits() const
+    {
+        return hit_count.load(std::memory_order_relaxed);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of signatures not found by find()
+    std::uint64_t misses() const
+    {
+        return miss_count.load(std::memory_order_relaxed);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of results held
+    std::size_t size() const
+    {
+        std::size_t n = 0;
+        for (auto s = shards.begin(); s != shards.end(); ++s)
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            n += s->order.size();
+        }
+        return n;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief fingerprint of what the results depend on: the rules of
+     *        grammar @p g, the tags of @p lexicon and the tags of every
+     *        ambiguity class
+     */
+    template <typename GRAMMAR, typename LEXICON>
+    static std::uint64_t fingerprint(const GRAMMAR& g, const LEXICON& lexicon)
+    {
+        std::uint64_t h = MappedFile::checksum(nullptr, 0);
+        auto add = [&h](const sstr& s)
+        {
+            h = MappedFile::checksum(s.data(), s.size()+1, h);
+        };
+        #if SOVERLOAD
+        add("SOVERLOAD");
+        #endif
+        auto add_rule = [&](const typename GRAMMAR::Sym* r)
+        {
+            add(g.translate(GRAMMAR::lhs(r)));
+            for (unsigned i = 0; i < GRAMMAR::length(r); ++i) add(g.translate(GRAMMAR::rhs(r)[i]));
+            add("\n");
+        };
+        add_rule(g.start_rule());
+        for (std::size_t s = 0; s < g.symbol_count(); ++s)
+        {
+            auto range = g.rules_for(s);
+            for (auto r = range.first; r != range.second; ++r) add_rule(g.rule(*r));
+        }
+        const auto& tags = lexicon.get_tags();
+        for (auto t = tags.begin(); t != tags.end(); ++t) add(g.translate(*t));
+        for (std::size_t c = 0; c < lexicon.class_count(); ++c)
+        {
+            const auto& ct = lexicon.get_class_tags(c);
+            for (auto t = ct.begin(); t != ct.end(); ++t) add(g.translate(*t));
+            add("\n");
+        }
+        return h;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief writes the results to @p path, for a grammar and lexicon of
+     *        fingerprint @p fingerprint. The file is replaced in one step.
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void save(const sstr& path, std::uint64_t fingerprint) const
+    {
+        std::vector<std::uint32_t> records;
+        ResultCacheHeader h;
+        std::memset(&h, 0, sizeof h);
+        for (auto s = shards.begin(); s != shards.end(); ++s)
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            for (auto e = s->order.rbegin(); e != s->order.rend(); ++e)
+            {
+                records.push_back(e->first.size());
+                records.push_back(e->second ? 1 : 0);
+                records.insert(records.end(), e->first.begin(), e->first.end());
+                ++h.entry_count;
+            }
+        }
+        const char* p = reinterpret_cast<const char*>(records.data());
+        std::size_t n = records.size()*sizeof(std::uint32_t);
+        MappedFile::magic(h.magic, "EARLEYR");
+        h.version = ResultCacheHeader::current();
+        h.header_size = sizeof h;
+        h.size = sizeof h + n;
+        h.checksum = MappedFile::checksum(p, n);
+        h.fingerprint = fingerprint;
+
+        sstr temp = path+".tmp";
+        {
+            std::ofstream f(temp, std::ios::binary | std::ios::trunc);
+            f.write(reinterpret_cast<const char*>(&h), sizeof h);
+            f.write(p, n);
+            if (!f) throw std::runtime_error("failed to write '"+temp+"'");
+        }
+        if (std::rename(temp.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temp.c_str());
+            throw std::runtime_error("failed to replace '"+path+"'");
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief adds the results saved in @p path
+     * @param fingerprint fingerprint of the grammar and lexicon in use
+     * @return number of results read
+     * @throws LoadError if @p path cannot be read, is no valid result cache
+     *         or has been saved for another grammar or lexicon
+     */
+    std::size_t load(const sstr& path, std::uint64_t fingerprint)
+    {
+        MappedFile file(path);
+        const char* data = file.data();
+        const ResultCacheHeader* h = reinterpret_cast<const ResultCacheHeader*>(data);
+        char m[8];
+        MappedFile::magic(m, "EARLEYR");
+        if (file.size() < sizeof *h || std::memcmp(h->magic, "EARLEYR", 7) != 0)
+        {
+            throw LoadError("'"+path+"' is no result cache");
+        }
+        if (std::memcmp(h->magic, m, 8) != 0)
+        {
+            throw LoadError("'"+path+"' has been saved on a machine of "
+                            "different byte order");
+        }
+        if (h->version != ResultCacheHeader::current() || h->header_size != sizeof *h)
+        {
+            throw LoadError("'"+path+"' has cache version "+
+                            helper::to_string(h->version)+", expected "+
+                            helper::to_string(ResultCacheHeader::current()));
+        }
+        if (h->size > file.size() || (h->size - sizeof *h) % 4 != 0)
+        {
+            throw LoadError("'"+path+"' is truncated");
+        }
+        if (MappedFile::checksum(data+sizeof *h, h->size-sizeof *h) != h->checksum)
+        {
+            throw LoadError("'"+path+"' is corrupt: checksum mismatch");
+        }
+        if (h->fingerprint != fingerprint)
+        {
+            throw LoadError("'"+path+"' has been saved for another grammar or lexicon");
+        }
+        const std::uint32_t* r = reinterpret_cast<const std::uint32_t*>(data+sizeof *h);
+        const std::uint32_t* end = r + (h->size-sizeof *h)/4;
+        std::size_t n = 0;
+        while (end - r >= 2 && (std::size_t)(end - r - 2) >= r[0])
+        {
+            insert(Signature(r+2, r+2+r[0]), r[1] != 0);
+            r += 2+r[0];
+            ++n;
+        }
+        if (r != end || n != h->entry_count)
+        {
+            throw LoadError("'"+path+"' is corrupt: malformed record");
+        }
+        return n;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// signature and its result
+typedef std::pair<Signature, bool>                                        Entry;
+/// entries, most recently used first
+typedef std::list<Entry>                                              EntryList;
+////////////////////////////////////////////////////////////////////////////////
+    /// hash of signatures
+    struct SignatureHash
+    {
+        std::size_t operator()(const Signature& s) const
+        {
+            return MappedFile::checksum(reinterpret_cast<const char*>(s.data()),
+                                        s.size()*sizeof(std::uint32_t));
+        }
+    };
+////////////////////////////////////////////////////////////////////////////////
+    /// part of the cache with a lock of its own
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        EntryList order;
+        std::unordered_map<Signature, EntryList::iterator, SignatureHash> index;
+    };
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    ResultCache(const ResultCache&);
+    ResultCache& operator=(const ResultCache&);
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns shard of signature @p s
+    Shard& shard_of(const Signature& s)
+    {
+        // the low bits choose the bucket within the shard
+        return shards[(SignatureHash()(s) >> 32) % shards.size()];
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::vector<Shard> shards;               ///< parts of the cache
+    const std::size_t shard_capacity;        ///< results per shard
+    std::atomic<std::uint64_t> hit_count;    ///< signatures found
+    std::atomic<std::uint64_t> miss_count;   ///< signatures not found
+////////////////////////////////////////////////////////////////////////////////
+}; // ResultCache
+
+} // Earley
+
+#endif // __CACHE__HPP
@@ -1,7 +1,7 @@
 /**
  * @file chart.hpp
  * Chart class for earley parser. Wraps a vector of sets of
- * \b Earley::EarleyItem<RULE> as a parse cahrt.
+ * \b Earley::EarleyItem<GRAMMAR> as a parse cahrt.
  *
  * Matthias Bisping
  *
@@ -26,6 +26,7 @@
 #include "declarations.hpp"
 #include "helper.hpp"
 #include "item.hpp"
+#include "export.hpp"
 
 namespace Earley
 {
@@ -49,22 +50,24 @@ class EarleyChart
 ////////////////////////////////////////////////////////////////////////////////
 public:                                                     //   PUBLIC TYPEDEFS
 ////////////////////////////////////////////////////////////////////////////////
-/// the \b Rule type for this \b Chart
-typedef typename PARSER::Grammar::Rule                                     Rule;
+/// the compiled grammar type for this \b Chart
+typedef typename PARSER::Grammar                                        Grammar;
 /// the \b Item type for this \b Chart
-typedef EarleyItem<Rule>                                                   Item;
+typedef EarleyItem<Grammar>                                                Item;
 /// set of \b Items for the cells of \b chart
 typedef std::unordered_set<Item>                                        ItemSet;
 /// The type for the internal \b chart
 typedef std::vector<ItemSet>                                              Chart;
-/// the type defined in the \b Rule for internal symbols
-typedef typename Rule::IS                                                    IS;
-/// the type defined in the \b Rule for external symbols
-typedef typename Rule::ES                                                    ES;
+/// the type defined in the \b Grammar for internal symbols
+typedef typename Grammar::IS                                                 IS;
+/// the type defined in the \b Grammar for external symbols
+typedef typename Grammar::ES                                                 ES;
 /// vector of internal symbols
-typedef typename Rule::ISVec                                              ISVec;
+typedef typename Grammar::ISVec                                           ISVec;
 /// vector of external symbols
-typedef typename Rule::ESVec                                              ESVec;
+typedef typename Grammar::ESVec                                           ESVec;
+/// the symbol type within rule records
+typedef typename Grammar::Sym                                               Sym;
 ////////////////////////////////////////////////////////////////////////////////
 public:                                                     //    PUBLIC METHODS
 ////////////////////////////////////////////////////////////////////////////////
@@ -78,16 +81,28 @@ public:                                                     //    PUBLIC METHODS
      *        inserts start \b Item into \b Chart. Also defines \b final_item
      *        as a completed of the start \b Item.
      * @param sentence vector of tokens to parse
-     * @param startrule the \b startrule defined for the \b grammar
+     * @param startrule record of the start rule of the grammar
      */
-    void initialise(ESVec& sentence, Rule startrule)
+    void initialise(ESVec& sentence, const Sym* startrule)
     {
         // fill \b tokens with tokens from @p sentence
         tokens = sentence;
-        chart.resize(tokens.size()+1);
         tokens.push_back("$");
+        initialise(sentence.size(), startrule);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief sizes the chart for a sentence of @p length tokens, without
+     *        keeping the tokens, and inserts the start \b Item. Also defines
+     *        \b final_item as a completed of the start \b Item.
+     * @param length number of tokens to parse
+     * @param startrule record of the start rule of the grammar
+     */
+    void initialise(std::size_t length, const Sym* startrule)
+    {
+        chart.resize(length+1);
         insert(0, Item(startrule));
-        final_item = Item(startrule, startrule.get_rhs()->size(), 0, chart.size()-1);
+        final_item = Item(startrule, Grammar::length(startrule), 0, chart.size()-1);
     }
 ////////////////////////////////////////////////////////////////////////////////
     /**
@@ -95,9 +110,9 @@ public:                                                     //    PUBLIC METHODS
      *        start \b Item into \b Chart. Also defines \b final_item
      *        as a completed of the start \b Item.
      * @param is stream of tokens to parse
-     * @param startrule the startrule defined for the grammar
+     * @param startrule record of the start rule of the grammar
      */
-    void initialise(std::stringstream& is, Rule startrule)
+    void initialise(std::stringstream& is, const Sym* startrule)
     {
         // fill \p tokens with tokens from stream
         std::string token;
@@ -114,7 +129,39 @@ public:                                                     //    PUBLIC METHODS
         // cell of the \b chart
         insert(0, Item(startrule));
         // define the final \b Item as a completed version of the start \b Item
-        final_item = Item(startrule, startrule.get_rhs()->size(), 0, chart.size()-1);
+        final_item = Item(startrule, Grammar::length(startrule), 0, chart.size()-1);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief appends a cell for one more token and moves \b final_item to
+     *        it. Only for charts initialised without tokens.
+     */
+    void extend()
+    {
+        assert(tokens.empty() && "extending a chart with tokens");
+        chart.emplace_back();
+        final_item.to = chart.size()-1;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief replaces the @p count tokens at @p index by @p n others and
+     *        empties the cells after @p index; those up to @p index are
+     *        kept. Moves \b final_item to the new last cell.
+     * @param inserted the @p n new tokens; only used if the chart keeps
+     *        its tokens
+     */
+    void replace(std::size_t index, std::size_t count, const ESVec& inserted,
+                 std::size_t n)
+    {
+        if (!tokens.empty())
+        {
+            tokens.erase(tokens.begin()+index, tokens.begin()+index+count);
+            tokens.insert(tokens.begin()+index, inserted.begin(), inserted.end());
+        }
+        std::size_t length = chart.size()-1 - count + n;
+        chart.resize(index+1);
+        chart.resize(length+1);
+        final_item.to = length;
     }
 ////////////////////////////////////////////////////////////////////////////////
     /// resets chart and tokens
@@ -189,9 +236,9 @@ public:                                                     //    PUBLIC METHODS
     }
 ////////////////////////////////////////////////////////////////////////////////
     /// @return lengths of \p chart
-    short size()
+    short size() const
     {
-        assert(tokens.size() == chart.size() && "tokens+1 != chart");
+        assert((tokens.empty() || tokens.size() == chart.size()) && "tokens+1 != chart");
         return chart.size();
     }
 ////////////////////////////////////////////////////////////////////////////////
@@ -207,6 +254,19 @@ public:                                                     //    PUBLIC METHODS
         }
         return chart[index];
     }
+////////////////////////////////////////////////////////////////////////////////
+    /// @return constant set of items of \b chart at @p index
+    const ItemSet& operator[](short unsigned index) const
+    {
+        if (index >= chart.size())
+        {
+            helper::msg("error:",
+                        "index ["+helper::to_string(index)+"] exceeds array",
+                        __FILE__, __LINE__);
+            exit(1);
+        }
+        return chart[index];
+    }
 ////////////////////////////////////////////////////////////////////////////////
     /// @return word in \p tokens at index \p index
     ES get_word(short unsigned index)
@@ -221,26 +281,22 @@ public:                                                     //    PUBLIC METHODS
         return tokens[index];
     }
 ////////////////////////////////////////////////////////////////////////////////
-    /// sends a representation of the chart to \p o
-    void show(sost& o=std::cout)
+    /// @returns the tokens the chart has been initialised with, if any
+    const ESVec& get_tokens() const
     {
-        assert(tokens.size() == chart.size() && "tokens != chart");
-        int i = 0;
-        o << "\n";
-        // loop over the \b chart cells
-        for (auto cell = chart.begin(); cell !=chart.end(); ++cell, ++i)
-        {
-            // loop over the \b Items in the cell
-            o << "CHART[" << i << "] ('" << tokens[i] << "')\n\n";
-            for (auto item = cell->begin(); item != cell->end(); ++item)
-            {
-                o << *item << "\n";
-                o.flush();
-            }
-            helper::fill_line('_');
-            o << "\n";
-        }
-        o << "\n";
+        return tokens;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief sends a representation of the chart to \p o
+     * @param g grammar to translate the symbols of the items with
+     * @param words the word scanned at every index, shown for lexical items
+     */
+    void show(const Grammar& g, const ESVec& words, sost& o=std::cout) const
+    {
+        assert((tokens.empty() || tokens.size() == chart.size()) && "tokens != chart");
+        typename ChartExporter<EarleyChart>::WordViews views(words.begin(), words.end());
+        ChartExporter<EarleyChart>(g, o).write(*this, views);
     }
 ////////////////////////////////////////////////////////////////////////////////
 private:                                                    //    PRIVATE FIELDS
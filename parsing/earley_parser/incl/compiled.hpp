@@ -0,0 +1,1720 @@
+/**
+ * @file compiled.hpp
+ * Compiled grammar. \b CompiledGrammar holds the symbols and rules of a
+ * \b Grammar in a few flat arrays within one block of memory, together
+ * with the tables the parser derives from them: the rules by left hand
+ * side and a lexical rule for every symbol. The block can be written to a
+ * file, a grammar image, and mapped back into memory, so a grammar that
+ * has been compiled once is ready to use without reading a single rule.
+ *
+ * An image starts with an \b ImageHeader followed by the sections it
+ * refers to:
+ *
+ *     names        symbol names, concatenated
+ *     name_offsets offset of every name in names, plus 1 for the end
+ *     hash         open addressing hash table of symbol IDs
+ *     rules        rule records [lhs, rhs length, rhs symbols...]
+ *     lhs_index    for every symbol, begin of its rules in lhs_rules
+ *     lhs_rules    offsets of rule records in rules, grouped by lhs
+ *     lexical      lexical rule record [tag, 1, tag] for every symbol
+ *
+ * All numbers are stored in the byte order of the machine that compiled
+ * the image; an image from another byte order is rejected by its magic.
+ *
+ * Rules can be added and removed at run time. The first change copies the
+ * sections into vectors of their own; every change then updates only the
+ * records, LHS offsets and names it touches, without compiling the grammar
+ * again. A variant of a grammar shares its sections and its symbols,
+ * numbers the symbols it adds after them and copies only the rule offsets
+ * of the left hand sides it changes, so any number of variants of one
+ * grammar take the memory of their changes.
+ *
+ * Categories that differ only in their features, such as NN-HD-Gen.Sg.Fem
+ * and NN-HD-Dat.Pl.Masc, can be factored into a base category and a bit
+ * for each feature bundle, see factor(). The rules that differ only in
+ * the features of their symbols then become one rule over base categories,
+ * which stands for up to 16 of them; the parser keeps track of which of
+ * these an item still agrees with and checks agreement by mask operations
+ * when it scans and completes.
+ *
+ * optimize() rewrites the rules for the parser without changing what it
+ * recognises: it drops the rules that cannot take part in a derivation,
+ * collapses chains of unary rules between categories, which the parser
+ * then completes in one step, and gives the prefixes that rules of one left
+ * hand side share a symbol of their own, so that the parser tracks them
+ * once. The rules as written are kept for output.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __COMPILED__HPP
+#define __COMPILED__HPP
+
+#include "declarations.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "grammar.hpp"
+#include "mapped.hpp"
+#include "loader.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+/// header of a grammar image
+struct ImageHeader
+{
+    char magic[8];               ///< "EARLEYG" and the byte order mark
+    std::uint32_t version;       ///< format version, see \b current()
+    std::uint32_t header_size;   ///< sizeof(ImageHeader)
+    std::uint64_t size;          ///< size of the whole image in bytes
+    std::uint64_t checksum;      ///< FNV-1a of all bytes after the header
+    std::uint32_t symbol_count;  ///< number of symbol IDs
+    std::uint32_t rule_count;    ///< number of rules, without start rule
+    std::uint32_t start;         ///< offset of the start rule in rules
+    std::uint32_t hash_size;     ///< number of slots in hash; power of 2
+    std::uint64_t names;         ///< byte offsets of the sections
+    std::uint64_t name_offsets;
+    std::uint64_t hash;
+    std::uint64_t rules;
+    std::uint64_t lhs_index;
+    std::uint64_t lhs_rules;
+    std::uint64_t lexical;
+
+    /// @returns version of the image format written by this code
+    static std::uint32_t current() { return 1; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// numbers of the changes made by \b CompiledGrammar::edit()
+struct RuleEdits
+{
+    std::size_t added;           ///< rules added
+    std::size_t removed;         ///< rules removed
+    std::size_t unchanged;       ///< rules present already or not found
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// numbers of rules and categories before and after \b CompiledGrammar::factor()
+struct FactorCounts
+{
+    std::size_t rules;           ///< rules before, without start rule
+    std::size_t factored;        ///< rules after
+    std::size_t categories;      ///< symbols occurring in the rules before
+    std::size_t bases;           ///< symbols occurring in the rules after
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// numbers of rules and categories before and after \b CompiledGrammar::optimize()
+struct OptimizeCounts
+{
+    std::size_t rules;           ///< rules before, without start rule
+    std::size_t categories;      ///< symbols occurring in the rules before
+    std::size_t useless;         ///< rules dropped as useless
+    std::size_t collapsed;       ///< unary rules collapsed into chains
+    std::size_t prefixes;        ///< symbols added for shared prefixes
+    std::size_t optimized;       ///< rules after
+    std::size_t remaining;       ///< symbols occurring in the rules after
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               CompiledGrammar                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief read-only flat representation of a grammar
+ * @details the grammar is built either from a \b Grammar or from a grammar
+ *          image. Rules are referred to by pointers to their records, which
+ *          stay valid until add_rule() or remove_rule() changes the rules;
+ *          no parse may be in progress then, and cached results and chart
+ *          cells of the old rules must be dropped. Symbols not known to the
+ *          grammar, such as words, can still be translated; they are kept
+ *          apart from the compiled symbols. A grammar with variants, see
+ *          variant(), cannot be changed, factored or optimized until they
+ *          are freed; a factored grammar, see factor(), or an optimized
+ *          one, see optimize(), cannot be changed at all.
+ * @tparam INTERNSYM internal symbol type; integer type
+ * @tparam EXTERNSYM external symbol type; std::string
+ */
+template <typename INTERNSYM, typename EXTERNSYM>
+class CompiledGrammar
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef INTERNSYM                                                            IS;
+typedef EXTERNSYM                                                            ES;
+typedef std::vector<IS>                                                   ISVec;
+typedef std::vector<ES>                                                   ESVec;
+typedef std::set<IS>                                                      ISSET;
+/// symbol type within rule records
+typedef std::int32_t                                                        Sym;
+/// symbols and rules to compile
+typedef Earley::RuleTable<ES>                                         RuleTable;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief compiles the rules of grammar @p g
+     * @tparam GRAMMAR \b Grammar type; only types with a rule parser are
+     *         taken, so a \b RuleTable goes to the constructor below
+     */
+    template <typename GRAMMAR, typename = typename GRAMMAR::RPar>
+    explicit CompiledGrammar(GRAMMAR& g)
+    :data(nullptr)
+    {
+        RuleTable t;
+        for (std::size_t s = 0; s < g.symbol_count(); ++s)
+        {
+            t.symbols.push_back(g.has_symbol(s) ? g.translate((IS)s) : ES());
+        }
+        t.start = record(g.start);
+        for (auto l = g.get_rules().begin(); l != g.get_rules().end(); ++l)
+        {
+            for (auto r = l->second.begin(); r != l->second.end(); ++r)
+            {
+                t.add(record(*r));
+            }
+        }
+        t.sort();
+        build(t);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief compiles the rules of rule table @p t
+     * @pre the records of @p t are sorted, see \b RuleTable::sort()
+     */
+    explicit CompiledGrammar(const RuleTable& t)
+    :data(nullptr)
+    {
+        build(t);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief maps grammar image @p path into memory. Where mapping is not
+     *        available the image is read instead.
+     * @throws LoadError if @p path cannot be read or is no valid image
+     */
+    explicit CompiledGrammar(const sstr& path)
+    :file(new MappedFile(path)),
+    data(file->data())
+    {
+        validate(path);
+        attach();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief loads a grammar from @p path, which is either a grammar image
+     *        or a text file of rules. Text files are read on @p threads
+     *        threads, see \b ParallelLoader
+     * @param path file to load
+     * @param threads number of threads; 0 selects the number of cores
+     * @throws LoadError if @p path cannot be read or is malformed
+     */
+    static std::unique_ptr<CompiledGrammar> load(const sstr& path, unsigned threads=0)
+    {
+        if (is_image(path))
+        {
+            return std::unique_ptr<CompiledGrammar>(new CompiledGrammar(path));
+        }
+        const RuleTable t = ParallelLoader::load_rules<CFGValidator<ES>, CFGRuleParser<IS, ES>>(path, threads);
+        return std::unique_ptr<CompiledGrammar>(new CompiledGrammar(t));
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief creates a variant of grammar @p of, to be changed by
+     *        add_rule() and remove_rule() without changing @p of
+     * @details the variant refers to the sections of @p of and translates
+     *          symbols through it, so symbols have the same IDs in both and
+     *          a lexicon loaded for @p of serves the variant as well.
+     *          Symbols new to the variant get IDs after those of @p of in a
+     *          table of the variant's own, and @p of gets no new symbols
+     *          while it has variants. The variant copies the rule offsets
+     *          of a LHS on the first change to them. A variant of a variant
+     *          is another variant of the grammar the latter was made from.
+     * @throws std::runtime_error if @p of has been factored or optimized
+     */
+    static std::unique_ptr<CompiledGrammar> variant(const std::shared_ptr<CompiledGrammar>& of)
+    {
+        return std::unique_ptr<CompiledGrammar>(new CompiledGrammar(of));
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// a variant is no longer counted among the variants of its grammar
+    ~CompiledGrammar()
+    {
+        if (base) --base->variants;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if file @p path starts like a grammar image
+    static bool is_image(const sstr& path)
+    {
+        return MappedFile::has_magic(path, "EARLEYG");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief writes the grammar image to @p path
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void save(const sstr& path) const
+    {
+        // a changed grammar is compiled again, so that its image is the same
+        // as that of a grammar file with the same rules
+        if (edited || base)
+        {
+            CompiledGrammar(table()).save(path);
+            return;
+        }
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f.write(data, header->size);
+        if (!f) throw std::runtime_error("failed to write '"+path+"'");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns size of the image in bytes; that of the grammar a variant
+    /// has been made from for a variant
+    std::size_t image_size() const
+    {
+        return header->size;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns approximate number of bytes a variant holds for its changes;
+    /// 0 for other grammars
+    std::size_t variant_size() const
+    {
+        if (!base) return 0;
+        std::size_t bytes = own_rules.size()*sizeof(Sym) +
+                            own_lexical.size()*(sizeof(IS)+3*sizeof(Sym));
+        for (auto x = extra.begin(); x != extra.end(); ++x)
+        {
+            bytes += 2*sizeof(*x) + sizeof(IS) + x->size();
+        }
+        for (auto c = changed.begin(); c != changed.end(); ++c)
+        {
+            bytes += sizeof(*c) + c->second.size()*4;
+        }
+        return bytes;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if this grammar is a variant, see variant()
+    bool is_variant() const
+    {
+        return base != nullptr;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the grammar has been mapped from an image
+    bool is_mapped() const
+    {
+        return file && file->is_mapped();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of rules, without the start rule
+    std::size_t rule_count() const
+    {
+        return header->rule_count + rule_delta;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of compiled symbols
+    std::size_t symbol_count() const
+    {
+        return header->symbol_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns record of the start rule
+    const Sym* start_rule() const
+    {
+        return rules + header->start;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns begin and end of the offsets of the rules with LHS @p lhs;
+    /// the records are found with rule()
+    std::pair<const std::uint32_t*, const std::uint32_t*> rules_for(IS lhs) const
+    {
+        // the LHS changed by a variant
+        if (!changed.empty())
+        {
+            auto c = changed.find(lhs);
+            if (c != changed.end())
+            {
+                return std::make_pair(c->second.data(), c->second.data()+c->second.size());
+            }
+        }
+        if (lhs < 0 || (std::size_t)lhs >= header->symbol_count)
+        {
+            return std::make_pair(lhs_rules, lhs_rules);
+        }
+        return std::make_pair(lhs_rules + lhs_index[lhs], lhs_rules + lhs_index[lhs+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns rule record at @p offset
+    const Sym* rule(std::uint32_t offset) const
+    {
+        // records added to a variant come after those of its grammar
+        if (offset < rule_limit) return rules + offset;
+        return own_rules.data() + (offset-rule_limit);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns record of the lexical rule for tag @p tag
+    /// @pre @p tag is a compiled symbol or occurs in the rules of a variant
+    const Sym* lexical(IS tag) const
+    {
+        if ((std::size_t)tag < header->symbol_count) return lexicals + 3*tag;
+        return own_lexical.at(tag).data();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if @p r is the record of a lexical rule
+    bool is_lexical(const Sym* r) const
+    {
+        if (r >= lexicals && r < lexicals + 3*header->symbol_count) return true;
+        auto l = own_lexical.find(lhs(r));
+        return l != own_lexical.end() && l->second.data() == r;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns LHS of rule record @p r
+    static IS lhs(const Sym* r) { return r[0]; }
+    /// @returns RHS length of rule record @p r
+    static unsigned length(const Sym* r) { return r[1]; }
+    /// @returns RHS of rule record @p r
+    static const Sym* rhs(const Sym* r) { return r+2; }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief looks up the symbol of @p n chars at @p p
+     * @return its ID or -1
+     */
+    IS find(const char* p, std::size_t n) const
+    {
+        if (base)
+        {
+            IS is = base->find(p, n);
+            if (is != -1) return is;
+        }
+        else
+        {
+            std::uint32_t mask = header->hash_size-1;
+            for (std::uint32_t i = image_hash(p, n) & mask;; i = (i+1) & mask)
+            {
+                std::uint32_t s = hash[i];
+                if (s == empty()) break;
+                if (name_offsets[s+1]-name_offsets[s] == n &&
+                    std::memcmp(names+name_offsets[s], p, n) == 0) return s;
+            }
+        }
+        auto e = extra_ids.find(ES(p, n));
+        return e == extra_ids.end() ? -1 : e->second;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief translates @p es into an \b IS. Symbols unknown to the grammar
+     *        get a new ID; those unknown to a variant get one of the
+     *        variant, see variant().
+     * @throws std::runtime_error if @p es is unknown to a grammar with
+     *         variants, whose IDs would clash with those of the variants
+     */
+    IS translate(const ES& es)
+    {
+        IS is = find(es.data(), es.size());
+        if (is != -1) return is;
+        if (variants > 0) throw std::runtime_error("a grammar with variants gets no new symbols");
+        is = first_extra() + extra.size();
+        extra.push_back(es);
+        extra_ids.insert(std::make_pair(es, is));
+        return is;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// translates @p is into an \b ES; @returns "<$>" for unknown IDs
+    ES translate(const IS& is) const
+    {
+        if (base && is >= 0 && (std::size_t)is < symbol_limit) return base->translate(is);
+        if (!base && is >= 0 && (std::size_t)is < header->symbol_count)
+        {
+            return ES(names+name_offsets[is], names+name_offsets[is+1]);
+        }
+        std::size_t e = is - first_extra();
+        if (is >= 0 && e < extra.size()) return extra[e];
+        return "<$>";
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// marks the symbols in @p lexicon as words
+    void inject_lexicon(const ISSET& lexicon)
+    {
+        if (base) return base->inject_lexicon(lexicon);
+        for (auto w = lexicon.begin(); w != lexicon.end(); ++w)
+        {
+            if (*w < 0) continue;
+            if ((std::size_t)*w >= words.size()) words.resize(*w+1, false);
+            words[*w] = true;
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if @p is has been marked as a word
+    bool is_word(const IS& is) const
+    {
+        if (base) return base->is_word(is);
+        return is >= 0 && (std::size_t)is < words.size() && words[is];
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief adds rule @p lhs --> @p rhs. Symbols new to the grammar become
+     *        compiled symbols; symbols translated before keep their IDs.
+     * @details the record is appended and its offset inserted among the
+     *          rules of @p lhs, in the order a compiled grammar has them; the
+     *          LHS offsets after @p lhs move by one. Nothing else changes.
+     *          A variant inserts the offset into its copy of the offsets of
+     *          @p lhs; symbols new to it get IDs of its own, as by
+     *          translate().
+     * @return false, if the grammar has the rule already
+     * @throws std::invalid_argument if a side or a symbol is empty
+     * @throws std::runtime_error if the grammar has been factored or optimized
+     *         or has variants
+     */
+    bool add_rule(const ES& lhs, const ESVec& rhs)
+    {
+        if (features || optimized)
+        {
+            throw std::runtime_error("the rules of a factored or optimized grammar cannot be changed");
+        }
+        if (lhs.empty() || rhs.empty() ||
+            std::find(rhs.begin(), rhs.end(), ES()) != rhs.end())
+        {
+            throw std::invalid_argument("a rule needs a left and a right hand side of non-empty symbols");
+        }
+        if (!base) sections();
+        std::vector<Sym> r = { (Sym)intern(lhs), (Sym)rhs.size() };
+        for (auto s = rhs.begin(); s != rhs.end(); ++s) r.push_back(intern(*s));
+
+        auto at = position(r);
+        if (at.second) return false;
+        if (base)
+        {
+            ++rule_delta;
+            std::vector<std::uint32_t>& own = own_rules_for(r[0]);
+            own.insert(own.begin()+at.first, rule_limit+own_rules.size());
+            own_rules.insert(own_rules.end(), r.begin(), r.end());
+            return true;
+        }
+        Sections& e = *edited;
+        e.lhs_rules.insert(e.lhs_rules.begin()+e.lhs_index[r[0]]+at.first, e.rules.size());
+        e.rules.insert(e.rules.end(), r.begin(), r.end());
+        for (std::size_t s = r[0]+1; s < e.lhs_index.size(); ++s) ++e.lhs_index[s];
+        attach_sections();
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief removes rule @p lhs --> @p rhs. Its symbols stay, so that IDs
+     *        do not change.
+     * @details the offset of the rule is dropped and the LHS offsets after
+     *          @p lhs move by one; the record stays unused until the grammar
+     *          is saved. A variant drops the offset from its copy of the
+     *          offsets of @p lhs.
+     * @return false, if the grammar has no such rule
+     * @throws std::runtime_error if the grammar has been factored or optimized
+     *         or has variants
+     */
+    bool remove_rule(const ES& lhs, const ESVec& rhs)
+    {
+        if (features || optimized)
+        {
+            throw std::runtime_error("the rules of a factored or optimized grammar cannot be changed");
+        }
+        std::vector<Sym> r = { (Sym)find(lhs.data(), lhs.size()), (Sym)rhs.size() };
+        for (auto s = rhs.begin(); s != rhs.end(); ++s) r.push_back(find(s->data(), s->size()));
+        for (auto s = r.begin()+2; s != r.end(); ++s)
+        {
+            if (*s == -1) return false;
+        }
+        if (r[0] < 0) return false;
+        auto at = position(r);
+        if (!at.second) return false;
+        if (base)
+        {
+            std::vector<std::uint32_t>& own = own_rules_for(r[0]);
+            own.erase(own.begin()+at.first);
+            --rule_delta;
+            return true;
+        }
+
+        Sections& e = sections();
+        e.lhs_rules.erase(e.lhs_rules.begin()+e.lhs_index[r[0]]+at.first);
+        for (std::size_t s = r[0]+1; s < e.lhs_index.size(); ++s) --e.lhs_index[s];
+        attach_sections();
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief adds and removes the rules listed in file @p path, one change
+     *        per line: '+' or '-' followed by a rule as in a grammar file,
+     *        e.g. "+ NP --> DT NN". Empty lines are skipped.
+     * @throws LoadError if @p path cannot be read or a line is malformed;
+     *         the changes of the lines before have been made then
+     */
+    RuleEdits edit(const sstr& path)
+    {
+        std::ifstream f(path);
+        if (!f.is_open()) throw LoadError("failed to open '"+path+"'");
+        RuleEdits counts = { 0, 0, 0 };
+        sstr line;
+        for (std::size_t n = 1; std::getline(f, line); ++n)
+        {
+            ESVec tokens = helper::tokenise(line);
+            if (tokens.empty()) continue;
+            ESVec rhs(tokens.begin()+std::min<std::size_t>(3, tokens.size()), tokens.end());
+            if ((tokens[0] != "+" && tokens[0] != "-") || tokens.size() < 4 ||
+                tokens[2] != "-->" || std::find(rhs.begin(), rhs.end(), "-->") != rhs.end())
+            {
+                throw LoadError("'"+path+"', line "+helper::to_string(n)+
+                                ": expected '+' or '-' followed by a rule");
+            }
+            if (tokens[0] == "+")
+            {
+                if (add_rule(tokens[1], rhs)) ++counts.added;
+                else ++counts.unchanged;
+            }
+            else if (remove_rule(tokens[1], rhs)) ++counts.removed;
+            else ++counts.unchanged;
+        }
+        return counts;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the symbols and rules as a sorted \b RuleTable, from which
+    /// an equal grammar can be compiled; those before factoring or
+    /// optimizing for a factored or optimized grammar
+    RuleTable table() const
+    {
+        RuleTable t;
+        if (optimized)
+        {
+            const std::vector<Sym>& o = optimized->original;
+            for (std::size_t s = 0; s < optimized->symbols; ++s) t.symbols.push_back(translate((IS)s));
+            t.start.assign(o.begin(), o.begin()+2+length(o.data()));
+            for (std::size_t r = t.start.size(); r < o.size(); r += 2+length(o.data()+r))
+            {
+                t.add(std::vector<Sym>(o.begin()+r, o.begin()+r+2+length(o.data()+r)));
+            }
+            t.sort();
+            return t;
+        }
+        if (features)
+        {
+            for (std::size_t s = 0; s < features->symbols; ++s) t.symbols.push_back(translate((IS)s));
+            for (auto f = features->rules.begin(); f != features->rules.end(); ++f)
+            {
+                for (const Sym* r = f->members.data(); r != f->members.data()+f->members.size();
+                     r += 2+length(r))
+                {
+                    if (f == features->rules.begin()) t.start.assign(r, r+2+length(r));
+                    else t.add(std::vector<Sym>(r, r+2+length(r)));
+                }
+            }
+            t.sort();
+            return t;
+        }
+        // the symbols of a variant may go beyond the compiled ones
+        std::size_t n = base ? symbol_limit + extra.size() : symbol_count();
+        for (std::size_t s = 0; s < n; ++s) t.symbols.push_back(translate((IS)s));
+        const Sym* start = start_rule();
+        t.start.assign(start, start+2+length(start));
+        for (std::size_t s = 0; s < n; ++s)
+        {
+            auto range = rules_for(s);
+            for (auto r = range.first; r != range.second; ++r)
+            {
+                const Sym* rec = rule(*r);
+                t.add(std::vector<Sym>(rec, rec+2+length(rec)));
+            }
+        }
+        return t;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief factors the features out of the categories: symbols of the
+     *        same stem, e.g. NN-HD for NN-HD-Gen.Sg.Fem, become one base
+     *        category, and rules over the same base categories become one
+     *        factored rule
+     * @details the features of a category are the part of its name after
+     *          the last '-', if that part holds a '.'. The categories of a
+     *          stem that occur in the rules are split into tags and others,
+     *          as the tags of @p lexicon, and these into base categories of
+     *          up to 16, one bit of feature bundle each; a base category of
+     *          one keeps its symbol, the others are named like NN-HD-*.
+     *          Rules over the same base categories are factored 16 at a
+     *          time. The base categories of tags become tags of @p lexicon,
+     *          whose tags and words have been translated with the grammar.
+     *          Symbols keep their IDs. A factored grammar cannot be changed
+     *          and has no variants; save() writes the rules it has been
+     *          factored from.
+     * @throws std::runtime_error if the grammar is a variant, factored or
+     *         optimized, or has variants
+     */
+    template <typename LEXICON>
+    FactorCounts factor(LEXICON& lexicon)
+    {
+        if (base || features || optimized)
+        {
+            throw std::runtime_error("only a grammar that is neither a variant, factored nor optimized can be factored");
+        }
+        if (variants > 0) throw std::runtime_error("a grammar with variants cannot be factored");
+        FactorCounts counts = { rule_count(), 0, 0, 0 };
+        // symbols translated before, such as tags, become compiled symbols,
+        // so that the base categories can be added after them
+        Sections& e = compile_extra();
+        std::size_t n = symbol_count();
+
+        std::vector<const Sym*> records(1, start_rule());
+        for (std::size_t s = 0; s < n; ++s)
+        {
+            auto range = rules_for(s);
+            for (auto r = range.first; r != range.second; ++r) records.push_back(rule(*r));
+        }
+        std::vector<bool> used(n, false);
+        for (auto r = records.begin(); r != records.end(); ++r)
+        {
+            used[lhs(*r)] = true;
+            for (unsigned i = 0; i < length(*r); ++i) used[rhs(*r)[i]] = true;
+        }
+
+        // base categories by stem and kind; a symbol left alone is its own
+        std::unique_ptr<Features> f(new Features);
+        f->symbols = n;
+        f->base.resize(n);
+        f->bit.assign(n, 0);
+        std::map<std::pair<ES, bool>, ISVec> stems;
+        for (std::size_t s = 0; s < n; ++s)
+        {
+            f->base[s] = s;
+            ES name = translate((IS)s);
+            if (!used[s]) continue;
+            ++counts.categories;
+            if (name.empty() || is_word(s)) continue;
+            std::size_t dash = name.rfind('-');
+            if (dash != ES::npos && dash > 0 && name.find('.', dash) != ES::npos) name.resize(dash);
+            stems[std::make_pair(name, lexicon.is_tag(s))].push_back(s);
+        }
+        ESVec names;
+        std::vector<ISVec> categories;
+        for (auto st = stems.begin(); st != stems.end(); ++st)
+        {
+            const ISVec& all = st->second;
+            for (std::size_t first = 0; first < all.size(); first += 16)
+            {
+                ISVec members(all.begin()+first, all.begin()+std::min(first+16, all.size()));
+                IS b = members[0];
+                if (members.size() > 1)
+                {
+                    ES name = st->first.first+"-*";
+                    for (int k = 2; find(name.data(), name.size()) != -1 ||
+                                    std::find(names.begin(), names.end(), name) != names.end(); ++k)
+                    {
+                        name = st->first.first+"-*"+helper::to_string(k);
+                    }
+                    b = n+names.size();
+                    names.push_back(name);
+                    if (st->first.second) lexicon.add_tag(b);
+                }
+                for (std::size_t m = 0; m < members.size(); ++m)
+                {
+                    f->base[members[m]] = b;
+                    f->bit[members[m]] = m;
+                }
+                if ((std::size_t)b >= categories.size()) categories.resize(b+1);
+                categories[b] = members;
+            }
+        }
+        for (auto x = names.begin(); x != names.end(); ++x) add_symbol(e, *x);
+        rehash(e);
+        f->all.assign(e.name_offsets.size()-1, 1);
+        for (std::size_t b = 0; b < categories.size(); ++b)
+        {
+            if (categories[b].size() > 1) f->all[b] = (1u << categories[b].size())-1;
+        }
+
+        // rules by the base categories of their symbols, start rule first
+        auto key = [&f](const Sym* r)
+        {
+            std::vector<Sym> k(r, r+2+length(r));
+            k[0] = f->base[k[0]];
+            for (std::size_t i = 2; i < k.size(); ++i) k[i] = f->base[k[i]];
+            return k;
+        };
+        std::map<std::vector<Sym>, std::vector<const Sym*>> factored;
+        for (auto r = records.begin()+1; r != records.end(); ++r) factored[key(*r)].push_back(*r);
+        std::vector<Sym> rec = key(records[0]);
+        std::vector<std::uint32_t> index(e.name_offsets.size(), 0), offsets;
+        f->rules.push_back(Factored(records.begin(), records.begin()+1, f->bit));
+        for (auto r = factored.begin(); r != factored.end(); ++r)
+        {
+            const std::vector<const Sym*>& m = r->second;
+            for (std::size_t first = 0; first < m.size(); first += 16)
+            {
+                ++index[r->first[0]+1];
+                offsets.push_back(rec.size());
+                rec.insert(rec.end(), r->first.begin(), r->first.end());
+                f->rules.push_back(Factored(m.begin()+first, m.begin()+std::min(first+16, m.size()), f->bit));
+            }
+        }
+        for (std::size_t s = 0; s+1 < index.size(); ++s) index[s+1] += index[s];
+        f->at.assign(rec.size(), 0);
+        for (std::size_t o = 0; o < offsets.size(); ++o) f->at[offsets[o]] = o+1;
+        e.rules.swap(rec);
+        e.lhs_index.swap(index);
+        e.lhs_rules.swap(offsets);
+        attach_sections();
+        counts.factored = rule_count();
+        std::set<IS> bases;
+        for (std::size_t s = 0; s < n; ++s)
+        {
+            if (used[s]) bases.insert(f->base[s]);
+        }
+        counts.bases = bases.size();
+        features = std::move(f);
+        return counts;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the grammar has been factored, see factor()
+    bool is_factored() const
+    {
+        return features != nullptr;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief features of a word of tags @p tags as tag @p tag of a factored
+     *        grammar
+     * @param excluded receives the feature bits of @p tag the word does
+     *        not have, the features of its lexical item
+     * @return false, if the word has none of the tags @p tag stands for
+     */
+    bool scan_features(IS tag, const ISVec& tags, std::uint16_t& excluded) const
+    {
+        const Features& f = *features;
+        unsigned found = 0;
+        for (auto t = tags.begin(); t != tags.end(); ++t)
+        {
+            if (*t >= 0 && (std::size_t)*t < f.symbols && f.base[*t] == tag) found |= 1u << f.bit[*t];
+        }
+        if (found == 0) return false;
+        excluded = f.all[tag] & ~found;
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief checks whether the item of factored rule @p rule with the dot
+     *        at @p dot agrees with the complete item of rule @p child in the features
+     *        of the symbol at the dot. The features of an item are the bits
+     *        it excludes: the rules of a factored rule that it does not
+     *        agree with, or the categories of a lexical rule.
+     * @param excluded features of the item; receives those of the item
+     *        with the dot advanced
+     * @param child_excluded features of the complete item
+     * @return false, if the item agrees with none of its rules
+     */
+    bool agree(const Sym* rule, unsigned dot, std::uint16_t& excluded,
+               const Sym* child, std::uint16_t child_excluded) const
+    {
+        const Features& f = *features;
+        // the categories the complete item stands for
+        unsigned found;
+        if (is_lexical(child)) found = f.all[lhs(child)] & ~child_excluded;
+        else
+        {
+            const Factored& c = f.rules[f.at[child-rules]];
+            found = 0;
+            for (unsigned m = c.all & ~child_excluded, k = 0; m != 0; m >>= 1, ++k)
+            {
+                if (m & 1) found |= 1u << c.lhs[k];
+            }
+        }
+        const Factored& r = f.rules[f.at[rule-rules]];
+        unsigned agreeing = 0;
+        for (unsigned b = 0; found != 0; found >>= 1, ++b)
+        {
+            if (found & 1) agreeing |= r.agree[16*dot+b];
+        }
+        agreeing &= r.all & ~excluded;
+        if (agreeing == 0) return false;
+        excluded = r.all & ~agreeing;
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief features of the item of factored rule @p predicted predicted
+     *        by the item of rule @p rule with the dot at @p dot: the item
+     *        excludes the rules whose LHS has features the other item does
+     *        not expect
+     * @param excluded features of the predicting item
+     * @param predicted_excluded receives the features of the predicted item
+     * @return false, if the predicted item would exclude all its rules
+     */
+    bool expect(const Sym* rule, unsigned dot, std::uint16_t excluded,
+                const Sym* predicted, std::uint16_t& predicted_excluded) const
+    {
+        const Features& f = *features;
+        const Factored& r = f.rules[f.at[rule-rules]];
+        unsigned expected = 0;
+        for (unsigned m = r.all & ~excluded, k = 0; m != 0; m >>= 1, ++k)
+        {
+            if (m & 1) expected |= 1u << r.rhs[k*r.length+dot];
+        }
+        const Factored& p = f.rules[f.at[predicted-rules]];
+        unsigned agreeing = 0;
+        for (unsigned k = 0; k < p.lhs.size(); ++k)
+        {
+            if (expected & (1u << p.lhs[k])) agreeing |= 1u << k;
+        }
+        if (agreeing == 0) return false;
+        predicted_excluded = p.all & ~agreeing;
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief appends the symbols at @p dot of the rules the item of
+     *        factored rule @p rule and features @p excluded agrees with to
+     *        @p symbols, e.g. the tags it expects
+     */
+    void unfactor(const Sym* rule, unsigned dot, std::uint16_t excluded, ISVec& symbols) const
+    {
+        const Factored& r = features->rules[features->at[rule-rules]];
+        for (unsigned m = r.all & ~excluded, k = 0; m != 0; m >>= 1, ++k)
+        {
+            if (m & 1) symbols.push_back(rhs(r.members.data()+k*(2+r.length))[dot]);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief rewrites the rules so that the parser adds fewer items, without
+     *        changing which sentences are recognised
+     * @details first, rules are dropped that are useless: those with a
+     *          symbol that derives no sequence of tags of @p lexicon, and
+     *          those that cannot be reached from the start rule. Then unary
+     *          rules between categories, such as NP --> PPER, are collapsed:
+     *          a category is predicted with the categories below it in
+     *          such chains, see chain_tails(), and an item complete with
+     *          PPER completes the items that expect NP, see chain_heads().
+     *          Last, the proper prefixes of two or more symbols that rules
+     *          of one LHS share become symbols of their own, named like
+     *          NP<ART NN>, with a rule each, and the rules begin with the
+     *          longest of them: NP --> ART NN PP becomes NP --> NP<ART NN> PP.
+     *          The rules as written are kept: original() maps items back to
+     *          them and save() writes them. Symbols keep their IDs. An
+     *          optimized grammar cannot be changed and has no variants.
+     * @throws std::runtime_error if the grammar is a variant, factored or
+     *         optimized, or has variants
+     */
+    template <typename LEXICON>
+    OptimizeCounts optimize(const LEXICON& lexicon)
+    {
+        if (base || features || optimized)
+        {
+            throw std::runtime_error("only a grammar that is neither a variant, factored nor optimized can be optimized");
+        }
+        if (variants > 0) throw std::runtime_error("a grammar with variants cannot be optimized");
+        OptimizeCounts counts = { rule_count(), 0, 0, 0, 0, 0, 0 };
+        // the prefix symbols are added after the symbols translated before
+        Sections& e = compile_extra();
+        std::size_t n = symbol_count();
+
+        std::unique_ptr<Optimized> o(new Optimized);
+        o->symbols = n;
+        std::vector<const Sym*> records(1, start_rule());
+        for (std::size_t s = 0; s < n; ++s)
+        {
+            auto range = rules_for(s);
+            for (auto r = range.first; r != range.second; ++r) records.push_back(rule(*r));
+        }
+        std::vector<std::uint32_t> origin;
+        std::vector<bool> used(n, false);
+        for (auto r = records.begin(); r != records.end(); ++r)
+        {
+            origin.push_back(o->original.size());
+            o->original.insert(o->original.end(), *r, *r+2+length(*r));
+            used[lhs(*r)] = true;
+            for (unsigned i = 0; i < length(*r); ++i) used[rhs(*r)[i]] = true;
+        }
+        counts.categories = std::count(used.begin(), used.end(), true);
+
+        // productive symbols derive a sequence of tags or words, reachable
+        // ones occur in the rules that can be used from the start rule on
+        std::vector<bool> productive(n, false), reachable(n, false);
+        for (std::size_t s = 0; s < n; ++s) productive[s] = lexicon.is_tag(s) || is_word(s);
+        auto all_productive = [&productive](const Sym* r)
+        {
+            for (unsigned i = 0; i < length(r); ++i)
+            {
+                if (!productive[rhs(r)[i]]) return false;
+            }
+            return true;
+        };
+        for (bool grown = true; grown; )
+        {
+            grown = false;
+            for (auto r = records.begin()+1; r != records.end(); ++r)
+            {
+                if (productive[lhs(*r)] || !all_productive(*r)) continue;
+                productive[lhs(*r)] = true;
+                grown = true;
+            }
+        }
+        ISVec todo;
+        auto reach = [&](const Sym* r)
+        {
+            if (!all_productive(r)) return;
+            for (unsigned i = 0; i < length(r); ++i)
+            {
+                if (reachable[rhs(r)[i]]) continue;
+                reachable[rhs(r)[i]] = true;
+                todo.push_back(rhs(r)[i]);
+            }
+        };
+        reach(records[0]);
+        while (!todo.empty())
+        {
+            auto range = rules_for(todo.back());
+            todo.pop_back();
+            for (auto r = range.first; r != range.second; ++r) reach(rule(*r));
+        }
+        std::vector<std::size_t> kept;
+        for (std::size_t r = 1; r < records.size(); ++r)
+        {
+            if (reachable[lhs(records[r])] && all_productive(records[r])) kept.push_back(r);
+        }
+        counts.useless = records.size()-1-kept.size();
+
+        // unary rules between categories that are no tags collapse; every
+        // category is predicted with the categories below it in chains and
+        // completes those above it
+        std::vector<ISVec> below(n);
+        std::vector<std::size_t> rest;
+        for (auto k = kept.begin(); k != kept.end(); ++k)
+        {
+            const Sym* r = records[*k];
+            IS a = lhs(r), b = rhs(r)[0];
+            if (length(r) == 1 && !lexicon.is_tag(a) && !lexicon.is_tag(b) && !is_word(b))
+            {
+                below[a].push_back(b);
+                ++counts.collapsed;
+            }
+            else rest.push_back(*k);
+        }
+        std::vector<ISVec> heads(n);
+        std::vector<std::size_t> seen(n, 0);
+        for (std::size_t a = 0; a < n; ++a)
+        {
+            if (below[a].empty()) continue;
+            ISVec chain;
+            todo.assign(below[a].begin(), below[a].end());
+            while (!todo.empty())
+            {
+                IS b = todo.back();
+                todo.pop_back();
+                if (seen[b] == a+1) continue;
+                seen[b] = a+1;
+                if ((std::size_t)b != a)
+                {
+                    chain.push_back(b);
+                    heads[b].push_back(a);
+                }
+                todo.insert(todo.end(), below[b].begin(), below[b].end());
+            }
+            below[a].swap(chain);
+        }
+
+        // rules of a LHS that share a prefix of two or more symbols begin
+        // with its symbol, the longest one they have. Prefixes are keyed by
+        // the LHS followed by their symbols
+        auto prefix = [](const Sym* r, unsigned i)
+        {
+            std::vector<Sym> k(1, lhs(r));
+            k.insert(k.end(), rhs(r), rhs(r)+i);
+            return k;
+        };
+        std::map<std::vector<Sym>, std::size_t> shared;
+        for (auto k = rest.begin(); k != rest.end(); ++k)
+        {
+            const Sym* r = records[*k];
+            for (unsigned i = 2; i < length(r); ++i) ++shared[prefix(r, i)];
+        }
+        std::map<std::vector<Sym>, IS> prefixes;
+        ESVec names;
+        for (auto p = shared.begin(); p != shared.end(); ++p)
+        {
+            if (p->second < 2) continue;
+            ES name = translate(p->first[0])+"<";
+            for (std::size_t i = 1; i < p->first.size(); ++i)
+            {
+                name += (i > 1 ? " " : "")+translate(p->first[i]);
+            }
+            ES unique = name+">";
+            for (int k = 2; find(unique.data(), unique.size()) != -1; ++k)
+            {
+                unique = name+">"+helper::to_string(k);
+            }
+            prefixes[p->first] = n+names.size();
+            names.push_back(unique);
+        }
+        for (auto x = names.begin(); x != names.end(); ++x) add_symbol(e, *x);
+        rehash(e);
+        std::size_t total = e.name_offsets.size()-1;
+        o->width.assign(total, 1);
+
+        // records by LHS, each with the record it stands for
+        std::vector<std::vector<std::pair<std::vector<Sym>, std::uint32_t>>> by_lhs(total);
+        for (auto k = rest.begin(); k != rest.end(); ++k)
+        {
+            const Sym* r = records[*k];
+            std::vector<Sym> rec(r, r+2+length(r));
+            for (unsigned i = length(r)-1; i >= 2; --i)
+            {
+                auto p = prefixes.find(prefix(r, i));
+                if (p == prefixes.end()) continue;
+                rec.erase(rec.begin()+2, rec.begin()+2+i);
+                rec.insert(rec.begin()+2, p->second);
+                rec[1] = length(r)-i+1;
+                break;
+            }
+            by_lhs[lhs(r)].push_back(std::make_pair(rec, origin[*k]+1));
+        }
+        for (auto p = prefixes.begin(); p != prefixes.end(); ++p)
+        {
+            // the rule of a prefix begins with the longest prefix within it
+            const std::vector<Sym>& k = p->first;
+            std::size_t i = k.size()-2;
+            for (; i >= 2; --i)
+            {
+                if (prefixes.count(std::vector<Sym>(k.begin(), k.begin()+1+i)) > 0) break;
+            }
+            std::vector<Sym> rec = { (Sym)p->second, 0 };
+            if (i >= 2) rec.push_back(prefixes[std::vector<Sym>(k.begin(), k.begin()+1+i)]);
+            else i = 0;
+            rec.insert(rec.end(), k.begin()+1+i, k.end());
+            rec[1] = rec.size()-2;
+            o->width[p->second] = k.size()-1;
+            by_lhs[p->second].push_back(std::make_pair(rec, 0));
+        }
+
+        // records grouped by LHS, start rule first
+        std::vector<Sym> rec(records[0], records[0]+2+length(records[0]));
+        std::vector<std::uint32_t> at(1, 1), index(1, 0), offsets;
+        std::vector<bool> occurs(total, false);
+        occurs[lhs(records[0])] = true;
+        for (unsigned i = 0; i < length(records[0]); ++i) occurs[rhs(records[0])[i]] = true;
+        for (std::size_t s = 0; s < total; ++s)
+        {
+            for (auto r = by_lhs[s].begin(); r != by_lhs[s].end(); ++r)
+            {
+                offsets.push_back(rec.size());
+                at.resize(rec.size()+1, 0);
+                at.back() = r->second;
+                rec.insert(rec.end(), r->first.begin(), r->first.end());
+                for (auto x = r->first.begin()+2; x != r->first.end(); ++x) occurs[*x] = true;
+                occurs[s] = true;
+            }
+            index.push_back(offsets.size());
+        }
+        at.resize(rec.size(), 0);
+        o->head_index.assign(1, 0);
+        o->tail_index.assign(1, 0);
+        for (std::size_t s = 0; s < n; ++s)
+        {
+            std::sort(heads[s].begin(), heads[s].end());
+            o->heads.insert(o->heads.end(), heads[s].begin(), heads[s].end());
+            o->head_index.push_back(o->heads.size());
+            std::sort(below[s].begin(), below[s].end());
+            o->tails.insert(o->tails.end(), below[s].begin(), below[s].end());
+            o->tail_index.push_back(o->tails.size());
+        }
+        o->at.swap(at);
+        e.rules.swap(rec);
+        e.lhs_index.swap(index);
+        e.lhs_rules.swap(offsets);
+        attach_sections();
+        counts.prefixes = names.size();
+        counts.optimized = rule_count();
+        counts.remaining = std::count(occurs.begin(), occurs.end(), true);
+        optimized = std::move(o);
+        return counts;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the grammar has been optimized, see optimize()
+    bool is_optimized() const
+    {
+        return optimized != nullptr;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the categories above @p category in chains of unary rules
+    /// collapsed by optimize(), sorted; an item complete with @p category
+    /// completes the items that expect one of them as well
+    std::pair<const IS*, const IS*> chain_heads(IS category) const
+    {
+        if (!optimized || category < 0 || (std::size_t)category >= optimized->symbols)
+        {
+            return std::pair<const IS*, const IS*>(nullptr, nullptr);
+        }
+        const IS* h = optimized->heads.data();
+        return std::make_pair(h+optimized->head_index[category], h+optimized->head_index[category+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the categories below @p category in chains of unary rules
+    /// collapsed by optimize(), sorted; they are predicted with @p category
+    std::pair<const IS*, const IS*> chain_tails(IS category) const
+    {
+        if (!optimized || category < 0 || (std::size_t)category >= optimized->symbols)
+        {
+            return std::pair<const IS*, const IS*>(nullptr, nullptr);
+        }
+        const IS* t = optimized->tails.data();
+        return std::make_pair(t+optimized->tail_index[category], t+optimized->tail_index[category+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if @p is has been added by optimize() for a prefix
+    /// shared by rules
+    bool is_prefix(IS is) const
+    {
+        return optimized && is >= 0 && (std::size_t)is >= optimized->symbols &&
+               (std::size_t)is < optimized->width.size();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief record of the rule as written that rule @p rule of an
+     *        optimized grammar stands for
+     * @param dot position of the dot in @p rule; receives that in the rule
+     *        returned
+     * @return @p rule itself for rules of prefixes, lexical rules and
+     *         grammars that have not been optimized
+     */
+    const Sym* original(const Sym* rule, unsigned& dot) const
+    {
+        if (!optimized || is_lexical(rule)) return rule;
+        std::uint32_t at = optimized->at[rule-rules];
+        if (at == 0) return rule;
+        IS first = rhs(rule)[0];
+        if (dot > 0 && is_prefix(first)) dot += optimized->width[first]-1;
+        return optimized->original.data()+at-1;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// sends the rules in text form to @p o, one per line
+    friend sost& operator<<(sost& o, const CompiledGrammar& g)
+    {
+        for (std::size_t s = 0; s < g.symbol_count(); ++s)
+        {
+            auto range = g.rules_for(s);
+            for (auto r = range.first; r != range.second; ++r)
+            {
+                const Sym* rule = g.rule(*r);
+                o << g.translate(lhs(rule)) << " -->";
+                for (unsigned i = 0; i < length(rule); ++i)
+                {
+                    o << " " << g.translate(rhs(rule)[i]);
+                }
+                o << "\n";
+            }
+        }
+        return o;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief compiled grammars do not close their predictions, see
+     *        \b StaticGrammar
+     * @return false
+     */
+    template <typename LEXICON>
+    bool closes_predictions(const LEXICON&) const
+    {
+        return false;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns an empty range, as the predictions are not closed
+    std::pair<const Sym*, const Sym*> predictions(IS) const
+    {
+        return std::pair<const Sym*, const Sym*>(nullptr, nullptr);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns marker of empty slots in the hash table
+    static std::uint32_t empty()
+    {
+        return static_cast<std::uint32_t>(-1);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// hash of symbol names; independent of platform and word size
+    static std::uint32_t image_hash(const char* p, std::size_t n)
+    {
+        std::uint32_t h = 2166136261u;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            h ^= (unsigned char)p[i];
+            h *= 16777619u;
+        }
+        return h;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+    /// sections of an image, as built or as changed by add_rule() and
+    /// remove_rule()
+    struct Sections
+    {
+        ImageHeader header;
+        sstr names;
+        std::vector<std::uint32_t> name_offsets;
+        std::vector<std::uint32_t> hash;
+        std::vector<Sym> rules;
+        std::vector<std::uint32_t> lhs_index;
+        std::vector<std::uint32_t> lhs_rules;
+        std::vector<Sym> lexical;
+    };
+////////////////////////////////////////////////////////////////////////////////
+    /// rule of a factored grammar, standing for up to 16 rules over the
+    /// same base categories, its members
+    struct Factored
+    {
+        /// factors the records from @p first to @p last, of the same base
+        /// categories, with the feature bits @p bit of their symbols
+        template <typename IT>
+        Factored(IT first, IT last, const std::vector<std::uint8_t>& bit)
+        :all(0),
+        length(CompiledGrammar::length(*first))
+        {
+            agree.assign(16*length, 0);
+            for (unsigned k = 0; first != last; ++first, ++k)
+            {
+                const Sym* r = *first;
+                all |= 1u << k;
+                lhs.push_back(bit[r[0]]);
+                for (unsigned i = 0; i < length; ++i)
+                {
+                    rhs.push_back(bit[CompiledGrammar::rhs(r)[i]]);
+                    agree[16*i+rhs.back()] |= 1u << k;
+                }
+                members.insert(members.end(), r, r+2+length);
+            }
+        }
+
+        std::uint16_t all;                       ///< one bit per member
+        unsigned length;                         ///< RHS length
+        std::vector<std::uint8_t> lhs;           ///< feature bit of every LHS
+        /// feature bit of RHS symbol i of member k, at k*length+i
+        std::vector<std::uint8_t> rhs;
+        /// members whose RHS symbol i has feature bit b, at 16*i+b
+        std::vector<std::uint16_t> agree;
+        std::vector<Sym> members;                ///< records of the members
+    };
+////////////////////////////////////////////////////////////////////////////////
+    /// feature tables of a factored grammar, see factor()
+    struct Features
+    {
+        std::size_t symbols;                     ///< symbols before factoring
+        ISVec base;                              ///< base of every symbol
+        std::vector<std::uint8_t> bit;           ///< feature bit of every symbol
+        std::vector<std::uint16_t> all;          ///< feature bits of every base
+        std::vector<Factored> rules;             ///< start rule first
+        std::vector<std::uint32_t> at;           ///< index in rules by record offset
+    };
+////////////////////////////////////////////////////////////////////////////////
+    /// tables of an optimized grammar, see optimize()
+    struct Optimized
+    {
+        std::size_t symbols;                     ///< symbols before optimizing
+        std::vector<Sym> original;               ///< records before, start rule first
+        /// offset in \b original plus 1 by record offset; 0 for the rules
+        /// of shared prefixes
+        std::vector<std::uint32_t> at;
+        /// number of symbols every symbol covers; more than 1 for prefixes
+        std::vector<unsigned> width;
+        /// for every symbol, begin of the categories above it in \b heads
+        /// and of those below it in \b tails
+        std::vector<std::uint32_t> head_index, tail_index;
+        ISVec heads;                             ///< heads of unary chains, sorted
+        ISVec tails;                             ///< tails of unary chains, sorted
+    };
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    CompiledGrammar(const CompiledGrammar&);
+    CompiledGrammar& operator=(const CompiledGrammar&);
+////////////////////////////////////////////////////////////////////////////////
+    /// constructs a variant of grammar @p of, see variant()
+    explicit CompiledGrammar(const std::shared_ptr<CompiledGrammar>& of)
+    :data(nullptr)
+    {
+        if (of->features || of->optimized)
+        {
+            throw std::runtime_error("a factored or optimized grammar has no variants");
+        }
+        header = of->header;
+        names = of->names;
+        name_offsets = of->name_offsets;
+        hash = of->hash;
+        rules = of->rules;
+        lhs_index = of->lhs_index;
+        lhs_rules = of->lhs_rules;
+        lexicals = of->lexicals;
+        if (of->base)
+        {
+            base = of->base;
+            rule_limit = of->rule_limit;
+            changed = of->changed;
+            own_rules = of->own_rules;
+            own_lexical = of->own_lexical;
+            rule_delta = of->rule_delta;
+            symbol_limit = of->symbol_limit;
+            extra = of->extra;
+            extra_ids = of->extra_ids;
+        }
+        else
+        {
+            base = of;
+            // the rules section may end in padding
+            rule_limit = (header->lhs_index-header->rules)/sizeof(Sym);
+            symbol_limit = of->first_extra() + of->extra.size();
+        }
+        // the sections of the grammar are kept until the variant is freed
+        ++base->variants;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns record of rule @p r of a \b Grammar
+    template <typename RULE>
+    static std::vector<Sym> record(const RULE& r)
+    {
+        std::vector<Sym> rec = { (Sym)*r.get_lhs()->begin(), (Sym)r.get_rhs()->size() };
+        rec.insert(rec.end(), r.get_rhs()->begin(), r.get_rhs()->end());
+        return rec;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief lays out the image of rule table @p t in \b buffer
+     * @details the rules of a LHS are in the order of their RHS, so the
+     *          image depends on the grammar file only
+     */
+    void build(const RuleTable& t)
+    {
+        const ESVec& symbols = t.symbols;
+        std::size_t n = symbols.size();
+        Sections s;
+
+        // rule records grouped by LHS, start rule first
+        s.rules = t.start;
+        s.lhs_index.assign(n+1, 0);
+        for (auto o = t.order.begin(); o != t.order.end(); ++o)
+        {
+            const Sym* r = t.rules.data() + *o;
+            ++s.lhs_index[r[0]+1];
+            s.lhs_rules.push_back(s.rules.size());
+            s.rules.insert(s.rules.end(), r, r+2+r[1]);
+        }
+        for (std::size_t i = 0; i < n; ++i) s.lhs_index[i+1] += s.lhs_index[i];
+
+        // names, lexical rules and hash table
+        s.name_offsets.push_back(0);
+        for (auto e = symbols.begin(); e != symbols.end(); ++e) add_symbol(s, *e);
+        rehash(s);
+
+        // lay out the sections, each aligned to 8 bytes
+        layout(s);
+        const ImageHeader& h = s.header;
+        buffer.assign(h.size/8, 0);
+        char* b = reinterpret_cast<char*>(buffer.data());
+        std::memcpy(b+h.names, s.names.data(), s.names.size());
+        std::memcpy(b+h.name_offsets, s.name_offsets.data(), s.name_offsets.size()*4);
+        std::memcpy(b+h.hash, s.hash.data(), s.hash.size()*4);
+        std::memcpy(b+h.rules, s.rules.data(), s.rules.size()*sizeof(Sym));
+        std::memcpy(b+h.lhs_index, s.lhs_index.data(), s.lhs_index.size()*4);
+        std::memcpy(b+h.lhs_rules, s.lhs_rules.data(), s.lhs_rules.size()*4);
+        std::memcpy(b+h.lexical, s.lexical.data(), s.lexical.size()*sizeof(Sym));
+        s.header.checksum = MappedFile::checksum(b+sizeof h, h.size-sizeof h);
+        std::memcpy(b, &h, sizeof h);
+        data = b;
+        attach();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// sets the counts, the section offsets and the size in the header of
+    /// @p s; the checksum is left to the caller
+    static void layout(Sections& s)
+    {
+        ImageHeader& h = s.header;
+        std::memset(&h, 0, sizeof h);
+        MappedFile::magic(h.magic, "EARLEYG");
+        h.version = ImageHeader::current();
+        h.header_size = sizeof h;
+        h.symbol_count = s.name_offsets.size()-1;
+        h.rule_count = s.lhs_rules.size();
+        h.start = 0;
+        h.hash_size = s.hash.size();
+        std::uint64_t at = sizeof h;
+        auto place = [&at](std::uint64_t& field, std::size_t bytes)
+        {
+            field = at;
+            at += (bytes+7) & ~std::size_t(7);
+        };
+        place(h.names, s.names.size());
+        place(h.name_offsets, s.name_offsets.size()*4);
+        place(h.hash, s.hash.size()*4);
+        place(h.rules, s.rules.size()*sizeof(Sym));
+        place(h.lhs_index, s.lhs_index.size()*4);
+        place(h.lhs_rules, s.lhs_rules.size()*4);
+        place(h.lexical, s.lexical.size()*sizeof(Sym));
+        h.size = at;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief appends symbol @p es to @p s with its name, lexical rule and
+     *        no rules; the hash table is left to the caller
+     */
+    static void add_symbol(Sections& s, const ES& es)
+    {
+        Sym id = s.name_offsets.size()-1;
+        s.names += es;
+        s.name_offsets.push_back(s.names.size());
+        s.lexical.push_back(id);
+        s.lexical.push_back(1);
+        s.lexical.push_back(id);
+        // a compiled grammar has the LHS offsets of all symbols already
+        if (s.lhs_index.size() < s.name_offsets.size()) s.lhs_index.push_back(s.lhs_index.back());
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// enters symbol @p id of @p s into the hash table of @p s
+    static void hash_symbol(Sections& s, std::uint32_t id)
+    {
+        std::uint32_t mask = s.hash.size()-1;
+        const char* p = s.names.data() + s.name_offsets[id];
+        std::size_t n = s.name_offsets[id+1] - s.name_offsets[id];
+        if (n == 0) return;
+        std::uint32_t i = image_hash(p, n) & mask;
+        while (s.hash[i] != empty()) i = (i+1) & mask;
+        s.hash[i] = id;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// builds the hash table of @p s with at least twice as many slots as
+    /// symbols
+    static void rehash(Sections& s)
+    {
+        std::size_t n = s.name_offsets.size()-1;
+        std::uint32_t hash_size = 16;
+        while (hash_size < 2*n) hash_size <<= 1;
+        s.hash.assign(hash_size, empty());
+        for (std::size_t id = 0; id < n; ++id) hash_symbol(s, id);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief sections to change; copied from the image on the first change,
+     *        which frees the image
+     * @throws std::runtime_error if the grammar has variants, which refer
+     *         to its sections
+     */
+    Sections& sections()
+    {
+        if (variants > 0) throw std::runtime_error("a grammar with variants cannot be changed");
+        if (edited) return *edited;
+        std::unique_ptr<Sections> s(new Sections);
+        std::size_t n = header->symbol_count;
+        s->names.assign(names, names+name_offsets[n]);
+        s->name_offsets.assign(name_offsets, name_offsets+n+1);
+        s->hash.assign(hash, hash+header->hash_size);
+        // the rules section may end in padding, which is never referred to
+        s->rules.assign(rules, rules+(header->lhs_index-header->rules)/sizeof(Sym));
+        s->lhs_index.assign(lhs_index, lhs_index+n+1);
+        s->lhs_rules.assign(lhs_rules, lhs_rules+header->rule_count);
+        s->lexical.assign(lexicals, lexicals+3*n);
+        edited = std::move(s);
+        attach_sections();
+        file.reset();
+        buffer = std::vector<std::uint64_t>();
+        data = nullptr;
+        return *edited;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// makes the symbols translated before but not compiled compiled
+    /// symbols, keeping their IDs, so that symbols can be added after them
+    Sections& compile_extra()
+    {
+        Sections& e = sections();
+        for (auto x = extra.begin(); x != extra.end(); ++x) add_symbol(e, *x);
+        extra.clear();
+        extra_ids.clear();
+        rehash(e);
+        attach_sections();
+        return e;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns ID of the first symbol in \b extra
+    std::size_t first_extra() const
+    {
+        return base ? symbol_limit : header->symbol_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief ID of symbol @p es as a compiled symbol. Symbols translated
+     *        before but not compiled, such as words, become compiled
+     *        symbols, and so does @p es if it is new; IDs do not change.
+     * @pre the grammar is being changed, see sections(), or is a variant
+     */
+    IS intern(const ES& es)
+    {
+        // a variant adds its symbols to its own, with a lexical rule of its
+        // own for those that are not compiled symbols
+        if (base)
+        {
+            IS is = translate(es);
+            if ((std::size_t)is >= symbol_count())
+            {
+                own_lexical.insert(std::make_pair(is, std::array<Sym, 3>{{ (Sym)is, 1, (Sym)is }}));
+            }
+            return is;
+        }
+        IS is = find(es.data(), es.size());
+        if (is != -1 && (std::size_t)is < symbol_count()) return is;
+        if (is == -1) is = translate(es);
+
+        Sections& s = *edited;
+        std::size_t first = s.name_offsets.size()-1;
+        for (auto e = extra.begin(); e != extra.end(); ++e) add_symbol(s, *e);
+        extra.clear();
+        extra_ids.clear();
+        if (s.hash.size() < 2*(s.name_offsets.size()-1)) rehash(s);
+        else for (std::size_t id = first; id+1 < s.name_offsets.size(); ++id) hash_symbol(s, id);
+        attach_sections();
+        return is;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief where rule record @p r is or would be among the rules of its
+     *        LHS, which are sorted like those of a \b RuleTable
+     * @return position among the rules of the LHS, see rules_for(), and
+     *         whether @p r is there
+     */
+    std::pair<std::size_t, bool> position(const std::vector<Sym>& r) const
+    {
+        auto range = rules_for(r[0]);
+        auto at = std::lower_bound(range.first, range.second, r.data(),
+                                   [this](std::uint32_t o, const Sym* x)
+        {
+            return RuleTable::less(rule(o), x);
+        });
+        bool found = at != range.second && !RuleTable::less(r.data(), rule(*at));
+        return std::make_pair(at-range.first, found);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the rule offsets of @p lhs in a variant, copied from its
+    /// grammar on the first change
+    std::vector<std::uint32_t>& own_rules_for(IS lhs)
+    {
+        auto c = changed.find(lhs);
+        if (c != changed.end()) return c->second;
+        auto range = rules_for(lhs);
+        std::vector<std::uint32_t>& own = changed[lhs];
+        own.assign(range.first, range.second);
+        return own;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// checks that \b data holds a complete and intact image
+    void validate(const sstr& path) const
+    {
+        const ImageHeader* h = reinterpret_cast<const ImageHeader*>(data);
+        char m[8];
+        MappedFile::magic(m, "EARLEYG");
+        if (file->size() < sizeof *h || std::memcmp(h->magic, "EARLEYG", 7) != 0)
+        {
+            throw LoadError("'"+path+"' is no grammar image");
+        }
+        if (std::memcmp(h->magic, m, 8) != 0)
+        {
+            throw LoadError("'"+path+"' has been compiled on a machine of "
+                            "different byte order");
+        }
+        if (h->version != ImageHeader::current() || h->header_size != sizeof *h)
+        {
+            throw LoadError("'"+path+"' has image version "+
+                            helper::to_string(h->version)+", expected "+
+                            helper::to_string(ImageHeader::current())+
+                            "; compile the grammar again");
+        }
+        if (h->size > file->size() || h->lexical + 12*(std::uint64_t)h->symbol_count > h->size)
+        {
+            throw LoadError("'"+path+"' is truncated");
+        }
+        if (MappedFile::checksum(data+sizeof *h, h->size-sizeof *h) != h->checksum)
+        {
+            throw LoadError("'"+path+"' is corrupt: checksum mismatch");
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// sets the section pointers into \b edited, after updating its header
+    void attach_sections()
+    {
+        Sections& s = *edited;
+        layout(s);
+        header = &s.header;
+        names = s.names.data();
+        name_offsets = s.name_offsets.data();
+        hash = s.hash.data();
+        rules = s.rules.data();
+        lhs_index = s.lhs_index.data();
+        lhs_rules = s.lhs_rules.data();
+        lexicals = s.lexical.data();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// sets the section pointers into \b data
+    void attach()
+    {
+        header = reinterpret_cast<const ImageHeader*>(data);
+        names = data + header->names;
+        name_offsets = reinterpret_cast<const std::uint32_t*>(data + header->name_offsets);
+        hash = reinterpret_cast<const std::uint32_t*>(data + header->hash);
+        rules = reinterpret_cast<const Sym*>(data + header->rules);
+        lhs_index = reinterpret_cast<const std::uint32_t*>(data + header->lhs_index);
+        lhs_rules = reinterpret_cast<const std::uint32_t*>(data + header->lhs_rules);
+        lexicals = reinterpret_cast<const Sym*>(data + header->lexical);
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::unique_ptr<MappedFile> file;    ///< the image file, if any
+    std::vector<std::uint64_t> buffer;   ///< the image, if built in memory
+    const char* data;                    ///< the image
+    const ImageHeader* header;           ///< sections of the image
+    const char* names;
+    const std::uint32_t* name_offsets;
+    const std::uint32_t* hash;
+    const Sym* rules;
+    const std::uint32_t* lhs_index;
+    const std::uint32_t* lhs_rules;
+    const Sym* lexicals;
+    ESVec extra;                         ///< symbols added by translate()
+    std::unordered_map<ES, IS> extra_ids;///< IDs of \b extra
+    std::vector<bool> words;             ///< symbols marked as words
+    std::unique_ptr<Sections> edited;    ///< the sections, once changed
+    /// grammar a variant has been made from; nullptr for other grammars
+    std::shared_ptr<CompiledGrammar> base;
+    /// offsets of the rules of the LHS a variant has changed
+    std::unordered_map<IS, std::vector<std::uint32_t>> changed;
+    std::vector<Sym> own_rules;          ///< records added to a variant
+    /// offset of the first record in \b own_rules
+    std::uint32_t rule_limit = static_cast<std::uint32_t>(-1);
+    /// ID of the first symbol in \b extra of a variant; those before are
+    /// the symbols of its grammar
+    std::size_t symbol_limit = 0;
+    /// lexical rules of the symbols of a variant that are not compiled
+    std::unordered_map<IS, std::array<Sym, 3>> own_lexical;
+    std::ptrdiff_t rule_delta = 0;       ///< rules a variant adds, net
+    std::atomic<unsigned> variants{0};   ///< variants made from the grammar
+    std::unique_ptr<Features> features;  ///< tables, once factored
+    std::unique_ptr<Optimized> optimized;///< tables, once optimized
+////////////////////////////////////////////////////////////////////////////////
+}; // CompiledGrammar
+
+} // Earley
+
+#endif // __COMPILED__HPP
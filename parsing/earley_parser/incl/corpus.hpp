@@ -0,0 +1,360 @@
+/**
+ * @file corpus.hpp
+ * Binary corpus. A text corpus that is parsed again and again can be
+ * converted once into a binary corpus, in which every token has already
+ * been looked up in the lexicon: it holds the index of every word and of
+ * its ambiguity class, and the parser starts from these indices without
+ * touching a single string. The indices are only valid for the lexicon
+ * the corpus was converted with, so the corpus records the fingerprint of
+ * that lexicon and is refused by any other.
+ *
+ * A binary corpus starts with a \b CorpusHeader followed by the sections
+ * it refers to:
+ *
+ *     sentences        index of the first token of every sentence, plus 1
+ *                      for the end
+ *     words            lexicon index of every token. Tokens not in the
+ *                      lexicon have indices from the lexicon's word count
+ *                      on, which refer to the unknown words below
+ *     classes          ambiguity class of every token; Lexicon::none()
+ *                      for unknown words
+ *     unknown_chars    unknown words, concatenated
+ *     unknown_offsets  offset of every unknown word, plus 1 for the end
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __CORPUS__HPP
+#define __CORPUS__HPP
+
+#include "declarations.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "helper.hpp"
+#include "grammar.hpp"
+#include "io.hpp"
+#include "mapped.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+/// header of a binary corpus
+struct CorpusHeader
+{
+    char magic[8];                 ///< "EARLEYC" and the byte order mark
+    std::uint32_t version;         ///< format version, see \b current()
+    std::uint32_t header_size;     ///< sizeof(CorpusHeader)
+    std::uint64_t size;            ///< size of the whole corpus in bytes
+    std::uint64_t checksum;        ///< FNV-1a of all bytes after the header
+    std::uint64_t lexicon;         ///< fingerprint of the lexicon
+    std::uint32_t word_count;      ///< number of words of the lexicon
+    std::uint32_t unknown_count;   ///< number of unknown words
+    std::uint64_t sentence_count;  ///< number of sentences
+    std::uint64_t token_count;     ///< number of tokens
+    std::uint64_t sentences;       ///< byte offsets of the sections
+    std::uint64_t words;
+    std::uint64_t classes;
+    std::uint64_t unknown_chars;
+    std::uint64_t unknown_offsets;
+
+    /// @returns version of the corpus format written by this code
+    static std::uint32_t current() { return 1; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                BinaryCorpus                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief binary corpus, mapped read-only into memory
+ * @details hands out one sentence at a time through next(), like
+ *          \b IO::SentenceReader, or any sentence through sentence()
+ * @tparam LEXICON lexicon type, \b Earley::Lexicon<IS, ES>
+ */
+template <typename LEXICON>
+class BinaryCorpus
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                     //     PUBLIC TYPES
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief tokens of a sentence; points into the corpus
+     * @details iterating over a sentence yields the text of its tokens
+     */
+    struct Sentence
+    {
+        const std::uint32_t* words;      ///< lexicon index of every token
+        const std::uint32_t* classes;    ///< ambiguity class of every token
+        std::size_t count;               ///< number of tokens
+        const BinaryCorpus* corpus;      ///< the corpus, for the text
+
+        /// iterator over the text of the tokens
+        struct const_iterator
+        {
+            const Sentence* s;
+            std::size_t i;
+            helper::StrView operator*() const { return s->corpus->text(s->words[i]); }
+            const_iterator& operator++() { ++i; return *this; }
+            bool operator==(const const_iterator& o) const { return i == o.i; }
+            bool operator!=(const const_iterator& o) const { return i != o.i; }
+        };
+
+        Sentence()
+        :words(nullptr), classes(nullptr), count(0), corpus(nullptr)
+        {
+        }
+
+        std::size_t size() const { return count; }
+        const_iterator begin() const { return const_iterator{this, 0}; }
+        const_iterator end() const { return const_iterator{this, count}; }
+    };
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief maps binary corpus @p path for use with @p lexicon, which must
+     *        stay alive as long as the corpus
+     * @throws LoadError if @p path cannot be read, is no valid binary
+     *         corpus or has been converted with another lexicon
+     */
+    BinaryCorpus(const sstr& path, const LEXICON& lexicon)
+    :file(new MappedFile(path)),
+    lexicon(lexicon),
+    current(0)
+    {
+        validate(path);
+        const char* data = file->data();
+        auto section = [data](std::uint64_t at)
+        {
+            return reinterpret_cast<const std::uint32_t*>(data + at);
+        };
+        sentences = reinterpret_cast<const std::uint64_t*>(data + header->sentences);
+        words = section(header->words);
+        classes = section(header->classes);
+        unknown_chars = data + header->unknown_chars;
+        unknown_offsets = section(header->unknown_offsets);
+        file->advise_sequential();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if file @p path starts like a binary corpus
+    static bool is_corpus(const sstr& path)
+    {
+        return MappedFile::has_magic(path, "EARLEYC");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief converts the text corpus @p input into a binary corpus at
+     *        @p path, looking up its tokens in @p lexicon. Sentences are
+     *        split as by \b IO::SentenceReader.
+     * @return number of sentences
+     * @throws LoadError if @p input cannot be read
+     * @throws std::runtime_error if @p path cannot be written
+     */
+    static std::size_t convert(const sstr& input, const LEXICON& lexicon, const sstr& path)
+    {
+        IO::CorpusReader reader(input);
+        std::vector<std::uint64_t> sentences(1, 0);
+        std::vector<std::uint32_t> words, classes, unknown_offsets(1, 0);
+        sstr unknown_chars;
+        std::unordered_map<sstr, std::uint32_t> unknown;
+
+        IO::CorpusReader::Sentence s;
+        while (reader.next(s))
+        {
+            for (auto t = s.begin(); t != s.end(); ++t)
+            {
+                unsigned w = lexicon.find(t->data(), t->size());
+                if (w == LEXICON::none())
+                {
+                    auto u = unknown.insert(std::make_pair(t->str(), unknown.size()));
+                    if (u.second)
+                    {
+                        unknown_chars.append(t->data(), t->size());
+                        unknown_offsets.push_back(unknown_chars.size());
+                    }
+                    words.push_back(lexicon.word_count() + u.first->second);
+                    classes.push_back(LEXICON::none());
+                }
+                else
+                {
+                    words.push_back(w);
+                    classes.push_back(lexicon.get_class(w));
+                }
+            }
+            sentences.push_back(words.size());
+        }
+
+        // lay out the sections, each aligned to 8 bytes
+        CorpusHeader h;
+        std::memset(&h, 0, sizeof h);
+        MappedFile::magic(h.magic, "EARLEYC");
+        h.version = CorpusHeader::current();
+        h.header_size = sizeof h;
+        h.lexicon = lexicon.fingerprint();
+        h.word_count = lexicon.word_count();
+        h.unknown_count = unknown.size();
+        h.sentence_count = sentences.size()-1;
+        h.token_count = words.size();
+        std::uint64_t at = sizeof h;
+        std::vector<std::pair<const void*, std::size_t>> sections;
+        auto place = [&](std::uint64_t& field, const void* p, std::size_t bytes)
+        {
+            field = at;
+            sections.push_back(std::make_pair(p, bytes));
+            at += (bytes+7) & ~std::size_t(7);
+        };
+        place(h.sentences, sentences.data(), sentences.size()*8);
+        place(h.words, words.data(), words.size()*4);
+        place(h.classes, classes.data(), classes.size()*4);
+        place(h.unknown_chars, unknown_chars.data(), unknown_chars.size());
+        place(h.unknown_offsets, unknown_offsets.data(), unknown_offsets.size()*4);
+        h.size = at;
+
+        // the sections are written as they are, as they may be large; the
+        // header follows once the checksum is known
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<const char*>(&h), sizeof h);
+        const char zeros[8] = {0};
+        h.checksum = MappedFile::checksum(nullptr, 0);
+        for (auto sec = sections.begin(); sec != sections.end(); ++sec)
+        {
+            const char* p = static_cast<const char*>(sec->first);
+            std::size_t pad = ((sec->second+7) & ~std::size_t(7)) - sec->second;
+            f.write(p, sec->second);
+            f.write(zeros, pad);
+            h.checksum = MappedFile::checksum(p, sec->second, h.checksum);
+            h.checksum = MappedFile::checksum(zeros, pad, h.checksum);
+        }
+        f.seekp(0);
+        f.write(reinterpret_cast<const char*>(&h), sizeof h);
+        if (!f) throw std::runtime_error("failed to write '"+path+"'");
+        return h.sentence_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of sentences
+    std::size_t size() const
+    {
+        return header->sentence_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of tokens
+    std::size_t token_count() const
+    {
+        return header->token_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns sentence @p i
+    Sentence sentence(std::size_t i) const
+    {
+        Sentence s;
+        s.words = words + sentences[i];
+        s.classes = classes + sentences[i];
+        s.count = sentences[i+1] - sentences[i];
+        s.corpus = this;
+        return s;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief sets @p s to the next sentence
+     * @return false if all sentences have been handed out
+     */
+    bool next(Sentence& s)
+    {
+        if (current >= size()) return false;
+        s = sentence(current++);
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns text of the word with index @p w, which is a lexicon index
+    /// or refers to an unknown word of the corpus
+    helper::StrView text(std::uint32_t w) const
+    {
+        if (w < header->word_count) return lexicon.view_word(w);
+        w -= header->word_count;
+        return helper::StrView(unknown_chars + unknown_offsets[w],
+                               unknown_offsets[w+1] - unknown_offsets[w]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns lexicon index of word @p w; LEXICON::none() if @p w is unknown
+    unsigned entry(std::uint32_t w) const
+    {
+        return w < header->word_count ? w : LEXICON::none();
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    BinaryCorpus(const BinaryCorpus&);
+    BinaryCorpus& operator=(const BinaryCorpus&);
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief checks magic, byte order, version, size, checksum and lexicon
+     *        of the corpus
+     * @throws LoadError on the first check that fails
+     */
+    void validate(const sstr& path)
+    {
+        header = reinterpret_cast<const CorpusHeader*>(file->data());
+        const CorpusHeader* h = header;
+        char m[8];
+        MappedFile::magic(m, "EARLEYC");
+        if (file->size() < sizeof *h || std::memcmp(h->magic, "EARLEYC", 7) != 0)
+        {
+            throw LoadError("'"+path+"' is no binary corpus");
+        }
+        if (std::memcmp(h->magic, m, 8) != 0)
+        {
+            throw LoadError("'"+path+"' has been converted on a machine of "
+                            "different byte order");
+        }
+        if (h->version != CorpusHeader::current() || h->header_size != sizeof *h)
+        {
+            throw LoadError("'"+path+"' has corpus version "+
+                            helper::to_string(h->version)+", expected "+
+                            helper::to_string(CorpusHeader::current())+
+                            "; convert the corpus again");
+        }
+        if (h->size > file->size() ||
+            h->unknown_offsets + 4*((std::uint64_t)h->unknown_count+1) > h->size)
+        {
+            throw LoadError("'"+path+"' is truncated");
+        }
+        if (MappedFile::checksum(file->data()+sizeof *h, h->size-sizeof *h) != h->checksum)
+        {
+            throw LoadError("'"+path+"' is corrupt: checksum mismatch");
+        }
+        if (h->lexicon != lexicon.fingerprint() || h->word_count != lexicon.word_count())
+        {
+            throw LoadError("'"+path+"' has been converted with another lexicon; "
+                            "convert the corpus again");
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::unique_ptr<MappedFile> file;      ///< the corpus
+    const LEXICON& lexicon;                ///< lexicon of the indices
+    const CorpusHeader* header;            ///< header within \b file
+    const std::uint64_t* sentences;        ///< sections within \b file
+    const std::uint32_t* words;
+    const std::uint32_t* classes;
+    const char* unknown_chars;
+    const std::uint32_t* unknown_offsets;
+    std::size_t current;                   ///< next sentence of next()
+////////////////////////////////////////////////////////////////////////////////
+}; // BinaryCorpus
+
+} // Earley
+
+#endif // __CORPUS__HPP
@@ -0,0 +1,879 @@
+/**
+ * @file daemon.hpp
+ * Parse daemon and its client. \b Daemon keeps a loaded grammar in memory
+ * and serves parse requests over a Unix domain socket, so the grammar and
+ * lexicon need to be loaded once only instead of once per invocation.
+ * Requests arriving at about the same time, on one or several connections,
+ * are collected into small batches that are worked off on a pool of
+ * threads. \b DaemonStats counts requests, batches, the depth of the queue
+ * and the latencies. \b DaemonClient is the other end of the socket.
+ * The grammar is taken from a \b SnapshotStore and can be reloaded while
+ * the daemon is serving; requests may pick one of its variants by name.
+ *
+ * Messages in either direction are frames of the form
+ *
+ *     length (4 bytes) | id (4 bytes) | type (1 byte) | payload
+ *
+ * with length and id in network byte order; length counts all bytes after
+ * the length field. Request types are 'P' (parse the tokens in the payload,
+ * separated by white space), 'V' (parse the tokens after the first one with
+ * the grammar variant the first one names), 'S' (send counters) and 'L'
+ * (reload the grammar; answered once the new grammar is in use). Response types are
+ * 'R' (payload "1" if recognised, "0" if not), 'S' (counters as text) and
+ * 'E' (error message). A response has the id of its request; responses to
+ * parse requests may arrive in a different order than their requests.
+ *
+ * Only available on Unix-like systems.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ */
+
+#ifndef __DAEMON__HPP
+#define __DAEMON__HPP
+
+#include "declarations.hpp"
+
+#ifdef UNIXLIKE
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "async.hpp"
+#include "helper.hpp"
+#include "snapshot.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+/// thrown if a socket cannot be set up
+struct SocketError : public std::runtime_error
+{
+    explicit SocketError(const sstr& what)
+    :std::runtime_error(what + ": " + std::strerror(errno))
+    {
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                    Frame                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief message exchanged between daemon and client
+ */
+struct Frame
+{
+    std::uint32_t id;     ///< chosen by the client, echoed in the response
+    char type;            ///< see the file description
+    sstr payload;         ///< content; depends on \b type
+
+    /// largest payload accepted; protects against garbage on the socket
+    static std::uint32_t max_payload()
+    {
+        return 1 << 24;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief writes frame of type @p type and id @p id with payload @p data
+     *        of @p n bytes to socket @p fd
+     * @return false if the frame could not be written completely
+     */
+    static bool write(int fd, std::uint32_t id, char type, const char* data, std::size_t n)
+    {
+        char head[9];
+        std::uint32_t length = htonl(static_cast<std::uint32_t>(n + 5));
+        std::uint32_t nid = htonl(id);
+        std::memcpy(head, &length, 4);
+        std::memcpy(head+4, &nid, 4);
+        head[8] = type;
+        return write_all(fd, head, sizeof head) && write_all(fd, data, n);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// writes this frame to socket @p fd
+    bool write(int fd) const
+    {
+        return write(fd, id, type, payload.data(), payload.size());
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief reads the next frame from socket @p fd into this frame
+     * @return false on end of stream or a malformed frame
+     */
+    bool read(int fd)
+    {
+        char head[9];
+        if (!read_all(fd, head, sizeof head)) return false;
+        std::uint32_t length, nid;
+        std::memcpy(&length, head, 4);
+        std::memcpy(&nid, head+4, 4);
+        length = ntohl(length);
+        if (length < 5 || length-5 > max_payload()) return false;
+        id = ntohl(nid);
+        type = head[8];
+        payload.resize(length-5);
+        return read_all(fd, &payload[0], payload.size());
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:
+    static bool write_all(int fd, const char* p, std::size_t n)
+    {
+        while (n > 0)
+        {
+            ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            p += w;
+            n -= w;
+        }
+        return true;
+    }
+
+    static bool read_all(int fd, char* p, std::size_t n)
+    {
+        while (n > 0)
+        {
+            ssize_t r = ::recv(fd, p, n, 0);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) return false;
+            p += r;
+            n -= r;
+        }
+        return true;
+    }
+}; // Frame
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                 DaemonStats                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief counters of a \b Daemon; may be updated from any thread
+ * @details latencies are measured from the arrival of a request to the
+ *          response having been written, in microseconds. Besides their
+ *          sum and maximum they are counted in buckets of powers of 2.
+ */
+struct DaemonStats
+{
+    typedef std::atomic<std::uint64_t>                                  Counter;
+
+    static const unsigned buckets = 24;    ///< last bucket: >= 2^23 us
+
+    Counter requests{0};                   ///< parse requests answered
+    Counter batches{0};                    ///< batches dispatched
+    Counter queued{0};                     ///< requests waiting right now
+    Counter max_queued{0};                 ///< highest value of \b queued
+    Counter connections{0};                ///< connections accepted
+    Counter reloads{0};                    ///< grammars reloaded
+    Counter latency_sum{0};                ///< sum of latencies in us
+    Counter latency_max{0};                ///< highest latency in us
+    Counter latency[buckets] = {};         ///< bucket i: < 2^i us
+////////////////////////////////////////////////////////////////////////////////
+    /// counts @p us as latency of a request
+    void record(std::uint64_t us)
+    {
+        ++requests;
+        latency_sum += us;
+        update_max(latency_max, us);
+        unsigned b = 0;
+        while (b+1 < buckets && (std::uint64_t(1) << b) <= us) ++b;
+        ++latency[b];
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// counts a request entering the queue
+    void enqueue()
+    {
+        update_max(max_queued, ++queued);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the counters as lines of "name value"
+    sstr to_string() const
+    {
+        std::ostringstream o;
+        std::uint64_t n = requests;
+        o << "requests " << n << '\n'
+          << "batches " << batches << '\n'
+          << "connections " << connections << '\n'
+          << "reloads " << reloads << '\n'
+          << "queue_depth " << queued << '\n'
+          << "queue_depth_max " << max_queued << '\n'
+          << "latency_us_mean " << (n ? latency_sum / n : 0) << '\n'
+          << "latency_us_max " << latency_max << '\n';
+        for (unsigned b = 0; b < buckets; ++b)
+        {
+            if (latency[b] == 0) continue;
+            if (b+1 < buckets) o << "latency_us_lt_" << (std::uint64_t(1) << b);
+            else o << "latency_us_ge_" << (std::uint64_t(1) << (b-1));
+            o << ' ' << latency[b] << '\n';
+        }
+        return o.str();
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:
+    static void update_max(Counter& c, std::uint64_t v)
+    {
+        std::uint64_t old = c;
+        while (old < v && !c.compare_exchange_weak(old, v)) {}
+    }
+}; // DaemonStats
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                   Daemon                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief serves parse requests over a Unix domain socket
+ * @details every connection has a thread reading its requests into a
+ *          common queue. A dispatcher takes requests off the queue in
+ *          batches: once a request has arrived it waits at most \b window
+ *          microseconds for the batch to fill up to \b batch_size requests.
+ *          Every batch is divided among the workers of an \b Executor; each
+ *          part is parsed with a parser taken from a pool, so parsers and
+ *          their charts are reused. A part is parsed entirely on the
+ *          snapshot its parser belongs to; after a reload, parsers on the
+ *          old snapshot are dropped from the pool once they are done. A
+ *          reload requested by a client runs on the executor as well and
+ *          is answered when it completes.
+ * @tparam PARSER parser type, e.g. \b Earley::EarleyParser<GRAMMAR>
+ */
+template <typename PARSER>
+class Daemon
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef PARSER                                                           Parser;
+typedef Earley::SnapshotStore<PARSER>                             SnapshotStore;
+typedef typename SnapshotStore::SnapshotPtr                         SnapshotPtr;
+typedef typename SnapshotStore::Snapshot::Registry                     Registry;
+typedef std::chrono::steady_clock                                         Clock;
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+    /// client connection; closed once the last request on it is answered
+    struct Connection
+    {
+        explicit Connection(int fd) :fd(fd) {}
+        ~Connection() { ::close(fd); }
+
+        /// sends @p type response @p data to request @p id
+        bool respond(std::uint32_t id, char type, const sstr& data)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return Frame::write(fd, id, type, data.data(), data.size());
+        }
+
+        const int fd;
+        std::mutex mutex;    ///< serialises responses
+    };
+
+    /// thread reading from a connection
+    struct Reader
+    {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done; ///< set when it returns
+    };
+
+    /// parser in the pool; destroyed before the snapshot it refers to
+    struct Pooled
+    {
+        SnapshotPtr snapshot;
+        sstr grammar;                    ///< name of the grammar parsed with
+        std::unique_ptr<Parser> parser;
+    };
+
+    /// parse request waiting in the queue
+    struct Request
+    {
+        std::shared_ptr<Connection> connection;
+        std::uint32_t id;
+        sstr grammar;                    ///< name; "" for the grammar itself
+        sstr sentence;
+        Clock::time_point arrival;
+    };
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs a daemon
+     * @param store holds the grammar to parse with
+     * @param threads number of worker threads; 0 selects the number of cores
+     * @param batch_size maximum number of requests per batch
+     * @param window microseconds to wait for a batch to fill up
+     */
+    Daemon(SnapshotStore& store, unsigned threads=0,
+           unsigned batch_size=16, unsigned window=200)
+    :store(store),
+    batch_size(batch_size > 0 ? batch_size : 1),
+    window(window),
+    listener(-1),
+    reloading(false),
+    stopped(false),
+    inflight(0),
+    executor(threads)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// stops serving, if not done yet
+    ~Daemon()
+    {
+        stop();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief serves requests on socket @p path until stop() is called or
+     *        @p stop_flag becomes non-zero. Whenever @p reload_flag becomes
+     *        non-zero, it is reset and the grammar is reloaded in the
+     *        background. An existing socket file at @p path is replaced.
+     * @throws SocketError if the socket cannot be set up
+     */
+    void serve(const sstr& path, volatile std::sig_atomic_t* stop_flag=nullptr,
+               volatile std::sig_atomic_t* reload_flag=nullptr)
+    {
+        sockaddr_un address;
+        if (path.size() >= sizeof address.sun_path)
+        {
+            errno = ENAMETOOLONG;
+            throw SocketError(path);
+        }
+        std::memset(&address, 0, sizeof address);
+        address.sun_family = AF_UNIX;
+        std::strcpy(address.sun_path, path.c_str());
+
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) throw SocketError("socket");
+        ::unlink(path.c_str());
+        if (::bind(listener, (sockaddr*)&address, sizeof address) < 0 ||
+            ::listen(listener, 64) < 0)
+        {
+            ::close(listener);
+            listener = -1;
+            throw SocketError(path);
+        }
+
+        std::thread dispatcher(&Daemon::dispatch, this);
+        pollfd p = { listener, POLLIN, 0 };
+        // poll with a timeout, so that the flags are checked regularly
+        std::thread reloader;
+        while (!stopped && !(stop_flag && *stop_flag))
+        {
+            if (reload_flag && *reload_flag && !reloading)
+            {
+                *reload_flag = 0;
+                reloading = true;
+                if (reloader.joinable()) reloader.join();
+                reloader = std::thread([this]{
+                    sstr result = reload();
+                    helper::msg("reload:", result, "", -1, std::cerr, COLOR::GREEN);
+                    reloading = false;
+                });
+            }
+            if (::poll(&p, 1, 100) <= 0) continue;
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) continue;
+            ++stats.connections;
+            reap();
+            std::shared_ptr<std::atomic<bool>> done(new std::atomic<bool>(false));
+            std::lock_guard<std::mutex> lock(mutex);
+            open.push_back(fd);
+            Reader r = { std::thread(&Daemon::read, this,
+                                     std::make_shared<Connection>(fd), done), done };
+            readers.push_back(std::move(r));
+        }
+        stop();
+        dispatcher.join();
+        if (reloader.joinable()) reloader.join();
+        // answer the batches and reloads posted already
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [this]{ return inflight == 0; });
+        }
+        ::close(listener);
+        listener = -1;
+        ::unlink(path.c_str());
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief makes serve() return: stops accepting connections and reading
+     *        requests. Requests read already are still answered.
+     */
+    void stop()
+    {
+        std::vector<Reader> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+            // wake the readers blocked on their sockets
+            for (auto fd = open.begin(); fd != open.end(); ++fd)
+            {
+                ::shutdown(*fd, SHUT_RD);
+            }
+            finished.swap(readers);
+        }
+        wakeup.notify_all();
+        for (auto r = finished.begin(); r != finished.end(); ++r) r->thread.join();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the number of grammars of @p r, the bytes their variants
+    /// hold and the counters of their result caches, summed, as lines of
+    /// "name value"
+    static sstr cache_stats(const Registry& r)
+    {
+        std::uint64_t hits = 0, misses = 0, entries = 0;
+        std::vector<sstr> names = r.names();
+        for (auto n = names.begin(); n != names.end(); ++n)
+        {
+            const ResultCache& c = r.cache(*n);
+            hits += c.hits();
+            misses += c.misses();
+            entries += c.size();
+        }
+        std::ostringstream o;
+        o << "grammars " << names.size() << '\n'
+          << "variant_bytes " << r.variant_size() << '\n'
+          << "cache_hits " << hits << '\n'
+          << "cache_misses " << misses << '\n'
+          << "cache_entries " << entries << '\n';
+        return o.str();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the counters
+    const DaemonStats& get_stats() const
+    {
+        return stats;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief reloads the grammar and drops idle parsers on the old one.
+     *        Parses in progress finish on the old grammar.
+     * @return description of the outcome
+     */
+    sstr reload()
+    {
+        try
+        {
+            SnapshotPtr next = store.reload();
+            ++stats.reloads;
+            drop_stale(next);
+            return "generation " + std::to_string(next->generation) + "\n";
+        }
+        catch (const std::exception& e)
+        {
+            return sstr("failed, keeping the current grammar: ") + e.what() + "\n";
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// joins the readers of connections that have been closed
+    void reap()
+    {
+        std::vector<Reader> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto end = std::partition(readers.begin(), readers.end(),
+                                      [](const Reader& r){ return !*r.done; });
+            std::move(end, readers.end(), std::back_inserter(finished));
+            readers.erase(end, readers.end());
+        }
+        for (auto r = finished.begin(); r != finished.end(); ++r) r->thread.join();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief reads requests from @p connection until it is closed; sets
+     *        @p done before returning
+     */
+    void read(std::shared_ptr<Connection> connection,
+              std::shared_ptr<std::atomic<bool>> done)
+    {
+        Frame frame;
+        while (frame.read(connection->fd))
+        {
+            if (frame.type == 'S')
+            {
+                connection->respond(frame.id, 'S', stats.to_string() +
+                                    cache_stats(*store.current()->grammars));
+                continue;
+            }
+            if (frame.type == 'L')
+            {
+                // a reload may wait for the grammar before last to be
+                // freed, so the connection is read on meanwhile
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++inflight;
+                }
+                std::uint32_t id = frame.id;
+                executor.post([this, connection, id]
+                {
+                    connection->respond(id, 'S', reload());
+                    finished();
+                });
+                continue;
+            }
+            if (frame.type != 'P' && frame.type != 'V')
+            {
+                connection->respond(frame.id, 'E', "unknown request type");
+                continue;
+            }
+            Request r = { connection, frame.id, sstr(), sstr(), Clock::now() };
+            r.sentence.swap(frame.payload);
+            if (frame.type == 'V')
+            {
+                std::size_t end = r.sentence.find(' ');
+                r.grammar = r.sentence.substr(0, end);
+                r.sentence.erase(0, end == sstr::npos ? end : end+1);
+                if (!store.current()->grammars->has(r.grammar))
+                {
+                    connection->respond(frame.id, 'E', "no grammar named '"+r.grammar+"'");
+                    continue;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back(std::move(r));
+                stats.enqueue();
+            }
+            wakeup.notify_one();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto fd = open.begin(); fd != open.end(); ++fd)
+        {
+            if (*fd == connection->fd) { open.erase(fd); break; }
+        }
+        *done = true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief collects batches from the queue and posts them to the executor.
+     *        A batch is split among the workers, so that the sentences of
+     *        one batch are still parsed in parallel.
+     */
+    void dispatch()
+    {
+        std::vector<Request> batch;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this]{ return stopped || !queue.empty(); });
+                if (queue.empty()) return;
+                // give concurrent requests a moment to join the batch
+                auto deadline = queue.front().arrival + std::chrono::microseconds(window);
+                while (!stopped && queue.size() < batch_size &&
+                       wakeup.wait_until(lock, deadline) != std::cv_status::timeout) {}
+                std::size_t n = std::min<std::size_t>(batch_size, queue.size());
+                batch.clear();
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+                stats.queued -= n;
+            }
+            ++stats.batches;
+            std::size_t parts = std::min(batch.size(), executor.size());
+            for (std::size_t p = 0; p < parts; ++p)
+            {
+                std::shared_ptr<std::vector<Request>> part(new std::vector<Request>);
+                for (std::size_t i = p; i < batch.size(); i += parts)
+                {
+                    part->push_back(std::move(batch[i]));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++inflight;
+                }
+                executor.post([this, part]{ work(*part); });
+            }
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// parses and answers the requests of @p batch
+    void work(std::vector<Request>& batch)
+    {
+        Pooled pooled;
+        std::vector<const char*> tokens;
+        std::vector<std::size_t> lengths;
+        for (auto r = batch.begin(); r != batch.end(); ++r)
+        {
+            // the requests of a batch may be for different grammars
+            if (!pooled.parser || pooled.grammar != r->grammar)
+            {
+                release(pooled);
+                pooled = acquire(r->grammar);
+            }
+            Parser* parser = pooled.parser.get();
+            if (!parser)
+            {
+                // the grammar has gone with a reload
+                r->connection->respond(r->id, 'E', "no grammar named '"+r->grammar+"'");
+                r->connection.reset();
+                continue;
+            }
+            split(r->sentence, tokens, lengths);
+            parser->begin(tokens.data(), lengths.data(), tokens.size());
+            parser->advance();
+            bool accepted = parser->accepted();
+            r->connection->respond(r->id, 'R', accepted ? "1" : "0");
+            stats.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                         Clock::now() - r->arrival).count());
+            // release the connection as soon as possible
+            r->connection.reset();
+        }
+        release(pooled);
+        finished();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// counts a task posted to the executor as done
+    void finished()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --inflight;
+        }
+        idle.notify_all();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief takes a parser on grammar @p grammar of the current snapshot
+     *        from the pool or creates one
+     * @return a \b Pooled without parser, if there is no such grammar
+     */
+    Pooled acquire(const sstr& grammar)
+    {
+        SnapshotPtr snapshot = store.current();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto p = parsers.begin(); p != parsers.end();)
+            {
+                // parsers on a replaced snapshot are dropped on the way
+                if (p->snapshot != snapshot) { p = parsers.erase(p); continue; }
+                if (p->grammar == grammar)
+                {
+                    Pooled found = std::move(*p);
+                    parsers.erase(p);
+                    return found;
+                }
+                ++p;
+            }
+        }
+        Pooled p;
+        if (!snapshot->grammars->has(grammar)) return p;
+        p.snapshot = snapshot;
+        p.grammar = grammar;
+        p.parser = snapshot->make_parser(grammar);
+        return p;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// returns @p pooled to the pool, unless it has no parser or is on a
+    /// replaced snapshot; @p pooled is empty afterwards
+    void release(Pooled& pooled)
+    {
+        if (pooled.parser)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // parsers on a replaced snapshot are not reused
+            if (pooled.snapshot == store.current()) parsers.push_back(std::move(pooled));
+        }
+        pooled = Pooled();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// removes the parsers not on snapshot @p current from the pool
+    void drop_stale(const SnapshotPtr& current)
+    {
+        std::vector<Pooled> stale;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto end = std::partition(parsers.begin(), parsers.end(),
+                       [&current](const Pooled& p){ return p.snapshot == current; });
+            std::move(end, parsers.end(), std::back_inserter(stale));
+            parsers.erase(end, parsers.end());
+        }
+        // the old snapshot is freed here, unless a parse still uses it
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// stores start and length of every white space separated token of @p s
+    static void split(const sstr& s, std::vector<const char*>& tokens,
+                      std::vector<std::size_t>& lengths)
+    {
+        tokens.clear();
+        lengths.clear();
+        std::size_t i = 0;
+        while (i < s.size())
+        {
+            while (i < s.size() && std::isspace((unsigned char)s[i])) ++i;
+            std::size_t start = i;
+            while (i < s.size() && !std::isspace((unsigned char)s[i])) ++i;
+            if (i == start) break;
+            tokens.push_back(s.data()+start);
+            lengths.push_back(i-start);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    SnapshotStore& store;              ///< current grammar
+    const std::size_t batch_size;      ///< maximum requests per batch
+    const unsigned window;             ///< microseconds to wait for a batch
+    int listener;                      ///< listening socket
+    DaemonStats stats;                 ///< counters
+    std::atomic<bool> reloading;       ///< set while a reload is running
+    std::mutex mutex;                  ///< guards all fields below
+    std::condition_variable wakeup;    ///< signals requests or stopping
+    bool stopped;                      ///< set by stop()
+    std::size_t inflight;              ///< tasks posted, not yet done
+    std::condition_variable idle;      ///< signals \b inflight reaching 0
+    std::deque<Request> queue;         ///< requests waiting for a batch
+    std::vector<Reader> readers;       ///< one thread per connection
+    std::vector<int> open;             ///< sockets still being read
+    std::vector<Pooled> parsers;       ///< idle parsers
+    Executor executor;                 ///< worker threads; destroyed first
+////////////////////////////////////////////////////////////////////////////////
+}; // Daemon
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                DaemonClient                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief connection to a \b Daemon
+ * @details requests can be sent without waiting for the previous response,
+ *          so that the daemon can batch them.
+ */
+class DaemonClient
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief connects to the daemon on socket @p path
+     * @throws SocketError if the connection fails
+     */
+    explicit DaemonClient(const sstr& path)
+    {
+        sockaddr_un address;
+        if (path.size() >= sizeof address.sun_path)
+        {
+            errno = ENAMETOOLONG;
+            throw SocketError(path);
+        }
+        std::memset(&address, 0, sizeof address);
+        address.sun_family = AF_UNIX;
+        std::strcpy(address.sun_path, path.c_str());
+
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) throw SocketError("socket");
+        if (::connect(fd, (sockaddr*)&address, sizeof address) < 0)
+        {
+            ::close(fd);
+            throw SocketError(path);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    ~DaemonClient()
+    {
+        ::close(fd);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// sends the tokens of @p sentence as request @p id, to be parsed with
+    /// grammar variant @p grammar unless it is empty; tokens are strings or
+    /// \b helper::StrView
+    template <typename SENTENCE>
+    bool send(std::uint32_t id, const SENTENCE& sentence, const sstr& grammar="")
+    {
+        sstr payload = grammar.empty() ? grammar : grammar+' ';
+        for (auto t = sentence.begin(); t != sentence.end(); ++t)
+        {
+            if (t != sentence.begin()) payload += ' ';
+            payload.append(t->data(), t->size());
+        }
+        return Frame::write(fd, id, grammar.empty() ? 'P' : 'V', payload.data(), payload.size());
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief receives the next response into @p id and @p accepted
+     * @throws std::runtime_error if the daemon reports an error or closes
+     *         the connection
+     */
+    void receive(std::uint32_t& id, bool& accepted)
+    {
+        Frame frame;
+        if (!frame.read(fd)) throw std::runtime_error("connection to daemon lost");
+        if (frame.type == 'E') throw std::runtime_error("daemon: " + frame.payload);
+        id = frame.id;
+        accepted = frame.payload == "1";
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief requests the counters of the daemon
+     * @pre no parse requests may be outstanding
+     */
+    sstr stats()
+    {
+        return request('S');
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief makes the daemon reload its grammar; returns once the new
+     *        grammar is in use or the reload has failed
+     * @return the outcome as reported by the daemon
+     * @pre no parse requests may be outstanding
+     */
+    sstr reload()
+    {
+        return request('L');
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// sends a request of type @p type without payload; @returns the answer
+    sstr request(char type)
+    {
+        Frame frame;
+        if (!Frame::write(fd, 0, type, nullptr, 0) || !frame.read(fd))
+        {
+            throw std::runtime_error("connection to daemon lost");
+        }
+        return frame.payload;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    int fd;  ///< connected socket
+////////////////////////////////////////////////////////////////////////////////
+}; // DaemonClient
+
+} // Earley
+
+#endif // UNIXLIKE
+
+#endif // __DAEMON__HPP
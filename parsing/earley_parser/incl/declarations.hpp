@@ -55,6 +55,11 @@ namespace helper
     using namespace Declarations;
 }
 
+namespace IO
+{
+    using namespace Declarations;
+}
+
 namespace std
 {
     using namespace Declarations;
@@ -0,0 +1,506 @@
+/**
+ * @file dump.hpp
+ * Binary chart dump. \b ChartDumpWriter streams the items of any number of
+ * charts to a file, cell by cell, straight from the chart; nothing is
+ * copied but the rules and symbols the items refer to, which are numbered
+ * anew so a dump does not depend on the grammar it was made with.
+ * \b ChartDump maps a dump read-only into memory for queries and for
+ * comparing the charts of two grammar versions.
+ *
+ * A chart dump starts with a \b ChartDumpHeader followed by the sections
+ * it refers to:
+ *
+ *     items           \b DumpItem of every item, cell after cell
+ *     cells           index of the first item of every cell, plus 1 for
+ *                     the end
+ *     charts          \b DumpChart of every chart
+ *     rules           rule records [lhs, rhs length, rhs symbols...] of
+ *                     the items, in dump symbol IDs
+ *     symbol_chars    symbol names, concatenated
+ *     symbol_offsets  offset of every symbol name, plus 1 for the end
+ *     token_chars     tokens of the charts, concatenated
+ *     token_offsets   offset of every token, plus 1 for the end
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __DUMP__HPP
+#define __DUMP__HPP
+
+#include "declarations.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "helper.hpp"
+#include "grammar.hpp"
+#include "mapped.hpp"
+#include "tokenizer.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+/// header of a chart dump
+struct ChartDumpHeader
+{
+    char magic[8];                 ///< "EARLEYD" and the byte order mark
+    std::uint32_t version;         ///< format version, see \b current()
+    std::uint32_t header_size;     ///< sizeof(ChartDumpHeader)
+    std::uint64_t size;            ///< size of the whole dump in bytes
+    std::uint64_t checksum;        ///< FNV-1a of all bytes after the header
+    std::uint32_t chart_count;     ///< number of charts
+    std::uint32_t symbol_count;    ///< number of symbols
+    std::uint64_t item_count;      ///< number of items of all charts
+    std::uint64_t cell_count;      ///< number of cells of all charts
+    std::uint64_t rule_size;       ///< number of int32 in the rules section
+    std::uint64_t token_count;     ///< number of tokens of all charts
+    std::uint64_t items;           ///< byte offsets of the sections
+    std::uint64_t cells;
+    std::uint64_t charts;
+    std::uint64_t rules;
+    std::uint64_t symbol_chars;
+    std::uint64_t symbol_offsets;
+    std::uint64_t token_chars;
+    std::uint64_t token_offsets;
+
+    /// @returns version of the dump format written by this code
+    static std::uint32_t current() { return 1; }
+};
+
+/// item of a chart dump
+struct DumpItem
+{
+    std::uint32_t rule;            ///< offset of the rule record
+    std::int16_t dot;              ///< index of the dot
+    std::int16_t from;             ///< left span border
+    std::int16_t to;               ///< right span border
+    std::int16_t unused;           ///< 0
+};
+
+/// chart of a chart dump
+struct DumpChart
+{
+    std::uint64_t first_cell;      ///< index of the first cell in cells
+    std::uint64_t first_token;     ///< index of the first token
+    std::uint32_t cell_count;      ///< number of cells; tokens are one less
+    std::uint32_t recognised;      ///< 1, if the chart holds the final item
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               ChartDumpWriter                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief writes charts of type \b CHART to a chart dump
+ * @details items go to the file as they are read from the chart; the
+ *          header and the small sections follow in close()
+ * @tparam CHART chart type, e.g. \b Earley::EarleyChart<PARSER>
+ */
+template <typename CHART>
+class ChartDumpWriter
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// the compiled grammar type of the chart
+typedef typename CHART::Grammar                                         Grammar;
+/// the type defined in the \b Grammar for internal symbols
+typedef typename Grammar::IS                                                 IS;
+/// the symbol type within rule records
+typedef typename Grammar::Sym                                               Sym;
+/// the word scanned at every index
+typedef std::vector<helper::StrView>                                  WordViews;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief creates chart dump @p path for charts parsed with @p g, which
+     *        must outlive the writer
+     * @throws std::runtime_error if @p path cannot be written
+     */
+    ChartDumpWriter(const sstr& path, const Grammar& g)
+    :g(g),
+    path(path),
+    f(path, std::ios::binary | std::ios::trunc),
+    item_count(0)
+    {
+        if (!f) throw std::runtime_error("failed to write '"+path+"'");
+        std::memset(&h, 0, sizeof h);
+        f.write(reinterpret_cast<const char*>(&h), sizeof h);
+        h.checksum = MappedFile::checksum(nullptr, 0);
+        buffer.reserve(4096);
+        symbol_offsets.push_back(0);
+        token_offsets.push_back(0);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// completes the dump, unless close() has been called
+    ~ChartDumpWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief appends chart @p chart
+     * @param words the word scanned at every index; used as the tokens, if
+     *        the chart does not know them
+     */
+    void write(const CHART& chart, const WordViews& words)
+    {
+        DumpChart c;
+        c.first_cell = cells.size();
+        c.first_token = token_offsets.size()-1;
+        c.cell_count = chart.size();
+        c.recognised = chart.size() > 0 && chart[chart.size()-1].count(chart.get_final()) > 0;
+        charts.push_back(c);
+
+        const auto& tokens = chart.get_tokens();
+        for (long i = 0; i+1 < chart.size(); ++i)
+        {
+            if (i < (long)tokens.size()) add_token(helper::StrView(tokens[i]));
+            else if (i < (long)words.size()) add_token(words[i]);
+            else add_token(helper::StrView());
+        }
+
+        for (long i = 0; i < chart.size(); ++i)
+        {
+            cells.push_back(item_count);
+            const auto& cell = chart[i];
+            for (auto item = cell.begin(); item != cell.end(); ++item)
+            {
+                // the items of an optimized grammar are dumped with the
+                // rules as written, see CompiledGrammar::original()
+                unsigned dot = item->dot;
+                DumpItem d;
+                d.rule = rule(g.original(item->rule, dot));
+                d.dot = dot;
+                d.from = item->from;
+                d.to = item->to;
+                d.unused = 0;
+                buffer.push_back(d);
+                if (buffer.size() == buffer.capacity()) drain();
+                ++item_count;
+            }
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief writes the remaining sections and the header
+     * @throws std::runtime_error if the dump cannot be written
+     */
+    void close()
+    {
+        if (!f.is_open()) return;
+        drain();
+        put(nullptr, 0, item_count*sizeof(DumpItem));
+        cells.push_back(item_count);
+
+        h.items = sizeof h;
+        std::uint64_t at = sizeof h + pad(item_count*sizeof(DumpItem));
+        auto place = [&](std::uint64_t& field, const void* p, std::size_t bytes)
+        {
+            field = at;
+            put(static_cast<const char*>(p), bytes);
+            at += pad(bytes);
+        };
+        place(h.cells, cells.data(), cells.size()*8);
+        place(h.charts, charts.data(), charts.size()*sizeof(DumpChart));
+        place(h.rules, rules.data(), rules.size()*4);
+        place(h.symbol_chars, symbol_chars.data(), symbol_chars.size());
+        place(h.symbol_offsets, symbol_offsets.data(), symbol_offsets.size()*4);
+        place(h.token_chars, token_chars.data(), token_chars.size());
+        place(h.token_offsets, token_offsets.data(), token_offsets.size()*8);
+
+        MappedFile::magic(h.magic, "EARLEYD");
+        h.version = ChartDumpHeader::current();
+        h.header_size = sizeof h;
+        h.size = at;
+        h.chart_count = charts.size();
+        h.symbol_count = symbol_offsets.size()-1;
+        h.item_count = item_count;
+        h.cell_count = cells.size()-1;
+        h.rule_size = rules.size();
+        h.token_count = token_offsets.size()-1;
+        f.seekp(0);
+        f.write(reinterpret_cast<const char*>(&h), sizeof h);
+        f.close();
+        if (!f) throw std::runtime_error("failed to write '"+path+"'");
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    ChartDumpWriter(const ChartDumpWriter&);
+    ChartDumpWriter& operator=(const ChartDumpWriter&);
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns @p bytes rounded up to a multiple of 8
+    static std::uint64_t pad(std::uint64_t bytes)
+    {
+        return (bytes+7) & ~std::uint64_t(7);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// writes the @p n bytes at @p p and pads them to a multiple of 8, or
+    /// pads @p written bytes written before
+    void put(const char* p, std::size_t n, std::uint64_t written=0)
+    {
+        const char zeros[8] = {0};
+        std::size_t padding = pad(written+n) - (written+n);
+        f.write(p, n);
+        f.write(zeros, padding);
+        h.checksum = MappedFile::checksum(p, n, h.checksum);
+        h.checksum = MappedFile::checksum(zeros, padding, h.checksum);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// writes the buffered items; items are 12 bytes, so the section is
+    /// padded by close() only
+    void drain()
+    {
+        const char* p = reinterpret_cast<const char*>(buffer.data());
+        std::size_t n = buffer.size()*sizeof(DumpItem);
+        f.write(p, n);
+        h.checksum = MappedFile::checksum(p, n, h.checksum);
+        buffer.clear();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns dump ID of grammar symbol @p is
+    std::uint32_t symbol(IS is)
+    {
+        auto s = symbols.insert(std::make_pair(is, (std::uint32_t)symbol_offsets.size()-1));
+        if (s.second)
+        {
+            sstr name = g.translate(is);
+            symbol_chars.append(name);
+            symbol_offsets.push_back(symbol_chars.size());
+        }
+        return s.first->second;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns offset of the dump record of grammar rule record @p r
+    std::uint32_t rule(const Sym* r)
+    {
+        auto i = offsets.insert(std::make_pair(r, (std::uint32_t)rules.size()));
+        if (i.second)
+        {
+            rules.push_back(symbol(Grammar::lhs(r)));
+            rules.push_back(Grammar::length(r));
+            const Sym* rhs = Grammar::rhs(r);
+            for (std::size_t k = 0; k < Grammar::length(r); ++k)
+            {
+                rules.push_back(symbol(rhs[k]));
+            }
+        }
+        return i.first->second;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    void add_token(const helper::StrView& t)
+    {
+        token_chars.append(t.data(), t.size());
+        token_offsets.push_back(token_chars.size());
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    const Grammar& g;                               ///< grammar of the charts
+    sstr path;                                      ///< path of the dump
+    std::ofstream f;                                ///< the dump
+    ChartDumpHeader h;                              ///< header, once complete
+    std::vector<DumpItem> buffer;                   ///< items not yet written
+    std::uint64_t item_count;                       ///< items written
+    std::vector<std::uint64_t> cells;               ///< sections
+    std::vector<DumpChart> charts;
+    std::vector<std::int32_t> rules;
+    sstr symbol_chars;
+    std::vector<std::uint32_t> symbol_offsets;
+    sstr token_chars;
+    std::vector<std::uint64_t> token_offsets;
+    std::unordered_map<IS, std::uint32_t> symbols;  ///< dump IDs of symbols
+    std::unordered_map<const Sym*, std::uint32_t> offsets; ///< of rules
+////////////////////////////////////////////////////////////////////////////////
+}; // ChartDumpWriter
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  ChartDump                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief chart dump, mapped read-only into memory
+ */
+class ChartDump
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// the items of a cell
+typedef std::pair<const DumpItem*, const DumpItem*>                        Cell;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief maps chart dump @p path
+     * @throws LoadError if @p path cannot be read or is no valid dump
+     */
+    explicit ChartDump(const sstr& path)
+    :file(new MappedFile(path))
+    {
+        validate(path);
+        const char* data = file->data();
+        items = reinterpret_cast<const DumpItem*>(data + header->items);
+        cells = reinterpret_cast<const std::uint64_t*>(data + header->cells);
+        charts = reinterpret_cast<const DumpChart*>(data + header->charts);
+        rules = reinterpret_cast<const std::int32_t*>(data + header->rules);
+        symbol_chars = data + header->symbol_chars;
+        symbol_offsets = reinterpret_cast<const std::uint32_t*>(data + header->symbol_offsets);
+        token_chars = data + header->token_chars;
+        token_offsets = reinterpret_cast<const std::uint64_t*>(data + header->token_offsets);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if file @p path starts like a chart dump
+    static bool is_dump(const sstr& path)
+    {
+        return MappedFile::has_magic(path, "EARLEYD");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the header
+    const ChartDumpHeader& info() const
+    {
+        return *header;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of charts
+    std::size_t size() const
+    {
+        return header->chart_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns chart @p c
+    const DumpChart& chart(std::size_t c) const
+    {
+        return charts[c];
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns items of cell @p i of chart @p c
+    Cell cell(std::size_t c, std::size_t i) const
+    {
+        std::uint64_t k = charts[c].first_cell + i;
+        return Cell(items + cells[k], items + cells[k+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns token @p i of chart @p c
+    helper::StrView token(std::size_t c, std::size_t i) const
+    {
+        std::uint64_t t = charts[c].first_token + i;
+        return helper::StrView(token_chars + token_offsets[t],
+                               token_offsets[t+1] - token_offsets[t]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns name of dump symbol @p s
+    helper::StrView name(std::int32_t s) const
+    {
+        return helper::StrView(symbol_chars + symbol_offsets[s],
+                               symbol_offsets[s+1] - symbol_offsets[s]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns rule record of @p item
+    const std::int32_t* rule(const DumpItem& item) const
+    {
+        return rules + item.rule;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns name of the left hand side of @p item
+    helper::StrView lhs(const DumpItem& item) const
+    {
+        return name(rule(item)[0]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns @p item as a dotted rule with its span, which does not
+    /// depend on the symbol IDs, e.g. "NP --> Det . N' [0,1]"
+    sstr show(const DumpItem& item) const
+    {
+        const std::int32_t* r = rule(item);
+        sstr s = name(r[0]).str() + " -->";
+        for (std::int32_t i = 0; i <= r[1]; ++i)
+        {
+            if (i == item.dot) s += " .";
+            if (i == r[1]) break;
+            s += " ";
+            s += name(r[2+i]).str();
+        }
+        return s + " [" + helper::to_string(item.from) + "," + helper::to_string(item.to) + "]";
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    ChartDump(const ChartDump&);
+    ChartDump& operator=(const ChartDump&);
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief checks magic, byte order, version, size and checksum
+     * @throws LoadError on the first check that fails
+     */
+    void validate(const sstr& path)
+    {
+        header = reinterpret_cast<const ChartDumpHeader*>(file->data());
+        const ChartDumpHeader* h = header;
+        char m[8];
+        MappedFile::magic(m, "EARLEYD");
+        if (file->size() < sizeof *h || std::memcmp(h->magic, "EARLEYD", 7) != 0)
+        {
+            throw LoadError("'"+path+"' is no chart dump");
+        }
+        if (std::memcmp(h->magic, m, 8) != 0)
+        {
+            throw LoadError("'"+path+"' has been written on a machine of "
+                            "different byte order");
+        }
+        if (h->version != ChartDumpHeader::current() || h->header_size != sizeof *h)
+        {
+            throw LoadError("'"+path+"' has dump version "+
+                            helper::to_string(h->version)+", expected "+
+                            helper::to_string(ChartDumpHeader::current()));
+        }
+        if (h->size > file->size() ||
+            h->token_offsets + 8*(h->token_count+1) > h->size)
+        {
+            throw LoadError("'"+path+"' is truncated");
+        }
+        if (MappedFile::checksum(file->data()+sizeof *h, h->size-sizeof *h) != h->checksum)
+        {
+            throw LoadError("'"+path+"' is corrupt: checksum mismatch");
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::unique_ptr<MappedFile> file;       ///< the dump
+    const ChartDumpHeader* header;          ///< header within \b file
+    const DumpItem* items;                  ///< sections within \b file
+    const std::uint64_t* cells;
+    const DumpChart* charts;
+    const std::int32_t* rules;
+    const char* symbol_chars;
+    const std::uint32_t* symbol_offsets;
+    const char* token_chars;
+    const std::uint64_t* token_offsets;
+////////////////////////////////////////////////////////////////////////////////
+}; // ChartDump
+
+} // Earley
+
+#endif // __DUMP__HPP
@@ -0,0 +1,160 @@
+/**
+ * @file earley.h
+ * C interface of the Earley parser library (libearley). A grammar is
+ * loaded once together with its tags and words and can then be used by
+ * any number of parsers, one per thread. Sentences are passed as arrays of
+ * token pointers and lengths; the tokens are looked up in place and not
+ * copied.
+ * All functions returning a pointer return NULL on failure, all functions
+ * returning int return -1. earley_last_error() then describes the error.
+ *
+ * Matthias Bisping
+ */
+
+#ifndef __EARLEY__H
+#define __EARLEY__H
+
+#include <stddef.h>
+
+#if defined _WIN32
+    #ifdef EARLEY_BUILD
+    #define EARLEY_API __declspec(dllexport)
+    #else
+    #define EARLEY_API
+    #endif
+#else
+    #define EARLEY_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** version of this interface; incremented on incompatible changes */
+#define EARLEY_API_VERSION 1
+
+/** grammar, tags and words; shared by parsers */
+typedef struct earley_grammar earley_grammar;
+/** parser with its own chart */
+typedef struct earley_parser earley_parser;
+
+/** @returns EARLEY_API_VERSION of the library */
+EARLEY_API int earley_api_version(void);
+
+/**
+ * @brief describes the last error on the calling thread
+ * @return error message; empty if there was no error
+ */
+EARLEY_API const char* earley_last_error(void);
+
+/**
+ * @brief loads a grammar, its POS-tags and its words from files
+ * @param grammar grammar file; max 1 rule per line, or a grammar image
+ *        made by 'parse.out compile'
+ * @param tags POS-tag file; max 1 tag per line
+ * @param words words file; tokens followed by exactly 1 tag per line, or a
+ *        lexicon image made by 'parse.out compile'
+ * @return grammar handle or NULL
+ */
+EARLEY_API earley_grammar* earley_grammar_load(const char* grammar,
+                                               const char* tags,
+                                               const char* words);
+
+/** frees @p g; all parsers on @p g must have been freed before */
+EARLEY_API void earley_grammar_free(earley_grammar* g);
+
+/** @returns number of words in the lexicon of @p g */
+EARLEY_API size_t earley_grammar_words(const earley_grammar* g);
+
+/**
+ * @brief creates a parser on grammar @p g
+ * @details a parser must not be used by several threads at once; several
+ *          parsers on the same grammar may be used in parallel
+ * @return parser handle or NULL
+ */
+EARLEY_API earley_parser* earley_parser_new(earley_grammar* g);
+
+/** frees @p p */
+EARLEY_API void earley_parser_free(earley_parser* p);
+
+/**
+ * @brief parses a sentence
+ * @param p parser
+ * @param tokens @p n pointers to the tokens; need not be 0-terminated
+ * @param lengths @p n token lengths in bytes
+ * @param n number of tokens
+ * @return 1 if the sentence has been recognised, 0 if not, -1 on error
+ */
+EARLEY_API int earley_parse(earley_parser* p,
+                            const char* const* tokens,
+                            const size_t* lengths,
+                            size_t n);
+
+/**
+ * @brief starts a sentence whose tokens are passed one at a time with
+ *        earley_push(), e.g. while they are being typed or recognised
+ * @return 0, or -1 on error
+ */
+EARLEY_API int earley_begin(earley_parser* p);
+
+/**
+ * @brief appends a token to the sentence started by earley_begin()
+ * @param token the token; need not be 0-terminated
+ * @param length token length in bytes
+ * @return 1 if the tokens passed so far can begin a sentence of the grammar,
+ *         0 if not, -1 on error
+ */
+EARLEY_API int earley_push(earley_parser* p, const char* token, size_t length);
+
+/**
+ * @brief ends the sentence started by earley_begin()
+ * @return 1 if the sentence has been recognised, 0 if not, -1 on error
+ */
+EARLEY_API int earley_finish(earley_parser* p);
+
+/**
+ * @brief edits the last sentence and parses it again: replaces the @p count
+ *        tokens at @p index by the @p n tokens @p tokens. Only the chart
+ *        cells after @p index are processed again.
+ * @return 1 if the edited sentence has been recognised, 0 if not, -1 on
+ *         error
+ */
+EARLEY_API int earley_edit(earley_parser* p, size_t index, size_t count,
+                           const char* const* tokens,
+                           const size_t* lengths,
+                           size_t n);
+
+/** @returns number of chart cells of the last sentence kept by earley_edit() */
+EARLEY_API size_t earley_reused_cells(const earley_parser* p);
+
+/**
+ * @brief words that can follow the tokens passed so far, e.g. for
+ *        completion while a sentence is typed
+ * @param words receives up to @p max pointers into the lexicon; the words
+ *        are not 0-terminated and remain valid as long as the grammar
+ * @param lengths receives the lengths of the words
+ * @param max room in @p words and @p lengths; may be 0 to count the words
+ * @return number of words that can follow; 0 on error
+ */
+EARLEY_API size_t earley_expected_words(earley_parser* p,
+                                        const char** words,
+                                        size_t* lengths,
+                                        size_t max);
+
+/** @returns number of tokens of the last sentence not in the lexicon */
+EARLEY_API size_t earley_unknown_tokens(const earley_parser* p);
+
+/** @returns 1 if token @p i of the last sentence is in the lexicon, else 0 */
+EARLEY_API int earley_token_known(const earley_parser* p, size_t i);
+
+/** @returns number of cells of the chart of the last sentence */
+EARLEY_API size_t earley_chart_cells(const earley_parser* p);
+
+/** @returns number of items in cell @p i of the chart of the last sentence */
+EARLEY_API size_t earley_chart_items(const earley_parser* p, size_t i);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EARLEY__H */
@@ -0,0 +1,429 @@
+/**
+ * @file export.hpp
+ * Chart export. \b ChartExporter renders the items of an
+ * \b Earley::EarleyChart as text, as JSON Lines or as a Graphviz DOT graph.
+ * Output is collected in a large buffer that is handed to the stream when
+ * it is full and at the end of each chart; the stream is never flushed.
+ * Symbol names are translated once per exporter and kept, so rendering an
+ * item copies no strings. Cells and categories can be filtered. Items of
+ * an optimized grammar are shown with the rules as written.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __EXPORT__HPP
+#define __EXPORT__HPP
+
+#include "declarations.hpp"
+
+#include <cstdio>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "helper.hpp"
+#include "tokenizer.hpp"
+
+namespace Earley
+{
+/// output formats of \b ChartExporter
+enum class ChartFormat
+{
+    text,   ///< cells and dotted rules, as shown at verbosity 3
+    jsonl,  ///< one JSON object per item
+    dot     ///< Graphviz graph with a node per cell and an edge per item
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief parses @p name into @p format
+ * @return false, if @p name is not "text", "jsonl" or "dot"
+ */
+inline bool parse_chart_format(const sstr& name, ChartFormat& format)
+{
+    if (name == "text") format = ChartFormat::text;
+    else if (name == "jsonl") format = ChartFormat::jsonl;
+    else if (name == "dot") format = ChartFormat::dot;
+    else return false;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                ChartExporter                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief renders charts of type \b CHART into a buffer, which is written
+ *        to a stream in large blocks
+ * @details an exporter may be used for any number of charts parsed with
+ *          the same grammar; symbol names stay cached in between
+ * @tparam CHART chart type, e.g. \b Earley::EarleyChart<PARSER>
+ */
+template <typename CHART>
+class ChartExporter
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// the compiled grammar type of the chart
+typedef typename CHART::Grammar                                         Grammar;
+/// the \b Item type of the chart
+typedef typename CHART::Item                                               Item;
+/// the type defined in the \b Grammar for internal symbols
+typedef typename Grammar::IS                                                 IS;
+/// the type defined in the \b Grammar for external symbols
+typedef typename Grammar::ES                                                 ES;
+/// the symbol type within rule records
+typedef typename Grammar::Sym                                               Sym;
+/// the word scanned at every index
+typedef std::vector<helper::StrView>                                  WordViews;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs exporter writing to @p o
+     * @param g grammar to translate the symbols of the items with; must
+     *        outlive the exporter
+     * @param format output format
+     * @param capacity size of the buffer in bytes
+     */
+    ChartExporter(const Grammar& g, sost& o, ChartFormat format=ChartFormat::text,
+                  std::size_t capacity=1 << 20)
+    :
+    g(g),
+    o(o),
+    format(format),
+    capacity(capacity),
+    first_cell(0),
+    last_cell(-1),
+    charts(0),
+    rule_width(60)
+    {
+        buffer.reserve(capacity + 4096);
+        // same width as helper::fill_line
+        if (helper::stdout_is_terminal()) rule_width = helper::get_terminal_columns();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// writes what is left in the buffer to the stream
+    ~ChartExporter()
+    {
+        drain();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// restricts output to cells @p first to @p last; -1 for @p last means
+    /// up to the last cell
+    void set_cells(long first, long last=-1)
+    {
+        first_cell = first;
+        last_cell = last;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// restricts output to items with left hand side @p category. Items of
+    /// all categories are shown, if none has been added.
+    void add_category(const ES& category)
+    {
+        categories.insert(category);
+        category_ids.clear();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief renders chart @p chart and writes it to the stream
+     * @param words the word scanned at every index, shown for lexical items
+     *        instead of their tag; may be empty
+     */
+    void write(const CHART& chart, const WordViews& words)
+    {
+        if (!categories.empty() && category_ids.empty()) resolve_categories();
+        if (format == ChartFormat::text) put("\n");
+        else if (format == ChartFormat::dot) begin_graph(chart);
+        const auto& tokens = chart.get_tokens();
+        long last = last_cell < 0 ? chart.size()-1 : last_cell;
+        for (long i = first_cell; i <= last && i < chart.size(); ++i)
+        {
+            if (format == ChartFormat::text)
+            {
+                put("CHART[");
+                put_number(i);
+                put("] ('");
+                if (i < (long)tokens.size()) put(tokens[i]);
+                put("')\n\n");
+            }
+            const auto& cell = chart[i];
+            for (auto item = cell.begin(); item != cell.end(); ++item)
+            {
+                if (!shown(*item)) continue;
+                const helper::StrView* word = item->from < (short)words.size()
+                                            ? &words[item->from] : nullptr;
+                if (format == ChartFormat::text) put_text(*item, word);
+                else if (format == ChartFormat::jsonl) put_json(*item, i, word);
+                else put_edge(*item, i, word);
+                if (buffer.size() >= capacity) drain();
+            }
+            if (format == ChartFormat::text)
+            {
+                buffer.append(rule_width, '_');
+                put("\n\n");
+            }
+        }
+        if (format == ChartFormat::text) put("\n");
+        else if (format == ChartFormat::dot) put("}\n");
+        ++charts;
+        drain();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// writes the buffer to the stream without flushing the stream
+    void drain()
+    {
+        if (buffer.empty()) return;
+        o.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns cached name of symbol @p is
+    const sstr& name(IS is)
+    {
+        if (is < 0) return unknown;
+        if ((std::size_t)is >= names.size())
+        {
+            names.resize(is+1);
+            cached.resize(is+1, false);
+        }
+        if (!cached[is])
+        {
+            names[is] = g.translate(is);
+            cached[is] = true;
+        }
+        return names[is];
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// looks up the IDs of the categories to show
+    void resolve_categories()
+    {
+        for (auto c = categories.begin(); c != categories.end(); ++c)
+        {
+            category_ids.insert(g.find(c->data(), c->size()));
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if @p item passes the category filter
+    bool shown(const Item& item) const
+    {
+        return category_ids.empty() || category_ids.count(item.get_lhs()) > 0;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    void put(const char* s)
+    {
+        buffer.append(s);
+    }
+
+    void put(const sstr& s)
+    {
+        buffer.append(s);
+    }
+
+    void put(const helper::StrView& s)
+    {
+        buffer.append(s.data(), s.size());
+    }
+
+    void put_number(long n)
+    {
+        char digits[24];
+        int length = std::snprintf(digits, sizeof(digits), "%ld", n);
+        buffer.append(digits, length);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// appends @p s with the characters escaped that JSON and DOT strings
+    /// cannot hold as they are
+    template <typename STR>
+    void put_escaped(const STR& s)
+    {
+        for (auto c = s.begin(); c != s.end(); ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                buffer.push_back('\\');
+                buffer.push_back(*c);
+            }
+            else if ((unsigned char)*c < 0x20)
+            {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "\\u%04x", (unsigned)*c);
+                buffer.append(hex);
+            }
+            else buffer.push_back(*c);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the right hand side of @p item is shown as @p word
+    bool shows_word(const Item& item, const helper::StrView* word) const
+    {
+        return word && g.is_lexical(item.rule);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief rule to show @p item with: the rule as written that the rule
+     *        of @p item stands for, if the grammar has been optimized, see
+     *        \b CompiledGrammar::optimize()
+     * @param dot receives the position of the dot in that rule
+     */
+    const Sym* shown_rule(const Item& item, int& dot) const
+    {
+        unsigned d = item.dot;
+        const Sym* rule = g.original(item.rule, d);
+        dot = d;
+        return rule;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// appends @p item as a dotted rule, like \b EarleyItem::show
+    void put_text(const Item& item, const helper::StrView* word)
+    {
+        put(name(item.get_lhs()));
+        #ifdef UNIXLIKE
+        put(" \t⟶\t");
+        #else
+        put(" \t-->\t");
+        #endif
+        int dot;
+        const Sym* rule = shown_rule(item, dot);
+        const Sym* rhs = Grammar::rhs(rule);
+        int length = Grammar::length(rule);
+        bool lexical = shows_word(item, word);
+        for (int i = 0; i < length; ++i)
+        {
+            if (i == dot)
+            {
+                #ifdef UNIXLIKE
+                put("•");
+                #else
+                put(".");
+                #endif
+            }
+            if (i >= dot) put(" ");
+            if (lexical) put(*word);
+            else put(name(rhs[i]));
+            if (i < dot) put(" ");
+        }
+        #ifdef UNIXLIKE
+        if (dot >= length) put("•");
+        #else
+        if (dot >= length) put(".");
+        #endif
+        put("\n");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// appends @p item in cell @p cell as a JSON object on a line of its own
+    void put_json(const Item& item, long cell, const helper::StrView* word)
+    {
+        put("{\"chart\":");
+        put_number(charts);
+        put(",\"cell\":");
+        put_number(cell);
+        put(",\"from\":");
+        put_number(item.from);
+        put(",\"to\":");
+        put_number(item.to);
+        int dot;
+        const Sym* rule = shown_rule(item, dot);
+        put(",\"dot\":");
+        put_number(dot);
+        put(",\"lhs\":\"");
+        put_escaped(name(item.get_lhs()));
+        put("\",\"rhs\":[");
+        const Sym* rhs = Grammar::rhs(rule);
+        bool lexical = shows_word(item, word);
+        for (int i = 0; i < (int)Grammar::length(rule); ++i)
+        {
+            put(i > 0 ? ",\"" : "\"");
+            if (lexical) put_escaped(*word);
+            else put_escaped(name(rhs[i]));
+            put("\"");
+        }
+        put(item.complete() ? "],\"complete\":true}\n" : "],\"complete\":false}\n");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// opens the graph of @p chart with a node for every cell border
+    void begin_graph(const CHART& chart)
+    {
+        put("digraph chart");
+        put_number(charts);
+        put(" {\n  rankdir=LR;\n  node [shape=circle];\n");
+        const auto& tokens = chart.get_tokens();
+        for (long i = 0; i < chart.size(); ++i)
+        {
+            put("  c");
+            put_number(i);
+            put(" [label=\"");
+            put_number(i);
+            put("\"];\n");
+            if (i+1 < chart.size() && i < (long)tokens.size())
+            {
+                // the token between two borders, drawn in gray
+                put("  c");
+                put_number(i);
+                put(" -> c");
+                put_number(i+1);
+                put(" [label=\"");
+                put_escaped(tokens[i]);
+                put("\", style=bold, color=gray];\n");
+            }
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// appends @p item in cell @p cell as an edge over the span it covers;
+    /// complete items are drawn solid, others dashed
+    void put_edge(const Item& item, long cell, const helper::StrView* word)
+    {
+        put("  c");
+        put_number(item.from);
+        put(" -> c");
+        put_number(cell);
+        put(" [label=\"");
+        put_escaped(name(item.get_lhs()));
+        put(" ->");
+        int dot;
+        const Sym* rule = shown_rule(item, dot);
+        const Sym* rhs = Grammar::rhs(rule);
+        int length = Grammar::length(rule);
+        bool lexical = shows_word(item, word);
+        for (int i = 0; i <= length; ++i)
+        {
+            if (i == dot) put(" .");
+            if (i == length) break;
+            put(" ");
+            if (lexical) put_escaped(*word);
+            else put_escaped(name(rhs[i]));
+        }
+        put(item.complete() ? "\"];\n" : "\", style=dashed];\n");
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    const Grammar& g;                   ///< grammar of the charts
+    sost& o;                            ///< stream to write to
+    ChartFormat format;                 ///< output format
+    std::size_t capacity;               ///< buffer size that triggers a write
+    sstr buffer;                        ///< rendered, not yet written output
+    std::vector<sstr> names;            ///< cached symbol names by ID
+    std::vector<bool> cached;           ///< whether names[i] has been set
+    sstr unknown = "<$>";               ///< name of invalid IDs
+    std::unordered_set<ES> categories;  ///< categories to show; all if empty
+    std::unordered_set<IS> category_ids;///< IDs of \b categories
+    long first_cell;                    ///< first cell to show
+    long last_cell;                     ///< last cell to show; -1 for all
+    long charts;                        ///< number of charts written
+    int rule_width;                     ///< width of the line after a cell
+////////////////////////////////////////////////////////////////////////////////
+}; // ChartExporter
+
+} // Earley
+
+#endif // __EXPORT__HPP
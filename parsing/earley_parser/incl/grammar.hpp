@@ -38,6 +38,8 @@
 #include <set>
 #include <unordered_set>
 #include <fstream>
+#include <stdexcept>
+#include <algorithm>
 
 #include "helper.hpp"
 #include "rule.hpp"
@@ -74,6 +76,12 @@ namespace std
 namespace Earley
 {
 ////////////////////////////////////////////////////////////////////////////////
+/// thrown when a grammar, tag or words file cannot be read
+struct LoadError : public std::runtime_error
+{
+    explicit LoadError(const sstr& what) : std::runtime_error(what) {}
+};
+////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 //                                     Grammar                                //
 //                                                                            //
@@ -149,12 +157,12 @@ public:                                                    //     PUBLIC METHODS
     /**
      * @brief constructs grammar from input stream of rules
      * @pre   one rule must occupy exactly one line
-     * @param is ifstream with grammar rules
+     * @param is stream with grammar rules
      * @param separator rule sides separating string
      * @param ss super start symbol
      * @param s start symbol
      */
-    Grammar(std::ifstream& is, ES ss="$", ES s="S", ES separator="-->")
+    Grammar(std::istream& is, ES ss="$", ES s="S", ES separator="-->")
     :
     // add ss and s and separator to esism
     del(helper::init("token_delimeter")),
@@ -163,6 +171,26 @@ public:                                                    //     PUBLIC METHODS
     {
         fill(is);
     }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs grammar from input stream of rules with rule token
+     *        delimiter @p del, rather than the one in config.txt. For use
+     *        in programs that do not run from the directory of config.txt
+     * @pre   one rule must occupy exactly one line
+     * @param is stream with grammar rules
+     * @param del rule token delimiter
+     * @param separator rule sides separating string
+     * @param ss super start symbol
+     * @param s start symbol
+     */
+    Grammar(std::istream& is, char del, ES ss="$", ES s="S", ES separator="-->")
+    :
+    del(1, del),
+    separator(separator),
+    start(make_rule(ss+this->del+separator+this->del+s))
+    {
+        fill(is);
+    }
 ////////////////////////////////////////////////////////////////////////////////
     /**
      * @brief injects a lexicon into the \b Grammar
@@ -176,17 +204,15 @@ public:                                                    //     PUBLIC METHODS
     /**
      * @brief makes rule from a representation in std::string
      * @param repr rule representation
+     * @throws LoadError if @p repr is not a valid rule
      */
     Rule make_rule(sstr repr)
     {
         ESVec tokens = helper::tokenise(repr);
-        if (validator(tokens, separator))
-        {
-            // make a pair of rulesides and rhs_begin index
-            std::pair<RulesideVec, int> rp = parse(tokens);
-            return Rule(this, rp.first, rp.second);
-        }else { malform_error(tokens); }
-        exit(1);
+        if (!validator(tokens, separator)) malform_error(tokens);
+        // make a pair of rulesides and rhs_begin index
+        std::pair<RulesideVec, int> rp = parse(tokens);
+        return Rule(this, rp.first, rp.second);
     }
 ////////////////////////////////////////////////////////////////////////////////
     /**
@@ -220,18 +246,17 @@ public:                                                    //     PUBLIC METHODS
     /**
      * @brief fills the grammar from a file of rules
      * @pre   one rule must occupy exactly one line
-     * @param is ifstream with grammar rules
+     * @param is stream with grammar rules; must be seekable
      */
-    void fill(std::ifstream& is)
+    void fill(std::istream& is)
     {
-        LOAD::Progressbar l(get_rulecount(is));
-        int i = 0;
+        LOAD::Progress progress(std::max(get_rulecount(is), 1));
         std::string repr;
         // go over file and make \b Rule objects from string representations
         while(std::getline(is, repr))
         {
-            // update progress bar
-            l.run(i++);
+            // count the line for the progress bar
+            progress.add();
             // skip empty lines
             if (repr.size() == 0) continue;
             // make a rule from string representation and add it to grammar
@@ -377,22 +402,45 @@ public:                                                    //     PUBLIC METHODS
     {
         return lexicon.find(is) != lexicon.end();
     }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns all rules but the start rule, by left hand side
+    const RRMap& get_rules() const
+    {
+        return rules;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of \b IS values assigned so far; IDs are below it
+    std::size_t symbol_count() const
+    {
+        #if !(SOVERLOAD)
+        return translator.size();
+        #else
+        return esism.size()+1;
+        #endif
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if \b IS @p is has been assigned to a symbol
+    bool has_symbol(const IS& is) const
+    {
+        #if !(SOVERLOAD)
+        return is >= 0 && (std::size_t)is < translator.size();
+        #else
+        return isesm.find(is) != isesm.end();
+        #endif
+    }
 ////////////////////////////////////////////////////////////////////////////////
 private:                                                   //    PRIVATE METHODS
 ////////////////////////////////////////////////////////////////////////////////
-    /// takes a token vector and prints an error message containing
-    /// the vector's tokens
+    /// takes a token vector and throws an error containing the vector's
+    /// tokens
     void malform_error(const ESVec& v) const
     {
-        helper::msg("error:","malformed grammar rule '"+
-                     helper::to_string(v)+"'",
-                    __FILE__,__LINE__);
-        exit(1);
+        throw LoadError("malformed grammar rule '"+helper::to_string(v)+"'");
     }
 ////////////////////////////////////////////////////////////////////////////////
     /// estimates number of rule representations in a stream object @p is
     /// (actually only counts lines)
-    int get_rulecount(std::ifstream& is)
+    int get_rulecount(std::istream& is)
     {
         int rulecount = 0;
         std::string dummy;
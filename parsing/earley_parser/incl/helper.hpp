@@ -37,6 +37,7 @@
 #include "declarations.hpp"
 #include "utf8/utf8.h"
 #include "color.hpp"
+#include "tokenizer.hpp"
 
 namespace helper
 {
@@ -69,6 +70,20 @@ sstr to_string(const std::vector<T>& v)
 namespace helper
 {
 ////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief tokenizes string \p s by delimiter \p d and returns the tokens
+ *        as copies; see tokenizer.hpp for tokens that are not copied
+ */
+inline svec_s tokenise(const sstr& s, const char d=' ')
+{
+    svec_s toks;
+    for_each_token(s.data(), s.size(), CharDelim(d), [&toks](const StrView& t)
+    {
+        toks.push_back(t.str());
+    });
+    return toks;
+}
+////////////////////////////////////////////////////////////////////////////////
 /**
  * @brief tokenizes sequence \p seq by delimiter \p d and returns
  *        std::vector& of token vector
@@ -76,28 +91,7 @@ namespace helper
 template<typename T>
 svec_s tokenise(T seq, const char d=' ')
 {
-    sstr tok;  // current token
-    svec_s toks; // vector of tokens to be returned
-
-    // convert seq to string and concat delimiter
-    seq = detail::to_string(seq)+d;
-
-    // iterate over sequence. If delimiter encountered, append token
-    // to toks, else append glyph to tok
-    for(auto i = seq.begin(); i != seq.end(); ++i)
-    {
-        if(*i != d)
-        {
-            tok+=*i;
-        }
-        else if(tok.begin() != tok.end())
-        {
-            toks.push_back(tok);
-            tok.clear();
-        }
-    }
-    toks.shrink_to_fit();
-    return toks;
+    return tokenise(detail::to_string(seq), d);
 }
 ////////////////////////////////////////////////////////////////////////////////
 /// combines hashes by taking one hash as the seed for the hashing of
@@ -109,12 +103,12 @@ size_t hash_combine(size_t seed, const T& v)
     return (seed ^= (hasher(v)<<16) + 0x9e3779b9 + (seed<<6) + (seed>>2));
 }
 ////////////////////////////////////////////////////////////////////////////////
-/// hashes strings
-size_t hash_string(sstr s)
+/// hashes the @p n chars starting at @p p
+inline size_t hash_bytes(const char* p, size_t n)
 {
     size_t hash = 0;
 
-    for(auto c = s.begin(); c != s.end(); ++c)
+    for(const char* c = p; c != p+n; ++c)
     {
         hash += *c;
         hash += (hash << 10);
@@ -128,8 +122,14 @@ size_t hash_string(sstr s)
     return hash;
 }
 ////////////////////////////////////////////////////////////////////////////////
+/// hashes strings
+inline size_t hash_string(const sstr& s)
+{
+    return hash_bytes(s.data(), s.size());
+}
+////////////////////////////////////////////////////////////////////////////////
 /// returns glyph count of utf8 conformant string
-unsigned short utf8_size(sstr s)
+inline unsigned short utf8_size(sstr s)
 {
     return utf8::distance(s.begin(), s.end());
 }
@@ -143,9 +143,9 @@ unsigned short utf8_size(sstr s)
  * @param c color the message body
  * @param o the ostream to send to (default std::cerr)
  */
-void msg(const sstr& lbl, const sstr& msg,
-         sstr f="", int ln=-1,
-         sost& o=std::cerr, CID c=RED)
+inline void msg(const sstr& lbl, const sstr& msg,
+                sstr f="", int ln=-1,
+                sost& o=std::cerr, CID c=RED)
 {
     sstr lstr;
     if (ln > -1)
@@ -211,7 +211,7 @@ sstr to_string(const T& t)
 }
 ////////////////////////////////////////////////////////////////////////////////
 /// returns number of columns of current CLI window (terminal or cmd)
-unsigned get_terminal_columns()
+inline unsigned get_terminal_columns()
 {
     unsigned c = -1;
     #ifdef _WIN32
@@ -228,6 +228,20 @@ unsigned get_terminal_columns()
     return c;
 }
 ////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief @returns true, if stdout is a terminal. Asked once per process, so
+ *        indicators can test it without a system call each time.
+ */
+inline bool stdout_is_terminal()
+{
+    #ifdef _WIN32
+    static const bool terminal = _isatty(_fileno(stdout)) != 0;
+    #else
+    static const bool terminal = isatty(fileno(stdout)) != 0;
+    #endif
+    return terminal;
+}
+////////////////////////////////////////////////////////////////////////////////
 //                                  INCREMENT                                 //
 ////////////////////////////////////////////////////////////////////////////////
 /**
@@ -269,7 +283,7 @@ public:
  * @param sep the character separating key from value in @p cf
  * @param cmt comment tag
  */
-sstr init(sstr s, sstr cf="config.txt", char sep='=', char cmt='#')
+inline sstr init(sstr s, sstr cf="config.txt", char sep='=', char cmt='#')
 {
     std::ifstream conf(cf.c_str());
     if (!conf)
@@ -320,14 +334,10 @@ int get_digits(T number)
 }
 ////////////////////////////////////////////////////////////////////////////////
     /// fills line with @p c
-    void fill_line(char c, sost&o=std::cout, int cls = 60)
+    inline void fill_line(char c, sost&o=std::cout, int cls = 60)
     {
         // if stdout is a file, only fill part of the line
-        #ifdef _WIN32
-        if (_isatty(_fileno(stdout))) cls = get_terminal_columns();
-        #else
-        if (isatty(fileno(stdout))) cls = get_terminal_columns();
-        #endif
+        if (stdout_is_terminal()) cls = get_terminal_columns();
         for (int i = 0; i < cls; ++i) o << c;
         o << '\n';
     }
@@ -0,0 +1,306 @@
+/**
+ * @file io.hpp
+ * Classes for streaming input and output. \b SentenceReader hands out
+ * one blank line separated sentence at a time, so that the memory used
+ * for reading input does not grow with the size of the corpus.
+ * \b CorpusReader does the same for a file mapped into memory, handing out
+ * the tokens as views into the file.
+ * \b BufferedWriter collects output in one large buffer and only passes
+ * it on to the underlying file once the buffer is full or on explicit
+ * request, rather than once per line.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __IO__HPP
+#define __IO__HPP
+
+#include "declarations.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include "helper.hpp"
+#include "mapped.hpp"
+
+namespace IO
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               BufferedWriter                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief stream buffer that collects output in a large buffer and writes
+ *        it to a \b FILE in blocks
+ * @details output is passed on to the file only when the buffer is full,
+ *          on sync() (i.e. an explicit flush of the owning stream) and on
+ *          destruction. Lines are not flushed individually.
+ */
+class BufferedWriter : public std::streambuf
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                     //    PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs a writer for file @p f
+     * @param f file to write to (default stdout)
+     * @param size size of the buffer in bytes (default 1 MiB)
+     */
+    BufferedWriter(std::FILE* f=stdout, std::size_t size=1<<20)
+    :file(f),
+    buffer(size > 0 ? size : 1)
+    {
+        setp(buffer.data(), buffer.data()+buffer.size());
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// writes whatever is left in the buffer
+    ~BufferedWriter()
+    {
+        sync();
+    }
+////////////////////////////////////////////////////////////////////////////////
+protected:                                                  // PROTECTED METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// called when the buffer is full; writes it and stores @p c
+    int_type overflow(int_type c)
+    {
+        if (!drain()) return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// writes large chunks directly, bypassing the buffer
+    std::streamsize xsputn(const char* s, std::streamsize n)
+    {
+        if (n <= epptr()-pptr())
+        {
+            traits_type::copy(pptr(), s, n);
+            pbump(n);
+            return n;
+        }
+        if (!drain()) return 0;
+        if ((std::size_t)n >= buffer.size())
+        {
+            return std::fwrite(s, 1, n, file);
+        }
+        traits_type::copy(pptr(), s, n);
+        pbump(n);
+        return n;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// passes the buffer on to the file
+    int sync()
+    {
+        if (!drain()) return -1;
+        return std::fflush(file) == 0 ? 0 : -1;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                    //   PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// writes the used part of the buffer to \b file and resets the buffer
+    bool drain()
+    {
+        std::ptrdiff_t n = pptr()-pbase();
+        if (n > 0 && std::fwrite(pbase(), 1, n, file) != (std::size_t)n)
+        {
+            return false;
+        }
+        setp(buffer.data(), buffer.data()+buffer.size());
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                    //    PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::FILE* file;          ///< file to write to
+    std::vector<char> buffer; ///< output collected so far
+////////////////////////////////////////////////////////////////////////////////
+}; // BufferedWriter
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                 BufferedOut                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief output stream over a \b BufferedWriter
+ */
+class BufferedOut : public std::ostream
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                     //    PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs a stream writing to @p f through a buffer of
+     *        @p size bytes
+     */
+    BufferedOut(std::FILE* f=stdout, std::size_t size=1<<20)
+    :std::ostream(nullptr),
+    writer(f, size)
+    {
+        rdbuf(&writer);
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                    //    PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    BufferedWriter writer; ///< the buffer all output goes to
+////////////////////////////////////////////////////////////////////////////////
+}; // BufferedOut
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               SentenceReader                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief reads sentences from a stream one at a time
+ * @details tokens are separated by spaces or new lines, sentences by an
+ *          empty line. Every empty line ends a sentence, as does the end
+ *          of the stream. Only the sentence currently read is held in
+ *          memory.
+ */
+class SentenceReader
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// tokens of a sentence
+typedef svec_s                                                         Sentence;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                     //    PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs a reader for stream @p is
+     * @param is stream to read sentences from
+     * @param echo if not null, every line read is sent to this stream
+     */
+    SentenceReader(std::istream& is, sost* echo=nullptr)
+    :is(is),
+    echo(echo),
+    done(false)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief reads the next sentence into @p sentence
+     * @return false if the stream has been exhausted and @p sentence has
+     *         not been filled
+     */
+    bool next(svec_s& sentence)
+    {
+        if (done) return false;
+        sentence.clear();
+        while (std::getline(is, line))
+        {
+            if (echo) *echo << line << '\n';
+            // an empty line ends the sentence
+            if (line.size() == 0) return true;
+            helper::for_each_token(line.data(), line.size(), helper::CharDelim(' '),
+                                   [&sentence](const helper::StrView& t)
+            {
+                sentence.emplace_back(t.data(), t.size());
+            });
+        }
+        // the end of the stream ends the last sentence
+        done = true;
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                    //    PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::istream& is; ///< stream to read from
+    sost* echo;       ///< stream to echo lines to; may be null
+    sstr line;        ///< current line; reused for every line
+    bool done;        ///< true once the end of \b is has been reached
+////////////////////////////////////////////////////////////////////////////////
+}; // SentenceReader
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                CorpusReader                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief reads sentences from a file mapped into memory
+ * @details sentences are split as by \b SentenceReader, but their tokens
+ *          are views into the mapping rather than copies. They stay valid
+ *          as long as the reader exists. The system is told that the file
+ *          is read sequentially, so pages are read ahead and dropped behind
+ *          and memory use does not grow with the size of the corpus.
+ */
+class CorpusReader
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// tokens of a sentence
+typedef std::vector<helper::StrView>                                   Sentence;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                     //    PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs a reader for file @p path
+     * @throws Earley::LoadError if @p path cannot be opened or mapped
+     */
+    explicit CorpusReader(const sstr& path)
+    :file(path),
+    p(file.data()),
+    end(file.data()+file.size()),
+    done(false)
+    {
+        file.advise_sequential();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief reads the next sentence into @p sentence
+     * @return false if the file has been exhausted and @p sentence has not
+     *         been filled
+     */
+    bool next(Sentence& sentence)
+    {
+        if (done) return false;
+        sentence.clear();
+        while (p < end)
+        {
+            const char* e = static_cast<const char*>(std::memchr(p, '\n', end-p));
+            if (!e) e = end;
+            const char* line = p;
+            p = e < end ? e+1 : end;
+            // an empty line ends the sentence
+            if (e == line) return true;
+            helper::for_each_token(line, e-line, helper::CharDelim(' '),
+                                   [&sentence](const helper::StrView& t)
+            {
+                sentence.push_back(t);
+            });
+        }
+        // the end of the file ends the last sentence
+        done = true;
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                    //    PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    Earley::MappedFile file;   ///< the corpus
+    const char* p;             ///< begin of the next line
+    const char* end;           ///< end of the corpus
+    bool done;                 ///< true once the end has been reached
+////////////////////////////////////////////////////////////////////////////////
+}; // CorpusReader
+
+} // IO
+
+#endif // __IO__HPP
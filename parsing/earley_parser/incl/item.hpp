@@ -1,9 +1,10 @@
 /**
  * @file item.hpp
- * Earley item class. Wraps a \b Earley::Rule<GRAMMAR> object. Wrapped
- * \b Rules appear as if they were dotted rules, as \b Item has a dot
- * index field \b dot. \b Rules are assumed to be constructed according
- * to \b Earley::CFGRuleParser<IS, ES>.
+ * Earley item class. Refers to a rule record of a compiled grammar
+ * (\b Earley::CompiledGrammar<IS, ES>) and adds a dot index \b dot, so
+ * records appear as if they were dotted rules. Items are small and are
+ * copied and compared by the address of their rule record. Items of a
+ * factored grammar carry the features they exclude.
  *
  * Matthias Bisping
  *
@@ -20,13 +21,13 @@
 #ifndef __ITEM__HPP
 #define __ITEM__HPP
 
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <ostream>
 
 #include "helper.hpp"
 #include "declarations.hpp"
-#include "rule.hpp"
 
 namespace Earley
 {
@@ -36,22 +37,26 @@ namespace Earley
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 /**
- * @brief Earley item class. Wraps a \b Earley::Rule<GRAMMAR> object.
- *        Wrapped \b Rules appear as if they were dotted rules, as \b
- *        Item has a dot index field \b dot. \b Rules are assumed to be
- *        constructed according to \b Earley::CFGRuleParser<IS, ES>.
- * @tparam RULE the \b Earley::Rule<GRAMMAR> type for this \b Item
+ * @brief Earley item class. Refers to a rule record of a compiled grammar
+ *        and adds a dot index field \b dot, so the record appears as if it
+ *        was a dotted rule. The record must outlive the \b Item.
+ * @tparam GRAMMAR the compiled grammar type of the rule records, e.g.
+ *         \b Earley::CompiledGrammar<IS, ES>
  */
-template <typename RULE>
+template <typename GRAMMAR>
 class EarleyItem
 {
 ////////////////////////////////////////////////////////////////////////////////
 public:                                                      //     PUBLIC TYPES
 ////////////////////////////////////////////////////////////////////////////////
-/// the \b Rule type of this \b Item
-typedef RULE                                                               Rule;
-/// the internal symbol type used in \b Rule
-typedef typename Rule::IS                                                    IS;
+/// the grammar type of the rule records
+typedef GRAMMAR                                                         Grammar;
+/// the internal symbol type used in the rule records
+typedef typename Grammar::IS                                                 IS;
+/// the external symbol type
+typedef typename Grammar::ES                                                 ES;
+/// the symbol type within rule records
+typedef typename Grammar::Sym                                               Sym;
 ////////////////////////////////////////////////////////////////////////////////
 public:                                                      //   PUBLIC METHODS
 ////////////////////////////////////////////////////////////////////////////////
@@ -60,49 +65,60 @@ public:                                                      //   PUBLIC METHODS
      */
     EarleyItem()
     :
+    rule(nullptr),
     dot(0),
     from(0),
-    to(0)
+    to(0),
+    features(0)
     {
     }
 ////////////////////////////////////////////////////////////////////////////////
     /**
-     * @brief constructs \b Item from a \b Rule \p rule
-     * @param rule the \b Rule from which to construct the \b Item
+     * @brief constructs \b Item from rule record \p rule
+     * @param rule the record from which to construct the \b Item
      * @param dot the dot position of the \b Item
      * @param from the left border of the span the \b  Item covers
      * @param to the right border of the span the \b  Item covers
+     * @param features the features the \b Item excludes, see
+     *        \b CompiledGrammar::agree()
      */
-    EarleyItem(const Rule& rule, short dot=0, short from=0, short to=0)
+    EarleyItem(const Sym* rule, short dot=0, short from=0, short to=0,
+               std::uint16_t features=0)
     :
+    rule(rule),
     dot(dot),
     from(from),
     to(to),
-    rule(rule)
+    features(features)
     {
     }
 ////////////////////////////////////////////////////////////////////////////////
     /**
-     * @brief sends representation of \b Item @p item to stream @p o
+     * @brief sends representation of the \b Item to stream @p o
      * @param o stream to send to
-     * @param item \b Item to send representation of to @p o
+     * @param g grammar to translate the symbols with
+     * @param word if not null, shown instead of the right hand side of
+     *        lexical rules, which repeats their tag
      */
-    friend sost& operator<<(sost& o, const EarleyItem& item)
+    void show(sost& o, const Grammar& g, const ES* word=nullptr) const
     {
         // translate and send left hand side
-        o << item.rule.translate_to_es(*(item.rule.get_lhs()->begin())) << " ";
+        o << g.translate(get_lhs()) << " ";
         // send separator symbol
         #ifdef UNIXLIKE
         o << "\t⟶\t";
         #else
         o << "\t-->\t";
         #endif
+        const Sym* rhs = Grammar::rhs(rule);
+        auto symbol = [&](int i) -> ES
+        {
+            return word && g.is_lexical(rule) ? *word : g.translate(rhs[i]);
+        };
         // translate and send right hand side up to the dot
-        auto j = (item.rule.get_rhs())->begin();
-        for (int i = 0; i < item.dot; ++i)
+        for (int i = 0; i < dot; ++i)
         {
-            o << item.rule.translate_to_es(*j) << " ";
-            ++j;
+            o << symbol(i) << " ";
         }
         // send the dot
         #ifdef UNIXLIKE
@@ -111,18 +127,16 @@ public:                                                      //   PUBLIC METHODS
         o << ".";
         #endif
         // translate and send right hand side from the dot on
-        for (j = (item.rule.get_rhs())->begin()+item.dot;
-             j != (item.rule.get_rhs())->end();
-             ++j)
+        for (int i = dot; i < (int)Grammar::length(rule); ++i)
         {
-            o << " " << item.rule.translate_to_es(*j);
+            o << " " << symbol(i);
         }
-        return o;
     }
 ////////////////////////////////////////////////////////////////////////////////
     /**
      * @brief compares 2 \b Items. \b Items are identical if their rule,
-     *        dot index and their left and right span border are identical
+     *        dot index, their left and right span border and their
+     *        features are identical
      * @param i \b Item to compare to \b *this
      */
     bool operator==(const EarleyItem& i) const
@@ -130,13 +144,14 @@ public:                                                      //   PUBLIC METHODS
         return (i.rule == rule &&
                 i.dot  == dot  &&
                 i.from == from &&
-                i.to   == to);
+                i.to   == to   &&
+                i.features == features);
     }
 ////////////////////////////////////////////////////////////////////////////////
     /// @returns true, if \b Item is complete
     bool complete() const
     {
-        return dot >= (int)rule.get_rhs()->size();
+        return dot >= (int)Grammar::length(rule);
     }
 ////////////////////////////////////////////////////////////////////////////////
     /**
@@ -144,55 +159,23 @@ public:                                                      //   PUBLIC METHODS
      */
     IS next() const
     {
-        return *(rule.get_rhs()->begin()+dot);
-    }
-////////////////////////////////////////////////////////////////////////////////
-    /**
-     * @brief accesses \b rule's right hand side at position @p index.
-     *        Indexing is defined only for \b Rules' RHSs
-     * @pre   assumes \b rule to be organized according to the preset
-     *        rule parser \b Earley::CFGRuleParser<IS, ES>
-     */
-    const IS& operator[](short index) const
-    {
-        if (index >= rule.get_rhs().size())
-        {
-            helper::msg("error:",
-                        "index ["+helper::to_string(index)+"] exceeds array",
-                        __FILE__, __LINE__);
-            exit(1);
-        }
-        rule.get_rhs()[index];
+        return Grammar::rhs(rule)[dot];
     }
 ////////////////////////////////////////////////////////////////////////////////
-    EarleyItem& operator=(const EarleyItem& src)
-    {
-        if (this != &src)
-        {
-            rule = src.rule;
-            dot  = src.dot;
-            from = src.from;
-            to   = src.to;
-        }
-        return *this;
-    }
-////////////////////////////////////////////////////////////////////////////////
-    /**
-     * @brief accesses \p rule's LHS
-     * @pre   assumes \p rule to be organized according to the preset
-     *        rule parser \p Earley::CFGRuleParser
-     */
-    const IS& get_lhs() const
+    /// @returns \p rule's LHS
+    IS get_lhs() const
     {
-        return *((rule.get_lhs())->begin());
+        return Grammar::lhs(rule);
     }
 ////////////////////////////////////////////////////////////////////////////////
 public:                                                      //    PUBLIC FIELDS
 ////////////////////////////////////////////////////////////////////////////////
-    short dot;  ///< index of dot
-    short from; ///< stores left span border
-    short to;   ///< stores right span border
-    Rule rule;  ///< \b Rule instance; main content of \b Item
+    const Sym* rule; ///< rule record; main content of \b Item
+    short dot;       ///< index of dot
+    short from;      ///< stores left span border
+    short to;        ///< stores right span border
+    /// features excluded, for factored grammars; fills the padding
+    std::uint16_t features;
 ////////////////////////////////////////////////////////////////////////////////
 }; // EarleyItem
 
@@ -201,13 +184,13 @@ public:                                                      //    PUBLIC FIELDS
 namespace std
 {
 using namespace helper;
-/// hash template definition for objects of type \b Earley::EarleyItem<RULE>
-template<typename RULE>
-struct hash<Earley::EarleyItem<RULE>>
+/// hash template definition for objects of type \b Earley::EarleyItem<GRAMMAR>
+template<typename GRAMMAR>
+struct hash<Earley::EarleyItem<GRAMMAR>>
 {
-    size_t operator()(const Earley::EarleyItem<RULE>& i) const
+    size_t operator()(const Earley::EarleyItem<GRAMMAR>& i) const
     {
-        return hash_combine(i.from+i.to, hash_combine(i.dot, i.rule));
+        return hash_combine(i.from+i.to, hash_combine((std::size_t(i.features) << 16)+i.dot, i.rule));
     }
 };
 
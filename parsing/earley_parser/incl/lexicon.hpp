@@ -0,0 +1,789 @@
+/**
+ * @file lexicon.hpp
+ * Lexicon class. Holds the set of POS-tags and maps every word to its
+ * ambiguity class, i.e. the set of tags the word can have. Words with the
+ * same set of tags share one ambiguity class, so each set of tags is
+ * stored only once. Words are found through a double-array trie that can
+ * be queried with a pointer and a length, so looking up a token takes one
+ * step per byte and does not require it to be copied into a string.
+ * The words, their classes and the trie are kept in flat arrays. A words
+ * file can be compiled into a lexicon image holding these arrays, which
+ * is then mapped into memory instead of being read line by line:
+ *
+ *     tag_names    tag names of the words file, sorted and concatenated
+ *     tag_offsets  offset of every tag name, plus 1 for the end
+ *     class_tags   tags of every class, as indices of tag names
+ *     class_offsets begin of every class in class_tags, plus 1 for the end
+ *     word_chars   words, sorted and concatenated
+ *     word_offsets offset of every word, plus 1 for the end
+ *     word_class   ambiguity class of every word
+ *     base, check  the trie; see \b WordTrie
+ *
+ * Tags are stored by name, so an image does not depend on the grammar.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __LEXICON__HPP
+#define __LEXICON__HPP
+
+#include "declarations.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "helper.hpp"
+#include "grammar.hpp"
+#include "loader.hpp"
+#include "mapped.hpp"
+#include "trie.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+/// header of a lexicon image
+struct LexiconHeader
+{
+    char magic[8];               ///< "EARLEYL" and the byte order mark
+    std::uint32_t version;       ///< format version, see \b current()
+    std::uint32_t header_size;   ///< sizeof(LexiconHeader)
+    std::uint64_t size;          ///< size of the whole image in bytes
+    std::uint64_t checksum;      ///< FNV-1a of all bytes after the header
+    std::uint32_t word_count;    ///< number of words
+    std::uint32_t class_count;   ///< number of ambiguity classes
+    std::uint32_t tag_count;     ///< number of tag names
+    std::uint32_t slot_count;    ///< number of slots of the trie
+    std::uint64_t tag_names;     ///< byte offsets of the sections
+    std::uint64_t tag_offsets;
+    std::uint64_t class_tags;
+    std::uint64_t class_offsets;
+    std::uint64_t word_chars;
+    std::uint64_t word_offsets;
+    std::uint64_t word_class;
+    std::uint64_t base;
+    std::uint64_t check;
+
+    /// @returns version of the image format written by this code
+    static std::uint32_t current() { return 1; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                   Lexicon                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief set of POS-tags and mapping from words to ambiguity classes
+ * @details words are added with add() and become visible to lookups once
+ *          finish() has been called, or are mapped from a lexicon image.
+ *          Words are numbered in sorted order and ambiguity classes in the
+ *          order of the words, so the numbering does not depend on hashing.
+ * @tparam INTERNSYM internal symbol type, the type of the tags
+ * @tparam EXTERNSYM external symbol type, the type of the words
+ * @pre    @p EXTERNSYM needs to provide data() and size() over chars
+ */
+template <typename INTERNSYM, typename EXTERNSYM>
+class Lexicon
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef INTERNSYM                                                            IS;
+typedef EXTERNSYM                                                            ES;
+typedef std::vector<IS>                                                   ISVec;
+typedef std::set<IS>                                                      ISSet;
+/// maps tags to the words they are assigned to
+typedef std::map<IS, std::unordered_set<ES>>                    TagID_Words_Map;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// constructs empty lexicon
+    Lexicon()
+    :nwords(0)
+    {
+        attach_words();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs lexicon from a set of tags @p tags and a map from
+     *        tags to words @p pwm
+     */
+    Lexicon(const ISSet& tags, const TagID_Words_Map& pwm)
+    :tags(tags),
+    nwords(0)
+    {
+        attach_words();
+        for (auto t = pwm.begin(); t != pwm.end(); ++t)
+        {
+            for (auto w = t->second.begin(); w != t->second.end(); ++w)
+            {
+                add(*w, t->first);
+            }
+        }
+        finish();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns index of unknown words and of words without class
+    static unsigned none()
+    {
+        return static_cast<unsigned>(-1);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief reads tags from stream @p is, one tag per line, and translates
+     *        them with grammar @p g
+     * @throws LoadError if a line holds more than one token
+     */
+    template <typename GRAMMAR>
+    void load_tags(std::istream& is, GRAMMAR& g)
+    {
+        sstr line;
+        while(std::getline(is, line))
+        {
+            if (line.size() == 0) continue;
+            if (helper::count_tokens(line, helper::CharDelim(' ')) != 1)
+            {
+                throw LoadError("'"+line+"' in tags file. Invalid format");
+            }
+            add_tag(g.translate(line));
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief reads words from stream @p is and calls finish(). Every line
+     *        holds a word, which may consist of several tokens, followed
+     *        by exactly one tag. Tags are translated with grammar @p g.
+     *        If SOVERLOAD is enabled, the words are translated as well and
+     *        injected into @p g.
+     * @throws LoadError if a line holds fewer than 2 tokens
+     */
+    template <typename GRAMMAR>
+    void load_words(std::istream& is, GRAMMAR& g)
+    {
+        #if SOVERLOAD
+        ISSet lexicon;
+        #endif
+
+        sstr line;
+        while(std::getline(is, line))
+        {
+            sstr nl_string, tag;
+            if (!read_entry(line, nl_string, tag)) continue;
+            // translate the tag into an ID of type IS
+            add(nl_string, g.translate(tag));
+
+            #if SOVERLOAD
+            lexicon.insert(g.translate(nl_string));
+            #endif
+        }
+
+        #if SOVERLOAD
+        g.inject_lexicon(lexicon);
+        #endif
+
+        finish();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief loads words from @p path, which is either a lexicon image or
+     *        a words file; see load_words(std::istream&, GRAMMAR&). An
+     *        image replaces all words added before. A words file is read
+     *        on @p threads threads, see \b ParallelLoader; tags and words
+     *        are translated in the same order as by reading it line by line.
+     * @param threads number of threads; 0 selects the number of cores
+     * @throws LoadError if @p path cannot be read or is malformed
+     */
+    template <typename GRAMMAR>
+    void load_words(const sstr& path, GRAMMAR& g, unsigned threads=0)
+    {
+        if (is_image(path))
+        {
+            map_words(path, g);
+            return;
+        }
+
+        // entries of a chunk, with their tags (and words) numbered locally
+        struct Part
+        {
+            LocalSymbols<ES> symbols;
+            std::vector<std::pair<ES, std::uint32_t>> entries;
+            #if SOVERLOAD
+            std::vector<std::uint32_t> words;
+            #endif
+        };
+        std::vector<Part> parts = ParallelLoader::map_lines<Part>(path, threads,
+            [](Part& part, const sstr& line)
+        {
+            sstr nl_string, tag;
+            if (!read_entry(line, nl_string, tag)) return;
+            part.entries.push_back(std::make_pair(nl_string, part.symbols.intern(tag)));
+            #if SOVERLOAD
+            part.words.push_back(part.symbols.intern(nl_string));
+            #endif
+        });
+
+        #if SOVERLOAD
+        ISSet lexicon;
+        #endif
+
+        for (auto part = parts.begin(); part != parts.end(); ++part)
+        {
+            std::vector<IS> ids;
+            for (auto n = part->symbols.names.begin(); n != part->symbols.names.end(); ++n)
+            {
+                ids.push_back(g.translate(*n));
+            }
+            for (auto e = part->entries.begin(); e != part->entries.end(); ++e)
+            {
+                add(e->first, ids[e->second]);
+            }
+            #if SOVERLOAD
+            for (auto w = part->words.begin(); w != part->words.end(); ++w)
+            {
+                lexicon.insert(ids[*w]);
+            }
+            #endif
+        }
+
+        #if SOVERLOAD
+        g.inject_lexicon(lexicon);
+        #endif
+
+        finish();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if file @p path starts like a lexicon image
+    static bool is_image(const sstr& path)
+    {
+        return MappedFile::has_magic(path, "EARLEYL");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief compiles the words file @p is into a lexicon image at @p path
+     * @return number of words
+     * @throws LoadError if a line of @p is is malformed
+     * @throws std::runtime_error if @p path cannot be written
+     */
+    static std::size_t compile(std::istream& is, const sstr& path)
+    {
+        std::map<ES, std::set<ES>> entries;
+        sstr line, word, tag;
+        while (std::getline(is, line))
+        {
+            if (read_entry(line, word, tag)) entries[word].insert(tag);
+        }
+
+        // tag names and their indices
+        std::map<ES, std::uint32_t> tag_ids;
+        for (auto e = entries.begin(); e != entries.end(); ++e)
+        {
+            for (auto t = e->second.begin(); t != e->second.end(); ++t)
+            {
+                tag_ids.insert(std::make_pair(*t, 0));
+            }
+        }
+        sstr tag_names;
+        std::vector<std::uint32_t> tag_offsets;
+        for (auto t = tag_ids.begin(); t != tag_ids.end(); ++t)
+        {
+            t->second = tag_offsets.size();
+            tag_offsets.push_back(tag_names.size());
+            tag_names += t->first;
+        }
+        tag_offsets.push_back(tag_names.size());
+
+        // words, their classes and the classes' tags
+        std::map<std::vector<std::uint32_t>, std::uint32_t> class_ids;
+        std::vector<std::uint32_t> class_tags, class_offsets, word_offsets, word_class;
+        sstr word_chars;
+        std::vector<WordTrie::Entry> trie_entries;
+        for (auto e = entries.begin(); e != entries.end(); ++e)
+        {
+            std::vector<std::uint32_t> tagv;
+            for (auto t = e->second.begin(); t != e->second.end(); ++t)
+            {
+                tagv.push_back(tag_ids[*t]);
+            }
+            auto c = class_ids.find(tagv);
+            if (c == class_ids.end())
+            {
+                c = class_ids.insert(std::make_pair(tagv, class_offsets.size())).first;
+                class_offsets.push_back(class_tags.size());
+                class_tags.insert(class_tags.end(), tagv.begin(), tagv.end());
+            }
+            trie_entries.push_back(WordTrie::Entry(&e->first, word_offsets.size()));
+            word_offsets.push_back(word_chars.size());
+            word_chars += e->first;
+            word_class.push_back(c->second);
+        }
+        class_offsets.push_back(class_tags.size());
+        word_offsets.push_back(word_chars.size());
+        WordTrie::SlotVec base, check;
+        WordTrie::build(trie_entries, base, check);
+
+        // lay out the sections, each aligned to 8 bytes
+        LexiconHeader h;
+        std::memset(&h, 0, sizeof h);
+        MappedFile::magic(h.magic, "EARLEYL");
+        h.version = LexiconHeader::current();
+        h.header_size = sizeof h;
+        h.word_count = word_class.size();
+        h.class_count = class_offsets.size()-1;
+        h.tag_count = tag_offsets.size()-1;
+        h.slot_count = base.size();
+        std::uint64_t at = sizeof h;
+        std::vector<std::pair<const void*, std::size_t>> sections;
+        auto place = [&](std::uint64_t& field, const void* p, std::size_t bytes)
+        {
+            field = at;
+            sections.push_back(std::make_pair(p, bytes));
+            at += (bytes+7) & ~std::size_t(7);
+        };
+        place(h.tag_names, tag_names.data(), tag_names.size());
+        place(h.tag_offsets, tag_offsets.data(), tag_offsets.size()*4);
+        place(h.class_tags, class_tags.data(), class_tags.size()*4);
+        place(h.class_offsets, class_offsets.data(), class_offsets.size()*4);
+        place(h.word_chars, word_chars.data(), word_chars.size());
+        place(h.word_offsets, word_offsets.data(), word_offsets.size()*4);
+        place(h.word_class, word_class.data(), word_class.size()*4);
+        place(h.base, base.data(), base.size()*4);
+        place(h.check, check.data(), check.size()*4);
+        h.size = at;
+
+        std::vector<char> image(at, 0);
+        std::uint64_t* offsets[] = {&h.tag_names, &h.tag_offsets, &h.class_tags,
+                                    &h.class_offsets, &h.word_chars, &h.word_offsets,
+                                    &h.word_class, &h.base, &h.check};
+        for (std::size_t i = 0; i < sections.size(); ++i)
+        {
+            if (sections[i].second == 0) continue;
+            std::memcpy(&image[*offsets[i]], sections[i].first, sections[i].second);
+        }
+        h.checksum = MappedFile::checksum(image.data()+sizeof h, at-sizeof h);
+        std::memcpy(image.data(), &h, sizeof h);
+
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f.write(image.data(), image.size());
+        if (!f) throw std::runtime_error("failed to write '"+path+"'");
+        return h.word_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// adds @p tag to the set of tags
+    void add_tag(IS tag)
+    {
+        tags.insert(tag);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// assigns @p tag to @p word; takes effect with the next call to finish()
+    void add(const ES& word, IS tag)
+    {
+        pending[word].push_back(tag);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief merges all words added since the last call into the lexicon
+     *        and rebuilds the lookup table
+     */
+    void finish()
+    {
+        std::map<ISVec, unsigned> class_ids;
+        for (unsigned c = 0; c < classes.size(); ++c) class_ids[classes[c]] = c;
+
+        std::vector<ES> words;
+        std::vector<std::uint32_t> word_class(wclass, wclass+nwords);
+        for (unsigned w = 0; w < nwords; ++w) words.push_back(get_word(w));
+
+        for (auto p = pending.begin(); p != pending.end(); ++p)
+        {
+            ISVec tagv = p->second;
+            unsigned w = find(p->first);
+            if (w != none())
+            {
+                const ISVec& old = classes[word_class[w]];
+                tagv.insert(tagv.end(), old.begin(), old.end());
+            }
+            std::sort(tagv.begin(), tagv.end());
+            tagv.erase(std::unique(tagv.begin(), tagv.end()), tagv.end());
+
+            auto c = class_ids.find(tagv);
+            if (c == class_ids.end())
+            {
+                c = class_ids.insert(std::make_pair(tagv, classes.size())).first;
+                classes.push_back(tagv);
+            }
+            if (w == none())
+            {
+                words.push_back(p->first);
+                word_class.push_back(c->second);
+                // every word is pending once only, so \b trie need not
+                // know about it before rebuild()
+            }
+            else
+            {
+                word_class[w] = c->second;
+            }
+        }
+        pending.clear();
+        rebuild(words, word_class);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if @p is is a tag
+    bool is_tag(const IS& is) const
+    {
+        return tags.find(is) != tags.end();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns set of all tags
+    const ISSet& get_tags() const
+    {
+        return tags;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief looks up the word of @p n chars starting at @p p
+     * @return index of the word or none() if the word is unknown
+     */
+    unsigned find(const char* p, std::size_t n) const
+    {
+        return trie.find(p, n);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// looks up @p word; @returns its index or none()
+    unsigned find(const ES& word) const
+    {
+        return find(word.data(), word.size());
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the word with index @p w
+    ES get_word(unsigned w) const
+    {
+        return ES(chars+offsets[w], chars+offsets[w+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns view of the word with index @p w; valid as long as the
+    /// lexicon is not changed
+    helper::StrView view_word(unsigned w) const
+    {
+        return helper::StrView(chars+offsets[w], offsets[w+1]-offsets[w]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief checksum of the words and their ambiguity classes, the same
+     *        for a words file and its lexicon image. Data that refers to
+     *        words or classes by index, such as a binary corpus, is valid
+     *        for every lexicon with the same fingerprint.
+     */
+    std::uint64_t fingerprint() const
+    {
+        std::uint64_t h = MappedFile::checksum(reinterpret_cast<const char*>(&nwords),
+                                               sizeof nwords);
+        h = MappedFile::checksum(chars, offsets[nwords], h);
+        h = MappedFile::checksum(reinterpret_cast<const char*>(offsets),
+                                 (nwords+1)*sizeof *offsets, h);
+        return MappedFile::checksum(reinterpret_cast<const char*>(wclass),
+                                    nwords*sizeof *wclass, h);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the ambiguity class of word @p w
+    unsigned get_class(unsigned w) const
+    {
+        return wclass[w];
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the sorted tags of ambiguity class @p c
+    const ISVec& get_class_tags(unsigned c) const
+    {
+        return classes[c];
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if word @p w can have tag @p tag
+    bool has_tag(unsigned w, const IS& tag) const
+    {
+        const ISVec& c = classes[wclass[w]];
+        return std::binary_search(c.begin(), c.end(), tag);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of words
+    std::size_t word_count() const
+    {
+        return nwords;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of ambiguity classes
+    std::size_t class_count() const
+    {
+        return classes.size();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief words of ambiguity class @p c
+     * @details the words are listed by class once, on first use of
+     *          class_words() or tag_classes()
+     * @return range of word indices
+     */
+    std::pair<const std::uint32_t*, const std::uint32_t*> class_words(unsigned c) const
+    {
+        std::shared_ptr<const TagIndex> index = tag_index();
+        const std::uint32_t* w = index->words.data();
+        return std::make_pair(w+index->class_offsets[c], w+index->class_offsets[c+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the ambiguity classes containing tag @p tag; see class_words()
+    std::vector<std::uint32_t> tag_classes(const IS& tag) const
+    {
+        std::shared_ptr<const TagIndex> index = tag_index();
+        auto c = index->classes.find(tag);
+        if (c == index->classes.end()) return std::vector<std::uint32_t>();
+        return c->second;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the words are mapped from a lexicon image
+    bool is_mapped() const
+    {
+        return file && file->is_mapped();
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+    /// words by class and classes by tag
+    struct TagIndex
+    {
+        /// classes containing every tag
+        std::unordered_map<IS, std::vector<std::uint32_t>> classes;
+        /// index of the first word of every class in \b words
+        std::vector<std::uint32_t> class_offsets;
+        /// words ordered by class
+        std::vector<std::uint32_t> words;
+    };
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    Lexicon(const Lexicon&);
+    Lexicon& operator=(const Lexicon&);
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief splits @p line of a words file into the word @p word, which
+     *        may consist of several tokens, and the tag @p tag
+     * @return false for empty lines
+     * @throws LoadError if @p line holds fewer than 2 tokens
+     */
+    static bool read_entry(const sstr& line, sstr& word, sstr& tag)
+    {
+        if (line.size() == 0) return false;
+        // every token is appended to the word once the next one is seen,
+        // so the last one is left over as the tag
+        helper::StrView last;
+        std::size_t count = 0;
+        word.clear();
+        helper::for_each_token(line.data(), line.size(), helper::CharDelim(' '),
+                               [&](const helper::StrView& t)
+        {
+            if (count++ > 0)
+            {
+                if (count > 2) word += ' ';
+                word.append(last.data(), last.size());
+            }
+            last = t;
+        });
+        if (count < 2)
+        {
+            throw LoadError("'"+line+"' in words file. Invalid format");
+        }
+        tag.assign(last.data(), last.size());
+        return true;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief rebuilds the word arrays and the trie from @p words and their
+     *        classes @p word_class; words are renumbered in sorted order
+     */
+    void rebuild(const std::vector<ES>& words, const std::vector<std::uint32_t>& word_class)
+    {
+        std::vector<unsigned> order(words.size());
+        for (unsigned w = 0; w < order.size(); ++w) order[w] = w;
+        std::sort(order.begin(), order.end(),
+                  [&words](unsigned a, unsigned b){ return words[a] < words[b]; });
+
+        own_chars.clear();
+        own_offsets.clear();
+        own_class.clear();
+        std::vector<WordTrie::Entry> entries;
+        for (auto w = order.begin(); w != order.end(); ++w)
+        {
+            entries.push_back(WordTrie::Entry(&words[*w], own_offsets.size()));
+            own_offsets.push_back(own_chars.size());
+            own_chars += words[*w];
+            own_class.push_back(word_class[*w]);
+        }
+        own_offsets.push_back(own_chars.size());
+        WordTrie::build(entries, own_base, own_check);
+        file.reset();
+        nwords = words.size();
+        attach_words();
+        index_cache.reset();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the words by class and the classes by tag, made on first use
+    std::shared_ptr<const TagIndex> tag_index() const
+    {
+        // threads that get here at once may both build it; one index wins
+        std::shared_ptr<const TagIndex> index = std::atomic_load(&index_cache);
+        if (index) return index;
+        std::shared_ptr<TagIndex> made = std::make_shared<TagIndex>();
+        made->class_offsets.assign(classes.size()+1, 0);
+        for (unsigned w = 0; w < nwords; ++w) ++made->class_offsets[wclass[w]+1];
+        for (std::size_t c = 0; c < classes.size(); ++c)
+        {
+            made->class_offsets[c+1] += made->class_offsets[c];
+            for (auto t = classes[c].begin(); t != classes[c].end(); ++t)
+            {
+                made->classes[*t].push_back(c);
+            }
+        }
+        made->words.resize(nwords);
+        std::vector<std::uint32_t> next(made->class_offsets.begin(), made->class_offsets.end()-1);
+        for (unsigned w = 0; w < nwords; ++w) made->words[next[wclass[w]]++] = w;
+        index = made;
+        std::atomic_store(&index_cache, index);
+        return index;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// points the word arrays and the trie at the vectors
+    void attach_words()
+    {
+        if (own_offsets.empty()) own_offsets.push_back(0);
+        chars = own_chars.data();
+        offsets = own_offsets.data();
+        wclass = own_class.data();
+        trie = WordTrie(own_base.data(), own_check.data(), own_base.size());
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief maps lexicon image @p path and translates its tags with
+     *        grammar @p g. If SOVERLOAD is enabled, the words are translated
+     *        as well and injected into @p g.
+     * @throws LoadError if @p path is no valid image
+     */
+    template <typename GRAMMAR>
+    void map_words(const sstr& path, GRAMMAR& g)
+    {
+        std::unique_ptr<MappedFile> f(new MappedFile(path));
+        const char* data = f->data();
+        const LexiconHeader* h = reinterpret_cast<const LexiconHeader*>(data);
+        char m[8];
+        MappedFile::magic(m, "EARLEYL");
+        if (f->size() < sizeof *h || std::memcmp(h->magic, "EARLEYL", 7) != 0)
+        {
+            throw LoadError("'"+path+"' is no lexicon image");
+        }
+        if (std::memcmp(h->magic, m, 8) != 0)
+        {
+            throw LoadError("'"+path+"' has been compiled on a machine of "
+                            "different byte order");
+        }
+        if (h->version != LexiconHeader::current() || h->header_size != sizeof *h)
+        {
+            throw LoadError("'"+path+"' has image version "+
+                            helper::to_string(h->version)+", expected "+
+                            helper::to_string(LexiconHeader::current())+
+                            "; compile the words again");
+        }
+        if (h->size > f->size() || h->check + 4*(std::uint64_t)h->slot_count > h->size)
+        {
+            throw LoadError("'"+path+"' is truncated");
+        }
+        if (MappedFile::checksum(data+sizeof *h, h->size-sizeof *h) != h->checksum)
+        {
+            throw LoadError("'"+path+"' is corrupt: checksum mismatch");
+        }
+
+        // the classes are small; they are translated into tag IDs
+        const char* tag_names = data + h->tag_names;
+        auto section = [data](std::uint64_t at)
+        {
+            return reinterpret_cast<const std::uint32_t*>(data + at);
+        };
+        const std::uint32_t* tag_offsets = section(h->tag_offsets);
+        const std::uint32_t* class_tags = section(h->class_tags);
+        const std::uint32_t* class_offsets = section(h->class_offsets);
+        ISVec tag_ids;
+        for (std::uint32_t t = 0; t < h->tag_count; ++t)
+        {
+            tag_ids.push_back(g.translate(ES(tag_names+tag_offsets[t],
+                                             tag_names+tag_offsets[t+1])));
+        }
+        classes.clear();
+        for (std::uint32_t c = 0; c < h->class_count; ++c)
+        {
+            ISVec tagv;
+            for (std::uint32_t i = class_offsets[c]; i < class_offsets[c+1]; ++i)
+            {
+                tagv.push_back(tag_ids[class_tags[i]]);
+            }
+            std::sort(tagv.begin(), tagv.end());
+            tagv.erase(std::unique(tagv.begin(), tagv.end()), tagv.end());
+            classes.push_back(tagv);
+        }
+
+        chars = data + h->word_chars;
+        offsets = section(h->word_offsets);
+        wclass = section(h->word_class);
+        trie = WordTrie(reinterpret_cast<const WordTrie::Slot*>(data + h->base),
+                        reinterpret_cast<const WordTrie::Slot*>(data + h->check),
+                        h->slot_count);
+        nwords = h->word_count;
+        index_cache.reset();
+        file = std::move(f);
+        pending.clear();
+        sstr().swap(own_chars);
+        std::vector<std::uint32_t>().swap(own_offsets);
+        std::vector<std::uint32_t>().swap(own_class);
+        WordTrie::SlotVec().swap(own_base);
+        WordTrie::SlotVec().swap(own_check);
+
+        #if SOVERLOAD
+        ISSet lexicon;
+        for (unsigned w = 0; w < nwords; ++w) lexicon.insert(g.translate(get_word(w)));
+        g.inject_lexicon(lexicon);
+        #endif
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    ISSet tags;                          ///< all POS-tags
+    std::vector<ISVec> classes;          ///< sorted tags of each class
+    std::map<ES, ISVec> pending;         ///< words added since finish()
+    std::unique_ptr<MappedFile> file;    ///< lexicon image, if mapped
+    // words and the trie; point into \b file or at the vectors below
+    const char* chars;                   ///< words, concatenated
+    const std::uint32_t* offsets;        ///< offset of each word in chars
+    const std::uint32_t* wclass;         ///< ambiguity class of each word
+    WordTrie trie;                       ///< indices of the words
+    std::uint32_t nwords;                ///< number of words
+    sstr own_chars;                      ///< storage, if not mapped
+    std::vector<std::uint32_t> own_offsets;
+    std::vector<std::uint32_t> own_class;
+    WordTrie::SlotVec own_base;
+    WordTrie::SlotVec own_check;
+    /// see tag_index(); reset whenever the words change
+    mutable std::shared_ptr<const TagIndex> index_cache;
+////////////////////////////////////////////////////////////////////////////////
+}; // Lexicon
+
+} // Earley
+
+#endif // __LEXICON__HPP
@@ -15,10 +15,12 @@
 
 #include "declarations.hpp"
 #include "helper.hpp"
+#include "render.hpp"
 #ifdef UNIXLIKE
 #include <unistd.h>
 #endif
 #include <algorithm>
+#include <memory>
 #include <math.h>
 
 namespace LOAD
@@ -82,38 +84,10 @@ public:                                                    //     PUBLIC METHODS
     inline void run(step current, sost& o=std::cerr)
     {
         // do not display anything, if stdout is redirected to a file
-        #ifdef _WIN32
-        if (!_isatty(_fileno(stdout))) return;
-        #else
-        if (!isatty(fileno(stdout))) return;
-        #endif
+        if (!helper::stdout_is_terminal()) return;
         if(current%interval == 0 && !(current > max))
         {
-            // do away with the cursor
-            #ifdef UNIXLIKE
-            o << "\e[?25l";
-            #endif
-
-            // fill line with background symbol
-            for (int i = 0; i < PSD+lbracketSize; ++i) o << " ";
-            for (unsigned i = 0; i < pres; ++i) o << pre;
-            o << rbracket << "\r";
-            o.flush();
-
-            // calculate percentage and make a string of it
-            float prct = ((float)current/max)*100;
-            sstr strprct = helper::to_string((int)prct);
-            // get percantge to length of three
-            if (helper::utf8_size(strprct) < 2) strprct = " "+strprct;
-            if (helper::utf8_size(strprct) < 3) strprct = " "+strprct;
-
-            // print percentage and bar
-            o << "[" << strprct << "% ] " << lbracket;
-            for (auto i = pbar.begin(); i != pbar.end(); ++i) o << *i;
-
-            o << "\r";
-            o.flush();
-
+            draw(current, o);
             pbar.push_back(bar);
         }
         if(current>=max-1)
@@ -121,6 +95,30 @@ public:                                                    //     PUBLIC METHODS
             cancel();
         }
     }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief shows the progress bar for iteration @p current, no matter
+     *        how many iterations have passed since the last call. Used by
+     *        a render thread that samples the progress at a fixed rate.
+     * @param current the current iteration
+     * @param o the stream to write to
+     */
+    void show(step current, sost& o=std::cerr)
+    {
+        if (!helper::stdout_is_terminal()) return;
+        current = std::min(current, max);
+        while (pbar.size() < current/interval) pbar.push_back(bar);
+        draw(current, o);
+    }
+////////////////////////////////////////////////////////////////////////////////
+/// blanks the current line and brings back the cursor
+void cancel(sost& o=std::cerr) const
+    {
+        blank_line(o);
+        #ifdef UNIXLIKE
+        o << "\e[?25h";
+        #endif
+    }
 ////////////////////////////////////////////////////////////////////////////////
 private:                                                   //    PRIVATE METHODS
 ////////////////////////////////////////////////////////////////////////////////
@@ -184,13 +182,33 @@ private:                                                   //    PRIVATE METHODS
         interval = ((float)max/updates);
     }
 ////////////////////////////////////////////////////////////////////////////////
-/// blanks the current line and brings back the cursor
-void cancel(sost& o=std::cerr) const
+    /// sends the progress bar for iteration @p current to @p o
+    void draw(step current, sost& o) const
     {
-        blank_line(o);
+        // do away with the cursor
         #ifdef UNIXLIKE
-        o << "\e[?25h";
+        o << "\e[?25l";
         #endif
+
+        // fill line with background symbol
+        for (int i = 0; i < PSD+lbracketSize; ++i) o << " ";
+        for (unsigned i = 0; i < pres; ++i) o << pre;
+        o << rbracket << "\r";
+        o.flush();
+
+        // calculate percentage and make a string of it
+        float prct = ((float)current/max)*100;
+        sstr strprct = helper::to_string((int)prct);
+        // get percantge to length of three
+        if (helper::utf8_size(strprct) < 2) strprct = " "+strprct;
+        if (helper::utf8_size(strprct) < 3) strprct = " "+strprct;
+
+        // print percentage and bar
+        o << "[" << strprct << "% ] " << lbracket;
+        for (auto i = pbar.begin(); i != pbar.end(); ++i) o << *i;
+
+        o << "\r";
+        o.flush();
     }
 ////////////////////////////////////////////////////////////////////////////////
 /// blanks the current line by filling it with spaces
@@ -233,6 +251,61 @@ private:                                                   //     PRIVATE FIELDS
     int rbracketSize; ///< size of right bracket literal
 }; // Progressbar
 
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  Progress                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief progress bar for a loop that only counts its steps through add();
+ *        the bar is drawn by a render thread at a fixed rate
+ */
+class Progress
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief shows progress towards @p max steps, if stdout is a terminal
+     * @param hz frames per second
+     */
+    explicit Progress(Progressbar::step max, unsigned hz=10)
+    :renderer(hz)
+    {
+        if (!helper::stdout_is_terminal()) return;
+        bar.reset(new Progressbar(max));
+        renderer.start([this]()
+        {
+            bar->show(counter.get());
+        });
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// stops the render thread and clears the line
+    ~Progress()
+    {
+        renderer.stop();
+        if (bar) bar->cancel();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// counts a step of the loop; only to be called by one thread
+    void add()
+    {
+        counter.add();
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    Progress(const Progress&);
+    Progress& operator=(const Progress&);
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    RENDER::Counter counter;               ///< steps of the loop
+    std::unique_ptr<Progressbar> bar;      ///< the bar, if shown at all
+    RENDER::Renderer renderer;             ///< draws \b bar; destroyed first
+////////////////////////////////////////////////////////////////////////////////
+}; // Progress
+
 } // LOAD
 
 #endif // __LOAD__HPP
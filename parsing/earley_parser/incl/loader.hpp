@@ -0,0 +1,338 @@
+/**
+ * @file loader.hpp
+ * Parallel loading of text files. \b ParallelLoader maps a file, splits it
+ * into chunks at line ends and reads the chunks on several threads. Every
+ * chunk numbers the symbols it meets on its own, in the order it meets
+ * them. The chunks are then merged in file order, so every symbol gets the
+ * ID it would have got from reading the file line by line, no matter how
+ * many threads were used.
+ * Grammar files are loaded into a \b RuleTable, from which a grammar is
+ * compiled.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __LOADER__HPP
+#define __LOADER__HPP
+
+#include "declarations.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "helper.hpp"
+#include "grammar.hpp"
+#include "mapped.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief symbols and rules of a grammar in the form they are compiled from
+ * @details rules are records [lhs, rhs length, rhs symbols...], stored one
+ *          after the other in \b rules
+ * @tparam EXTERNSYM external symbol type; std::string
+ */
+template <typename EXTERNSYM>
+struct RuleTable
+{
+    typedef std::int32_t Sym;
+
+    std::vector<EXTERNSYM> symbols;   ///< names by ID; empty for unused IDs
+    std::vector<Sym> start;           ///< record of the start rule
+    std::vector<Sym> rules;           ///< records of all other rules
+    std::vector<std::uint32_t> order; ///< offsets of the records in rules
+
+    /// @returns true, if record @p a sorts before record @p b: by LHS, then
+    /// by RHS length, then by RHS
+    static bool less(const Sym* a, const Sym* b)
+    {
+        return std::lexicographical_compare(a, a+2+a[1], b, b+2+b[1]);
+    }
+
+    /// adds record @p r to \b rules and \b order
+    void add(const std::vector<Sym>& r)
+    {
+        order.push_back(rules.size());
+        rules.insert(rules.end(), r.begin(), r.end());
+    }
+
+    /// sorts \b order by the records and drops duplicate rules
+    void sort()
+    {
+        const Sym* r = rules.data();
+        std::sort(order.begin(), order.end(), [r](std::uint32_t a, std::uint32_t b)
+        {
+            return less(r+a, r+b);
+        });
+        order.erase(std::unique(order.begin(), order.end(),
+                                [r](std::uint32_t a, std::uint32_t b)
+        {
+            return !less(r+a, r+b) && !less(r+b, r+a);
+        }), order.end());
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// symbols of one chunk, numbered in the order they were met
+template <typename EXTERNSYM>
+struct LocalSymbols
+{
+    std::unordered_map<EXTERNSYM, std::uint32_t> ids;   ///< number of each name
+    std::vector<EXTERNSYM> names;                       ///< names by number
+
+    /// @returns number of @p es; numbers @p es if it is new
+    std::uint32_t intern(const EXTERNSYM& es)
+    {
+        auto i = ids.insert(std::make_pair(es, (std::uint32_t)names.size()));
+        if (i.second) names.push_back(es);
+        return i.first->second;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               ParallelLoader                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief reads text files in line-aligned chunks on several threads
+ */
+class ParallelLoader
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// begin and end of a chunk
+typedef std::pair<const char*, const char*>                               Chunk;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns @p threads, or the number of cores if @p threads is 0
+    static unsigned thread_count(unsigned threads)
+    {
+        if (threads > 0) return threads;
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief splits the @p n chars at @p p into up to @p parts chunks of
+     *        about equal size; every chunk but the last ends after a '\n'
+     */
+    static std::vector<Chunk> split(const char* p, std::size_t n, unsigned parts)
+    {
+        std::vector<Chunk> chunks;
+        const char* end = p+n;
+        const char* b = p;
+        for (unsigned i = 1; i <= parts && b < end; ++i)
+        {
+            const char* e = std::max(b, p + n/parts*i);
+            if (i == parts) e = end;
+            e = std::find(e, end, '\n');
+            if (e != end) ++e;
+            chunks.push_back(Chunk(b, e));
+            b = e;
+        }
+        return chunks;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief calls @p f(i) for all i < @p n, each on a thread of its own
+     * @throws the exception thrown for the lowest i, if any
+     */
+    template <typename F>
+    static void run(std::size_t n, F f)
+    {
+        std::vector<std::exception_ptr> errors(n);
+        std::vector<std::thread> threads;
+        auto call = [&f, &errors](std::size_t i)
+        {
+            try
+            {
+                f(i);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        };
+        for (std::size_t i = 1; i < n; ++i) threads.push_back(std::thread(call, i));
+        if (n > 0) call(0);
+        for (auto t = threads.begin(); t != threads.end(); ++t) t->join();
+        for (auto e = errors.begin(); e != errors.end(); ++e)
+        {
+            if (*e) std::rethrow_exception(*e);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief maps file @p path and passes its lines to @p f on @p threads
+     *        threads. Empty lines are skipped, as by std::getline loops.
+     * @param f called as f(part, line) with the \b PART of the chunk the line
+     *        is in
+     * @return the parts, in file order
+     * @throws LoadError if @p path cannot be read, or what @p f throws for
+     *         the first line in the file it throws for
+     */
+    template <typename PART, typename F>
+    static std::vector<PART> map_lines(const sstr& path, unsigned threads, F f)
+    {
+        MappedFile file(path);
+        std::vector<Chunk> chunks = split(file.data(), file.size(), thread_count(threads));
+        std::vector<PART> parts(chunks.size());
+        run(chunks.size(), [&](std::size_t i)
+        {
+            const char* p = chunks[i].first;
+            while (p < chunks[i].second)
+            {
+                const char* e = std::find(p, chunks[i].second, '\n');
+                if (e > p) f(parts[i], sstr(p, e));
+                p = e+1;
+            }
+        });
+        return parts;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief loads the rules of grammar file @p path on @p threads threads
+     * @details lines are validated and parsed as by \b Grammar. Symbols are
+     *          numbered as by \b Grammar, starting with the start rule
+     *          @p ss --> @p s; duplicate rules are dropped
+     * @tparam VALIDATOR rule validator, as for \b Grammar
+     * @tparam RULEPARSER rule parser, as for \b Grammar
+     * @param threads number of threads; 0 selects the number of cores
+     * @return the symbols and the sorted rules
+     * @throws LoadError if @p path cannot be read or holds malformed rules
+     */
+    template <typename VALIDATOR, typename RULEPARSER>
+    static RuleTable<typename RULEPARSER::ES> load_rules(const sstr& path,
+                                                          unsigned threads=0,
+                                                          typename RULEPARSER::ES ss="$",
+                                                          typename RULEPARSER::ES s="S",
+                                                          typename RULEPARSER::ES separator="-->")
+    {
+        typedef typename RULEPARSER::ES             ES;
+        typedef typename RULEPARSER::ESVec          ESVec;
+        typedef RuleTable<ES>                       Table;
+        typedef typename Table::Sym                 Sym;
+        struct Part
+        {
+            LocalSymbols<ES> symbols;
+            Table table;
+        };
+
+        // read the chunks, numbering their symbols locally
+        std::vector<Part> parts = map_lines<Part>(path, threads,
+            [&separator](Part& part, const sstr& line)
+        {
+            VALIDATOR validator;
+            RULEPARSER ruleparser;
+            ESVec tokens = helper::tokenise(line);
+            if (!validator(tokens, separator))
+            {
+                throw LoadError("malformed grammar rule '"+helper::to_string(tokens)+"'");
+            }
+            std::vector<ESVec> sides = ruleparser(tokens, separator).first;
+            std::vector<Sym> record;
+            for (auto side = sides.begin(); side != sides.end(); ++side)
+            {
+                for (auto es = side->begin(); es != side->end(); ++es)
+                {
+                    record.push_back(part.symbols.intern(*es));
+                }
+                if (side == sides.begin()) record.push_back(sides.back().size());
+            }
+            part.table.add(record);
+        });
+
+        // number the symbols globally, chunk by chunk in file order
+        Table t;
+        std::unordered_map<ES, Sym> ids;
+        #if SOVERLOAD
+        // \b Grammar does not assign ID 0 then
+        t.symbols.push_back(ES());
+        #endif
+        auto translate = [&t, &ids](const ES& es)
+        {
+            auto i = ids.insert(std::make_pair(es, (Sym)t.symbols.size()));
+            if (i.second) t.symbols.push_back(es);
+            return i.first->second;
+        };
+        Sym start_lhs = translate(ss);
+        t.start = { start_lhs, 1, translate(s) };
+        std::vector<std::vector<Sym>> global(parts.size());
+        for (std::size_t i = 0; i < parts.size(); ++i)
+        {
+            const std::vector<ES>& names = parts[i].symbols.names;
+            for (auto n = names.begin(); n != names.end(); ++n)
+            {
+                global[i].push_back(translate(*n));
+            }
+        }
+
+        // translate and sort the records of every chunk
+        run(parts.size(), [&](std::size_t i)
+        {
+            Table& pt = parts[i].table;
+            for (auto o = pt.order.begin(); o != pt.order.end(); ++o)
+            {
+                Sym* r = pt.rules.data() + *o;
+                r[0] = global[i][r[0]];
+                for (Sym k = 0; k < r[1]; ++k) r[2+k] = global[i][r[2+k]];
+            }
+            pt.sort();
+            LocalSymbols<ES>().ids.swap(parts[i].symbols.ids);
+        });
+
+        // merge the sorted chunks, dropping rules found in several chunks
+        typedef std::pair<std::size_t, std::size_t> Cursor;   // part, index
+        auto at = [&parts](const Cursor& c)
+        {
+            return parts[c.first].table.rules.data() + parts[c.first].table.order[c.second];
+        };
+        auto later = [&at](const Cursor& a, const Cursor& b)
+        {
+            return Table::less(at(b), at(a));
+        };
+        std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heap(later);
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < parts.size(); ++i)
+        {
+            if (!parts[i].table.order.empty()) heap.push(Cursor(i, 0));
+            total += parts[i].table.rules.size();
+        }
+        t.rules.reserve(total);
+        const Sym* last = nullptr;
+        while (!heap.empty())
+        {
+            Cursor c = heap.top();
+            heap.pop();
+            const Sym* r = at(c);
+            if (!last || Table::less(last, r))
+            {
+                t.order.push_back(t.rules.size());
+                t.rules.insert(t.rules.end(), r, r+2+r[1]);
+                last = r;
+            }
+            if (++c.second < parts[c.first].table.order.size()) heap.push(c);
+        }
+        return t;
+    }
+////////////////////////////////////////////////////////////////////////////////
+}; // ParallelLoader
+
+} // Earley
+
+#endif // __LOADER__HPP
@@ -0,0 +1,182 @@
+/**
+ * @file mapped.hpp
+ * Read-only files in memory. \b MappedFile maps a whole file into memory
+ * where the system supports it and reads it into a buffer elsewhere, so
+ * grammar and lexicon images can be used in place on every platform.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __MAPPED__HPP
+#define __MAPPED__HPP
+
+#include "declarations.hpp"
+
+#ifdef UNIXLIKE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "grammar.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                 MappedFile                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief contents of a file, mapped read-only into memory
+ * @details the contents are aligned to 8 bytes in either case, so images
+ *          may hold arrays of integers at aligned offsets
+ */
+class MappedFile
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief maps file @p path
+     * @throws LoadError if @p path cannot be opened or mapped
+     */
+    explicit MappedFile(const sstr& path)
+    :begin(nullptr), length(0), mapped(false)
+    {
+        #ifdef UNIXLIKE
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw LoadError("failed to open '"+path+"'");
+        struct stat st;
+        if (::fstat(fd, &st) < 0)
+        {
+            ::close(fd);
+            throw LoadError("failed to open '"+path+"'");
+        }
+        length = st.st_size;
+        if (length > 0)
+        {
+            void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd);
+                throw LoadError("failed to map '"+path+"'");
+            }
+            begin = static_cast<const char*>(p);
+            mapped = true;
+        }
+        ::close(fd);
+        #else
+        std::ifstream f(path, std::ios::binary);
+        if (!f.is_open()) throw LoadError("failed to open '"+path+"'");
+        f.seekg(0, f.end);
+        length = f.tellg();
+        f.seekg(0, f.beg);
+        buffer.resize((length+7)/8);
+        f.read(reinterpret_cast<char*>(buffer.data()), length);
+        begin = reinterpret_cast<const char*>(buffer.data());
+        #endif
+    }
+////////////////////////////////////////////////////////////////////////////////
+    ~MappedFile()
+    {
+        #ifdef UNIXLIKE
+        if (mapped) ::munmap(const_cast<char*>(begin), length);
+        #endif
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns first byte of the file
+    const char* data() const
+    {
+        return begin;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns size of the file in bytes
+    std::size_t size() const
+    {
+        return length;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the file is mapped rather than read
+    bool is_mapped() const
+    {
+        return mapped;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief tells the system that the file will be read once from front
+     *        to back, so it reads ahead further and drops pages behind
+     */
+    void advise_sequential() const
+    {
+        #ifdef UNIXLIKE
+        if (mapped) ::madvise(const_cast<char*>(begin), length, MADV_SEQUENTIAL);
+        #endif
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief FNV-1a checksum of the @p n bytes at @p p. Used to detect
+     *        damaged images; not meant to resist tampering
+     * @param seed checksum of the bytes before @p p, if the checksum is
+     *        computed piece by piece
+     */
+    static std::uint64_t checksum(const char* p, std::size_t n,
+                                  std::uint64_t seed=14695981039346656037ull)
+    {
+        std::uint64_t h = seed;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            h ^= (unsigned char)p[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief writes the magic of images of kind @p kind, 7 chars, to @p m,
+     *        followed by a mark for the byte order of this machine
+     */
+    static void magic(char* m, const char* kind)
+    {
+        const std::uint16_t bom = 1;
+        std::memcpy(m, kind, 7);
+        m[7] = *reinterpret_cast<const char*>(&bom) ? 'L' : 'B';
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if file @p path starts with the 7 chars of @p kind
+    static bool has_magic(const sstr& path, const char* kind)
+    {
+        char m[8] = {0};
+        std::ifstream f(path, std::ios::binary);
+        f.read(m, sizeof m);
+        return f && std::memcmp(m, kind, 7) == 0;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    const char* begin;                   ///< contents
+    std::size_t length;                  ///< size of the contents
+    bool mapped;                         ///< whether \b begin is mapped
+    std::vector<std::uint64_t> buffer;   ///< contents, if not mapped
+////////////////////////////////////////////////////////////////////////////////
+}; // MappedFile
+
+} // Earley
+
+#endif // __MAPPED__HPP
@@ -18,18 +18,27 @@
 #endif
 
 #include <assert.h>
+#include <algorithm>
 #include <vector>
 #include <set>
 #include <fstream>
 #include <unordered_set>
 #include <unordered_map>
+#include <memory>
+#include <stdexcept>
 
 #include "declarations.hpp"
 #include "helper.hpp"
 #include "item.hpp"
 #include "chart.hpp"
 #include "busy.hpp"
-#include "grammar.hpp"
+#include "cache.hpp"
+#include "compiled.hpp"
+#include "corpus.hpp"
+#include "dump.hpp"
+#include "lexicon.hpp"
+#include "prefix.hpp"
+#include "spans.hpp"
 
 
 namespace Earley
@@ -41,8 +50,15 @@ namespace Earley
 ////////////////////////////////////////////////////////////////////////////////
 /**
  * @brief implementation of the Earley Parser
- * @tparam GRAMMAR grammar type to parse on
- * @pre GRAMMAR is required to be templated with Earley::CFGRuleParser<IS, ES>
+ * @details The parser only refers to its grammar, which needs to outlive it.
+ *          The lexicon is shared between copies of a parser, so copying a
+ *          parser is cheap and gives an independent chart on the same
+ *          grammar and lexicon.
+ *          A parse can either be run in one go with parse(), cell by cell
+ *          with begin() and advance(), or token by token with begin(),
+ *          push() and finish() while the sentence is still arriving.
+ * @tparam GRAMMAR compiled grammar type to parse on, e.g.
+ *         \b Earley::CompiledGrammar<IS, ES>
  */
 template <typename GRAMMAR>
 class EarleyParser
@@ -51,25 +67,33 @@ class EarleyParser
 public:                                                    //    PUBLIC TYPEDEFS
 ////////////////////////////////////////////////////////////////////////////////
 typedef GRAMMAR                                                         Grammar;
+/// the Lexicon type for this \b Parser
+typedef Earley::Lexicon<typename Grammar::IS, typename Grammar::ES>     Lexicon;
+/// binary corpus over the lexicon
+typedef Earley::BinaryCorpus<Lexicon>                                    Corpus;
+/// exporter rendering the chart
+typedef ChartExporter<EarleyChart<EarleyParser>>                       Exporter;
+/// writer of binary chart dumps
+typedef ChartDumpWriter<EarleyChart<EarleyParser>>                   DumpWriter;
+/// processed chart cells shared between sentences
+typedef PrefixCache<typename EarleyChart<EarleyParser>::Item>          Prefixes;
+/// categories by span and spans by category
+typedef SpanIndex<typename GRAMMAR::IS>                                   Spans;
 ////////////////////////////////////////////////////////////////////////////////
 private:                                                   //    PRIATE TYPEDEFS
 ////////////////////////////////////////////////////////////////////////////////
-/// the Rule type for this \b Parser
-typedef typename Grammar::Rule                          Rule;
 /// the Chart type for this \b Parser
 typedef EarleyChart<EarleyParser>                       Chart;
 /// the Item type for \b chart
 typedef typename Chart::Item                            Item;
-typedef std::vector<Rule>                               RuleVec;
-typedef typename Rule::IS                               IS;
-typedef typename Rule::ISVec                            ISVec;
-typedef typename Rule::ESVec                            ESVec;
-typedef typename Rule::ES                               ES;
-typedef typename Grammar::Ruleset                       Ruleset;
+typedef typename Grammar::IS                            IS;
+typedef typename Grammar::ISVec                         ISVec;
+typedef typename Grammar::ESVec                         ESVec;
+typedef typename Grammar::ES                            ES;
+typedef typename Grammar::Sym                           Sym;
 typedef typename Chart::ItemSet                         ItemSet;
 typedef typename std::set<IS>                           ISSet;
 typedef typename std::map<IS, std::unordered_set<ES>>   TagID_Words_Map;
-typedef typename Rule::RulesideVec                      RulesideVec;
 ////////////////////////////////////////////////////////////////////////////////
 public:                                                    //     PUBLIC METHODS
 ////////////////////////////////////////////////////////////////////////////////
@@ -77,122 +101,430 @@ public:                                                    //     PUBLIC METHODS
      * @brief constructs parser with grammar \p g, a set of POS-tags
      *        \p tags and a map from tags to word \p pwm
      */
-    EarleyParser(Grammar& g, ISSet tags, TagID_Words_Map pwm)
-    :grammar(g),
-    tags(tags),
-    pwm(pwm)
+    EarleyParser(const Grammar& g, ISSet tags, TagID_Words_Map pwm)
+    :EarleyParser(g, std::make_shared<Lexicon>(tags, pwm))
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief constructs parser with grammar \p g and lexicon \p lexicon
+     */
+    EarleyParser(const Grammar& g, std::shared_ptr<const Lexicon> lexicon)
+    :grammar_ptr(&g),
+    lexicon(lexicon),
+    current(0),
+    // the closures know no features, so a factored grammar predicts by item
+    closed(!g.is_factored() && g.closes_predictions(*lexicon)),
+    factored(g.is_factored()),
+    optimized(g.is_optimized()),
+    busy(BUSY::Indicator<BUSY::Variant2>::available())
     {
-        grammar_ptr = &grammar;
     }
 ////////////////////////////////////////////////////////////////////////////////
     /**
      * @brief takes vector of ES tokens and parses it
      */
     bool parse(ESVec sentence)
+    {
+        begin(sentence);
+        advance();
+        // clear the busy indicator
+        if (busy) indicator.pause();
+        // determine, whether the string could be derived
+        return accepted();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief prepares the chart for parsing @p sentence. The cells are
+     *        then processed by advance()
+     */
+    void begin(ESVec& sentence)
     {
         // clear the chart (might be filled from previous sentence)
         chart.clear();
         // initialize the chart with the input and the start rule
         // of the grammar
-        chart.initialise(sentence, grammar.start);
-
-        bool new_p = false; // stores whether new items were predicted
-        bool new_c = false; // stores whether new items were completed
-
-        // loop over the chart
-        for (short index = 0; index < chart.size(); ++index)
+        chart.initialise(sentence, grammar_ptr->start_rule());
+        // look up the words in the lexicon; the last cell has no word
+        entries.clear();
+        for (auto w = sentence.begin(); w != sentence.end(); ++w)
         {
-            // initialize to_process with the items in the current cell
-            // (start item for first cell and all scanned items for other cells)
-            to_process.insert(chart[index].begin(), chart[index].end());
-            // keep predicting, scanning, completing, as long as
-            // new items can be added to the current cell
-            do
-            {
-                new_p = false;
-                new_c = false;
-                for (auto item = to_process.begin(); item != to_process.end(); ++item)
-                {
-                    // update the busy indicator
-                    bar.run();
-
-                    /*
-                     * A grammar might contain both rules 'A --> A' and 'A --> a'
-                     * In that case, it is necessary to apply predict() to the
-                     * former rule, because the 'A' of the RHS doubles as a
-                     * POS-tag and as a complex syntactic category.
-                     * Though 'A --> a' ought not be among the predicted rules,
-                     * as to not flood the cells with terminal rules like it.
-                     * For this case it is necessary to predict for rules that
-                     * have symbols that are in the tagset of the grammar as their
-                     * LHS, but to not add terminal rules to the cell.
-                     * The test for that is inside predict(), the test immediately
-                     * below just ensures these kinds of rules get passed to
-                     * predict() in the first place.
-                     */
-
-                     #if SOVERLOAD
-                    // in case SOVERLOAD is enabled, the parser will not check
-                    // whether item.next() is a tag
-                    if (!item->complete())
-                    #else
-
-                    /*
-                     * If a grammar does not contain both rules 'A --> A' and
-                     * 'A --> a', then rules with a POS-tag at the dot index do
-                     * not need to be passed to the predict() function, as there
-                     * are no rules in the grammar to predict from a POS-tag
-                     * anyway.
-                     * If the grammar DOES contain terminal rules, it needs to
-                     * be avoided to predict anything for said rules that have
-                     * a POS-tag at the dot index, as there are indeed rules to
-                     * predict, namely all the terminal rules that have the
-                     * symbol at dot index as their LHS. But it is not desired
-                     * to predict terminal rules. Therefore these need to be
-                     * filtered out.
-                     */
-
-                    // if SOVERLOAD is not enabled, the parser will filter out
-                    // all rules that have the dot at a POS-tag, before passing
-                    // them to predict()
-                    if (!item->complete() && tags.find(item->next()) == tags.end())
-                    #endif
-
-                    {
-                        // predict items
-                        if(predict(*item)) new_p = true;
-                    }
-                    // if the symbol at dot index is a POS-tag...
-                    if (!item->complete() && tags.find(item->next()) != tags.end())
-                    {
-                        // add terminal rules to the next cell
-                        // by scanning rules in this cell
-                        scan(*item);
-                    }
-                    // if the item is complete (has the dot behind its last RHS
-                    // symbol)...
-                    else if (item->complete())
-                    {
-                        // complete rules in this cell
-                        if(complete(*item)) new_c = true;
-                    }
-                }
-                // merge the items that have been processed in this
-                // iteration with the current cell
-                merge(index);
-            }
-            while(new_p || new_c);
+            entries.push_back(lexicon->find(*w));
         }
-        // clear the busy indicator
-        bar.cancel();
-        // determine, whether the string could be derived
+        entries.push_back(Lexicon::none());
+        start();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief prepares the chart for parsing the @p n tokens @p tokens of
+     *        lengths @p lengths. The tokens are only looked up in the
+     *        lexicon, not copied, and need not outlive the call. The chart
+     *        does not know the tokens, show_chart() leaves them out.
+     */
+    void begin(const char* const* tokens, const std::size_t* lengths, std::size_t n)
+    {
+        chart.clear();
+        chart.initialise(n, grammar_ptr->start_rule());
+        entries.clear();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            entries.push_back(lexicon->find(tokens[i], lengths[i]));
+        }
+        entries.push_back(Lexicon::none());
+        start();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief prepares the chart for parsing the @p n tokens @p tokens,
+     *        which are only looked up in the lexicon, as by
+     *        begin(const char* const*, const std::size_t*, std::size_t)
+     */
+    void begin(const helper::StrView* tokens, std::size_t n)
+    {
+        chart.clear();
+        chart.initialise(n, grammar_ptr->start_rule());
+        entries.clear();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            entries.push_back(lexicon->find(tokens[i].data(), tokens[i].size()));
+        }
+        entries.push_back(Lexicon::none());
+        start();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief parses the tokens @p sentence without copying them; see
+     *        begin(const helper::StrView*, std::size_t)
+     */
+    bool parse(const std::vector<helper::StrView>& sentence)
+    {
+        begin(sentence.data(), sentence.size());
+        advance();
+        if (busy) indicator.pause();
+        return accepted();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief prepares the chart for parsing sentence @p s of a binary
+     *        corpus made with the lexicon of the parser. Its tokens have
+     *        been looked up already; no string is touched.
+     */
+    void begin(const typename Corpus::Sentence& s)
+    {
+        chart.clear();
+        chart.initialise(s.size(), grammar_ptr->start_rule());
+        entries.clear();
+        for (std::size_t i = 0; i < s.size(); ++i)
+        {
+            entries.push_back(s.corpus->entry(s.words[i]));
+        }
+        entries.push_back(Lexicon::none());
+        start();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// parses sentence @p s of a binary corpus; see begin(const Corpus::Sentence&)
+    bool parse(const typename Corpus::Sentence& s)
+    {
+        begin(s);
+        advance();
+        if (busy) indicator.pause();
+        return accepted();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief starts a sentence whose tokens are passed one at a time to
+     *        push(), as they arrive; finish() ends it. The chart grows by a
+     *        cell per token and does not know the tokens. Neither the
+     *        result cache nor the prefix cache is used.
+     */
+    void begin()
+    {
+        chart.clear();
+        chart.initialise(0, grammar_ptr->start_rule());
+        entries.assign(1, Lexicon::none());
+        current = 0;
+        resume_cells = 0;
+        frontier = -1;
+        hit = pending = false;
+        streamed = true;
+        spans.clear();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief appends token @p token to the sentence started by begin() and
+     *        processes the cell before it, which scans it
+     * @return true, if the tokens pushed so far can begin a sentence of the
+     *         grammar
+     * @pre requires finish() not to have been called since begin()
+     */
+    bool push(const ES& token)
+    {
+        return push_entry(lexicon->find(token));
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief appends the token @p token of @p length bytes, which is only
+     *        looked up in the lexicon; see push(const ES&)
+     */
+    bool push(const char* token, std::size_t length)
+    {
+        return push_entry(lexicon->find(token, length));
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief ends the sentence started by begin() and processes its last
+     *        cell
+     * @return true, if the tokens pushed are a sentence of the grammar
+     */
+    bool finish()
+    {
+        advance();
+        if (busy) indicator.pause();
+        return accepted();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief makes the parser index the spans of the complete items of
+     *        every cell it finishes, see span_index(); off by default
+     */
+    void set_span_index(bool b)
+    {
+        index_spans = b;
+        spans.clear();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief categories by span and spans by category of the cells
+     *        processed so far, if enabled with set_span_index()
+     * @details queries return ranges into the index, which are valid until
+     *          the parser continues. Sentences found in the result cache
+     *          have no spans.
+     */
+    const Spans& span_index() const
+    {
+        return spans;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief tags that can follow the tokens processed so far: those after
+     *        the dot of the items in the cell after them. That cell is
+     *        processed first, if need be; push() then only scans it.
+     * @details after push() these are the tags of the next token, after a
+     *          whole parse those of a token appended to the sentence. Not
+     *          for sentences found in the result cache, whose cells have not
+     *          been processed.
+     * @return sorted tags
+     */
+    ISVec expected_tags()
+    {
+        ISVec tags;
+        const ItemSet& cell = chart[process_frontier()];
+        for (auto item = cell.begin(); item != cell.end(); ++item)
+        {
+            if (item->complete() || !lexicon->is_tag(item->next())) continue;
+            // a factored grammar expects the tags its items agree with
+            if (factored) grammar_ptr->unfactor(item->rule, item->dot, item->features, tags);
+            else tags.push_back(item->next());
+        }
+        std::sort(tags.begin(), tags.end());
+        tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+        return tags;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief words that can follow the tokens processed so far: the words
+     *        that have any of the expected_tags()
+     * @return lexicon indices, ordered by ambiguity class
+     */
+    std::vector<unsigned> expected_words()
+    {
+        ISVec tags = expected_tags();
+        std::vector<std::uint32_t> classes;
+        for (auto t = tags.begin(); t != tags.end(); ++t)
+        {
+            std::vector<std::uint32_t> c = lexicon->tag_classes(*t);
+            classes.insert(classes.end(), c.begin(), c.end());
+        }
+        std::sort(classes.begin(), classes.end());
+        classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+        std::vector<unsigned> words;
+        for (auto c = classes.begin(); c != classes.end(); ++c)
+        {
+            auto range = lexicon->class_words(*c);
+            words.insert(words.end(), range.first, range.second);
+        }
+        return words;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief edits the sentence of the last parse: replaces the @p count
+     *        tokens at @p index by @p tokens, so that tokens are inserted
+     *        if @p count is 0 and deleted if @p tokens is empty. Cell i
+     *        depends only on the tokens before it, so the cells up to
+     *        @p index that have been processed are kept; advance() then
+     *        processes the others.
+     * @return number of cells kept, as returned by resumed()
+     * @throws std::out_of_range if the tokens to replace are not in the
+     *         sentence
+     */
+    short edit(short index, short count, const ESVec& tokens)
+    {
+        std::vector<unsigned> inserted;
+        for (auto t = tokens.begin(); t != tokens.end(); ++t)
+        {
+            inserted.push_back(lexicon->find(*t));
+        }
+        return replace_words(index, count, inserted, tokens);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief edits the sentence of the last parse, replacing the @p count
+     *        tokens at @p index by the @p n tokens @p tokens of lengths
+     *        @p lengths; see edit(short, short, const ESVec&)
+     */
+    short edit(short index, short count, const char* const* tokens,
+               const std::size_t* lengths, std::size_t n)
+    {
+        std::vector<unsigned> inserted;
+        ESVec words;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            inserted.push_back(lexicon->find(tokens[i], lengths[i]));
+            // a chart that shows its tokens needs copies of them
+            if (!chart.get_tokens().empty()) words.push_back(ES(tokens[i], lengths[i]));
+        }
+        return replace_words(index, count, inserted, words);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief processes up to @p cells chart cells
+     * @return true, once all cells of the chart have been processed
+     */
+    bool advance(unsigned cells=-1)
+    {
+        if (busy) indicator.start();
+        for (; cells > 0 && !done(); --cells, ++current)
+        {
+            process(current);
+            if (prefixes && !streamed) prefixes->insert(key, current, chart[current]);
+            if (index_spans) spans.add_cell(current, chart, *grammar_ptr);
+        }
+        if (pending && done())
+        {
+            cache->insert(key, accepted());
+            pending = false;
+        }
+        return done();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if all cells of the chart have been processed
+    bool done()
+    {
+        return current >= chart.size();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the sentence passed to begin() has been recognised
+    /// @pre requires done() to be true
+    bool accepted()
+    {
+        if (hit) return hit_result;
         return ((chart.end()-1)->find(chart.get_final()) != (chart.end()-1)->end());
     }
+////////////////////////////////////////////////////////////////////////////////
+    /// frees the memory held by the chart and the item buffers
+    void release()
+    {
+        chart = Chart();
+        entries = std::vector<unsigned>();
+        current = 0;
+        resume_cells = 0;
+        frontier = -1;
+        hit = pending = false;
+        spans.clear();
+        ItemSet().swap(predict_buffer);
+        ItemSet().swap(complete_buffer);
+        ItemSet().swap(to_process);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief makes the parser look up the signature of every sentence in
+     *        @p c before parsing it, and store the results of those not
+     *        found; nullptr to parse every sentence. The cache must outlive
+     *        the parser and may be shared between parsers.
+     * @details a sentence found in the cache is not parsed: done() is true
+     *          right after begin() and the chart holds no more than the
+     *          start item. The cache is only useful when charts are not
+     *          needed.
+     */
+    void set_cache(ResultCache* c)
+    {
+        cache = c;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief makes the parser resume every sentence after the longest
+     *        prefix of ambiguity classes whose cells are in @p p, and store
+     *        the cells it processes; nullptr to start at cell 0. The cache
+     *        must outlive the parser and may be shared between parsers.
+     * @details the cells taken from the cache hold the same items as if
+     *          they had been processed, so charts are complete.
+     */
+    void set_prefix_cache(Prefixes* p)
+    {
+        prefixes = p;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of cells of the current sentence that have not been
+    /// processed for it: taken from the prefix cache or kept by edit()
+    short resumed() const
+    {
+        return resume_cells;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the result of the sentence passed to begin() has
+    /// been found in the cache
+    bool cache_hit() const
+    {
+        return hit;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the ambiguity class of every word of the sentence passed to
+    /// begin(); Lexicon::none() for unknown words
+    Signature signature() const
+    {
+        Signature s;
+        s.reserve(entries.size()-1);
+        for (auto e = entries.begin(); e+1 < entries.end(); ++e)
+        {
+            s.push_back(*e == Lexicon::none() ? Lexicon::none() : lexicon->get_class(*e));
+        }
+        return s;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// enables or disables the busy indicator
+    void set_busy_indicator(bool b)
+    {
+        busy = b && BUSY::Indicator<BUSY::Variant2>::available();
+    }
 ////////////////////////////////////////////////////////////////////////////////
     /// sends representation of the chart to stream @p o
     void show_chart(sost& o=std::cout)
     {
-        chart.show(o);
+        Exporter exporter(*grammar_ptr, o);
+        export_chart(exporter);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// renders the chart with @p exporter
+    void export_chart(Exporter& exporter) const
+    {
+        // lexical items show the words as they are in the lexicon
+        exporter.write(chart, word_views());
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// appends the chart to chart dump @p dump
+    void dump_chart(DumpWriter& dump) const
+    {
+        dump.write(chart, word_views());
     }
 ////////////////////////////////////////////////////////////////////////////////
     /// @returns a copy of the \b chart
@@ -200,8 +532,271 @@ public:                                                    //     PUBLIC METHODS
     {
         return chart;
     }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the lexicon
+    const Lexicon& get_lexicon() const
+    {
+        return *lexicon;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns lexicon index of the word at @p index; Lexicon::none() if
+    /// the word is unknown
+    unsigned get_entry(short index) const
+    {
+        return entries[index];
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of cells of the chart
+    short cell_count() const
+    {
+        return chart.size();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of items in chart cell @p index
+    std::size_t item_count(short index) const
+    {
+        return chart[index].size();
+    }
 ////////////////////////////////////////////////////////////////////////////////
 private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// appends a cell for the word of lexicon index @p entry and processes
+    /// the cell before it; @returns true, if the word has been scanned
+    bool push_entry(unsigned entry)
+    {
+        entries.back() = entry;
+        entries.push_back(Lexicon::none());
+        chart.extend();
+        // a cell processed by expected_tags() only lacks the word
+        if (frontier == current)
+        {
+            ++current;
+            rescan();
+        }
+        else
+        {
+            process(current);
+            if (index_spans) spans.add_cell(current, chart, *grammar_ptr);
+            ++current;
+        }
+        return !chart[current].empty();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// processes the cell after the cells processed so far, unless it has
+    /// been processed; @returns its index
+    short process_frontier()
+    {
+        if (done()) return chart.size()-1;
+        if (frontier != current)
+        {
+            process(current);
+            if (index_spans) spans.add_cell(current, chart, *grammar_ptr);
+        }
+        frontier = current;
+        return current;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// starts the parse prepared by begin(), unless its result is cached
+    void start()
+    {
+        current = 0;
+        resume_cells = 0;
+        frontier = -1;
+        hit = pending = false;
+        streamed = false;
+        spans.clear();
+        if (!cache && !prefixes) return;
+        key = signature();
+        if (cache)
+        {
+            hit = cache->find(key, hit_result);
+            pending = !hit;
+            // nothing is left to process
+            if (hit)
+            {
+                current = chart.size();
+                return;
+            }
+        }
+        if (prefixes) resume();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief replaces the @p count words at @p index by those of lexicon
+     *        indices @p inserted and tokens @p tokens, and keeps the cells
+     *        up to @p index that have been processed
+     * @return number of cells kept
+     */
+    short replace_words(short index, short count, const std::vector<unsigned>& inserted,
+                        const ESVec& tokens)
+    {
+        short length = entries.size()-1;
+        if (index < 0 || count < 0 || index > length || count > length-index)
+        {
+            throw std::out_of_range("edit of tokens ["+helper::to_string(index)+", "+
+                                    helper::to_string(index+count)+") of a sentence of "+
+                                    helper::to_string(length)+" tokens");
+        }
+        // the cells of a cached result have not been processed
+        short processed = hit ? 0 : current;
+        entries.erase(entries.begin()+index, entries.begin()+index+count);
+        entries.insert(entries.begin()+index, inserted.begin(), inserted.end());
+        chart.replace(index, count, tokens, inserted.size());
+        hit = pending = false;
+        frontier = -1;
+        if (cache || prefixes) key = signature();
+        if (cache)
+        {
+            hit = cache->find(key, hit_result);
+            pending = !hit;
+        }
+        // a cell that has not been processed yet holds the words scanned
+        // into it, which are still the same
+        resume_cells = current = std::min<short>(processed, index+1);
+        spans.truncate(current);
+        if (hit) current = chart.size();
+        else if (current == index+1) rescan();
+        return resume_cells;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// copies the cells of the longest prefix of \b key in \b prefixes into
+    /// the chart and scans the word after them
+    void resume()
+    {
+        std::vector<typename Prefixes::CellPtr> cells;
+        resume_cells = prefixes->find(key, cells);
+        for (short i = 0; i < resume_cells; ++i)
+        {
+            chart[i].reserve(cells[i]->size());
+            chart[i].insert(cells[i]->begin(), cells[i]->end());
+            if (index_spans) spans.add_cell(i, chart, *grammar_ptr);
+        }
+        current = resume_cells;
+        // the scanned items of the next cell are not stored
+        if (current > 0) rescan();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// scans the word before cell \b current from the processed cell
+    /// before it, which is the last step of process() that reaches beyond
+    /// the processed cell
+    void rescan()
+    {
+        if (done()) return;
+        const ItemSet& last = chart[current-1];
+        for (auto item = last.begin(); item != last.end(); ++item)
+        {
+            if (!item->complete() && lexicon->is_tag(item->next())) scan(*item);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the word scanned at every index, as it is in the lexicon;
+    /// empty for unknown words
+    std::vector<helper::StrView> word_views() const
+    {
+        std::vector<helper::StrView> words;
+        words.reserve(entries.size());
+        for (auto e = entries.begin(); e != entries.end(); ++e)
+        {
+            words.push_back(*e == Lexicon::none() ? helper::StrView() : lexicon->view_word(*e));
+        }
+        return words;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// predicts, scans and completes until no new items can be added to the
+    /// cell at @p index
+    void process(short index)
+    {
+        bool new_p = false; // stores whether new items were predicted
+        bool new_c = false; // stores whether new items were completed
+
+        // categories are marked as predicted with the stamp of the cell
+        if (closed || optimized)
+        {
+            predicted.resize(grammar_ptr->symbol_count(), 0);
+            ++stamp;
+        }
+
+        // initialize to_process with the items in the current cell
+        // (start item for first cell and all scanned items for other cells)
+        to_process.insert(chart[index].begin(), chart[index].end());
+        // keep predicting, scanning, completing, as long as
+        // new items can be added to the current cell
+        do
+        {
+            new_p = false;
+            new_c = false;
+            for (auto item = to_process.begin(); item != to_process.end(); ++item)
+            {
+                // count the item for the busy indicator
+                if (busy) indicator.tick();
+
+                /*
+                 * A grammar might contain both rules 'A --> A' and 'A --> a'
+                 * In that case, it is necessary to apply predict() to the
+                 * former rule, because the 'A' of the RHS doubles as a
+                 * POS-tag and as a complex syntactic category.
+                 * Though 'A --> a' ought not be among the predicted rules,
+                 * as to not flood the cells with terminal rules like it.
+                 * For this case it is necessary to predict for rules that
+                 * have symbols that are in the tagset of the grammar as their
+                 * LHS, but to not add terminal rules to the cell.
+                 * The test for that is inside predict(), the test immediately
+                 * below just ensures these kinds of rules get passed to
+                 * predict() in the first place.
+                 */
+
+                 #if SOVERLOAD
+                // in case SOVERLOAD is enabled, the parser will not check
+                // whether item.next() is a tag
+                if (!item->complete())
+                #else
+
+                /*
+                 * If a grammar does not contain both rules 'A --> A' and
+                 * 'A --> a', then rules with a POS-tag at the dot index do
+                 * not need to be passed to the predict() function, as there
+                 * are no rules in the grammar to predict from a POS-tag
+                 * anyway.
+                 * If the grammar DOES contain terminal rules, it needs to
+                 * be avoided to predict anything for said rules that have
+                 * a POS-tag at the dot index, as there are indeed rules to
+                 * predict, namely all the terminal rules that have the
+                 * symbol at dot index as their LHS. But it is not desired
+                 * to predict terminal rules. Therefore these need to be
+                 * filtered out.
+                 */
+
+                // if SOVERLOAD is not enabled, the parser will filter out
+                // all rules that have the dot at a POS-tag, before passing
+                // them to predict()
+                if (!item->complete() && !lexicon->is_tag(item->next()))
+                #endif
+
+                {
+                    // predict items
+                    if(predict(*item)) new_p = true;
+                }
+                // if the symbol at dot index is a POS-tag...
+                if (!item->complete() && lexicon->is_tag(item->next()))
+                {
+                    // add terminal rules to the next cell
+                    // by scanning rules in this cell
+                    scan(*item);
+                }
+                // if the item is complete (has the dot behind its last RHS
+                // symbol)...
+                else if (item->complete())
+                {
+                    // complete rules in this cell
+                    if(complete(*item)) new_c = true;
+                }
+            }
+            // merge the items that have been processed in this
+            // iteration with the current cell
+            merge(index);
+        }
+        while(new_p || new_c);
+    }
 ////////////////////////////////////////////////////////////////////////////////
     /**
      * @brief   completes items
@@ -214,6 +809,9 @@ private:                                                   //    PRIVATE METHODS
     bool complete(const Item& item)
     {
         bool any_new = false; // stores whether any items were completed
+        // in an optimized grammar, the categories above the LHS in chains
+        // of collapsed unary rules are complete as well
+        auto heads = grammar_ptr->chain_heads(item.get_lhs());
         // ... look up all items in the cell the current item has
         // specified as its 'from' value, that have the dot at the
         // same symbol that is the LHS of the current item
@@ -223,10 +821,18 @@ private:                                                   //    PRIVATE METHODS
         {
             // check if LHS of current item is symbol at dot index
             // of item2
-           if (!item2->complete() && item.get_lhs() == item2->next())
+           if (!item2->complete() &&
+               (item.get_lhs() == item2->next() ||
+                (heads.first != heads.second &&
+                 std::binary_search(heads.first, heads.second, item2->next()))))
            {
+                // in a factored grammar, item2 must also agree with the
+                // features of the current item
+                std::uint16_t features = item2->features;
+                if (factored && !grammar_ptr->agree(item2->rule, item2->dot, features,
+                                                    item.rule, item.features)) continue;
                 // if so, make a completed icon from it
-                Item item3(item2->rule, item2->dot+1, item2->from, item.to);
+                Item item3(item2->rule, item2->dot+1, item2->from, item.to, features);
                 assert(item.to == item.to && "left span border != item.to");
                 // if this item is not present yet, add it to complete_buffer
                 if(!chart.contains(item.to, item3) &&
@@ -252,20 +858,28 @@ private:                                                   //    PRIVATE METHODS
      */
     void scan(const Item& item)
     {
-        // test whether the token that corresponds with the current cell
-        // is in the words of the POS-tag at dot index of item
-        auto  pw_it = pwm.find(item.next());
-        if (pw_it != pwm.end() &&
-           pw_it->second.find(chart.get_word(item.to)) != pw_it->second.end())
+        // test whether the word that corresponds with the current cell
+        // can have the POS-tag at dot index of item
+        unsigned entry = entries[item.to];
+        // the tag of a factored grammar stands for several tags, of which
+        // the lexical item keeps those of the word
+        if (factored)
         {
-            // translate the word of the current cell into an IS
-            IS wordID = grammar.translate(chart.get_word(item.to));
-            // make a rule from the pos tag and the word at index
-            RulesideVec rsv = {ISVec(1, item.next()), ISVec(1, wordID)};
-            // call the constructor of Rule, that builds a rule form
-            // a vector of sides
-            // make an item with 'to' set to the index of the word+1
-            Item item2(Rule(grammar_ptr, rsv), 1, item.to, item.to+1);
+            if (entry == Lexicon::none()) return;
+            std::uint16_t features;
+            const ISVec& tags = lexicon->get_class_tags(lexicon->get_class(entry));
+            if (grammar_ptr->scan_features(item.next(), tags, features))
+            {
+                Item item2(grammar_ptr->lexical(item.next()), 1, item.to, item.to+1, features);
+                chart[item.to+1].insert(item2);
+            }
+            return;
+        }
+        if (entry != Lexicon::none() && lexicon->has_tag(entry, item.next()))
+        {
+            // make an item from the lexical rule of the pos tag, with 'to'
+            // set to the index of the word+1. The word is implied by 'from'
+            Item item2(grammar_ptr->lexical(item.next()), 1, item.to, item.to+1);
             assert (item.to+1 <= chart.size() && "chart ubervoll");
             // add the new item to the next chart cell
             chart[item.to+1].insert(item2);
@@ -274,20 +888,60 @@ private:                                                   //    PRIVATE METHODS
 ////////////////////////////////////////////////////////////////////////////////
     /**
      * @brief   predicts items
-     * @details adds predicted items to predict_buffer
+     * @details adds predicted items to predict_buffer. If the grammar closes
+     *          its predictions, all categories predicted from item.next()
+     *          are predicted at once; the items predicted then need not
+     *          predict again. In an optimized grammar, the categories below
+     *          item.next() in collapsed chains of unary rules are predicted
+     *          with it, each once per cell.
      * @param   item the item on the basis of which to potentially predict
      *          new ones
      */
     bool predict(const Item& item)
     {
+        if (!closed)
+        {
+            bool any_new = predict(item.next(), item.to, &item);
+            auto tails = grammar_ptr->chain_tails(item.next());
+            for (auto t = tails.first; t != tails.second; ++t)
+            {
+                if (predicted[*t] == stamp) continue;
+                predicted[*t] = stamp;
+                if (predict(*t, item.to, &item)) any_new = true;
+            }
+            return any_new;
+        }
+        // only the start item and predicted items have their dot at 0
+        if (item.dot == 0 && item.rule != grammar_ptr->start_rule()) return false;
+        bool any_new = false; // stores whether any items were predicted
+        auto ps = grammar_ptr->predictions(item.next());
+        for (auto p = ps.first; p != ps.second; ++p)
+        {
+            // the rules of a category are predicted once per cell
+            if (predicted[*p] == stamp) continue;
+            predicted[*p] = stamp;
+            if (predict(*p, item.to)) any_new = true;
+        }
+        return any_new;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief   predicts the items of the rules with LHS @p lhs in cell
+     *          @p index
+     * @details adds predicted items to predict_buffer. In a factored
+     *          grammar, they agree with the features item @p by expects.
+     */
+    bool predict(IS lhs, short index, const Item* by=nullptr)
+    {
+        assert((!factored || by) && "a factored grammar predicts by item");
         bool any_new = false; // stores whether any items were predicted
 
-        // lookup all rules that have item.next() as their LHS
-        ISVec s = {item.next()};
-        Ruleset rs = grammar[s];
-        // iterate over all rules in the Ruleset
-        for (auto r = rs.begin(); r != rs.end(); ++r)
+        // lookup all rules that have lhs as their LHS
+        auto rs = grammar_ptr->rules_for(lhs);
+        // iterate over all rules with that LHS
+        for (auto r = rs.first; r != rs.second; ++r)
         {
+            const Sym* rule = grammar_ptr->rule(*r);
             /*
              * If SOVERLOAD is enabled, all rules that are terminal rules will
              * be filtered out. If SOVERLOAD is not enabled, the parser assumes
@@ -300,7 +954,7 @@ private:                                                   //    PRIVATE METHODS
              * through ( as well as all other normal rules like 'B --> C').
              */
              #if SOVERLOAD
-             if (grammar.is_word(*(r->get_rhs()->begin()))) continue;
+             if (grammar_ptr->is_word(Grammar::rhs(rule)[0])) continue;
              #endif
 /*
 **********************************************************************
@@ -316,9 +970,11 @@ private:                                                   //    PRIVATE METHODS
                 // make an item from every rule and add it to the
                 // current chart cell, if it is not present for this
                 // cell yet
-                Item item2(*r, 0, item.to, item.to);
+                Item item2(rule, 0, index, index);
+                if (factored && !grammar_ptr->expect(by->rule, by->dot, by->features,
+                                                     rule, item2.features)) continue;
                 // if this item is not present yet, add it to predict_buffer
-                if(!chart.contains(item.to, item2) &&
+                if(!chart.contains(index, item2) &&
                    to_process.find(item2) == to_process.end() &&
                    predict_buffer.find(item2) == predict_buffer.end())
                 {
@@ -343,17 +999,55 @@ private:                                                   //    PRIVATE METHODS
 private:                                                   //     PRIVATE FIELDS
 ////////////////////////////////////////////////////////////////////////////////
     /// grammar to parse with
-    Grammar grammar;
-    /// pointer grammar
-    Grammar* grammar_ptr = nullptr;
+    const Grammar* grammar_ptr = nullptr;
     /// chart of \b Earley::EarleyItem<RULE>
     Chart chart;
-    /// set of POS-tags from \p grammar
-    const ISSet tags;
-    /// maps tags to words
-    const TagID_Words_Map pwm;
-    /// sign of life in case of long derivation
-    BUSY::Variant2 bar;
+    /// POS-tags and words; shared between copies
+    std::shared_ptr<const Lexicon> lexicon;
+    /// lexicon indices of the words of the sentence, by chart index
+    std::vector<unsigned> entries;
+    /// index of the next cell to process
+    short current;
+    /// whether the grammar closes its predictions for the tags of \b lexicon;
+    /// never if \b factored, as predict() needs the item expecting the rules
+    bool closed;
+    /// whether the grammar has been factored; items carry features then
+    bool factored;
+    /// whether the grammar has been optimized; it has chains of unary rules
+    bool optimized;
+    /// stamp of the cell in process(), unique for the lifetime of the parser
+    unsigned long stamp = 0;
+    /// stamp of the cell in which the rules of every category have been
+    /// predicted last, if \b closed
+    std::vector<unsigned long> predicted;
+    /// whether the busy indicator is shown
+    bool busy;
+    /// sign of life in case of long derivation, drawn by a render thread
+    BUSY::Indicator<BUSY::Variant2> indicator;
+    /// results of earlier sentences; nullptr if not used
+    ResultCache* cache = nullptr;
+    /// signature of the current sentence, if \b cache or \b prefixes is
+    /// used
+    Signature key;
+    /// whether the result of the current sentence has been cached
+    bool hit = false;
+    /// the cached result, if \b hit
+    bool hit_result = false;
+    /// whether the result is to be cached once the parse is done
+    bool pending = false;
+    /// processed cells of earlier sentences; nullptr if not used
+    Prefixes* prefixes = nullptr;
+    /// whether the current sentence has been started by begin() and is
+    /// pushed token by token; its cells are not stored in \b prefixes
+    bool streamed = false;
+    /// number of cells of the current sentence taken from \b prefixes
+    short resume_cells = 0;
+    /// cell processed ahead of \b current by expected_tags(); -1 if none
+    short frontier = -1;
+    /// whether \b spans is filled
+    bool index_spans = false;
+    /// spans of the complete items of the processed cells
+    Spans spans;
     /// buffers new items, so iterators don't get invalidated
     ItemSet predict_buffer;
     /// buffers new items, so iterators don't get invalidated
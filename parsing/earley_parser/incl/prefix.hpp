@@ -0,0 +1,230 @@
+/**
+ * @file prefix.hpp
+ * Chart cells shared between sentences. Once processed, chart cell i holds
+ * the same items for every sentence whose first i words are of the same
+ * ambiguity classes: cell 0 is the same for all sentences. \b PrefixCache
+ * keeps the processed cells of recent sentences in a trie over their class
+ * sequences, so that a parser can resume a sentence after the longest
+ * prefix it shares with one of them, rather than start from cell 0.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __PREFIX__HPP
+#define __PREFIX__HPP
+
+#include "declarations.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                 PrefixCache                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief trie of processed chart cells by the ambiguity classes of the
+ *        words before them, bounded in memory
+ * @details the node of depth i on the path of a signature holds cell i of
+ *          every sentence of that signature. Nodes are evicted least
+ *          recently used first; a node is used whenever a sentence passes
+ *          it, so it is always used more recently than the nodes below it
+ *          and only leaves are evicted. Cells are handed out as shared
+ *          pointers, so eviction never takes a cell from a parser that is
+ *          copying it. Any number of threads may use the cache at once; it
+ *          must only be used with one grammar and lexicon.
+ * @tparam ITEM chart item type, e.g. \b Earley::EarleyItem<GRAMMAR>
+ */
+template <typename ITEM>
+class PrefixCache
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// items of a processed chart cell
+typedef std::vector<ITEM>                                                  Cell;
+typedef std::shared_ptr<const Cell>                                     CellPtr;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// constructs cache holding cells of up to about @p max_bytes bytes
+    explicit PrefixCache(std::size_t max_bytes=std::size_t(256) << 20)
+    :max_bytes(max_bytes),
+    bytes(0),
+    reuse_count(0),
+    store_count(0)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief looks up the longest prefix of signature @p s with cells
+     * @param cells receives cells 0 to n-1 of the prefix, n being the
+     *        return value
+     * @return number of cells found; at most s.size()+1
+     */
+    std::size_t find(const Signature& s, std::vector<CellPtr>& cells)
+    {
+        cells.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!root.cell) return 0;
+        cells.push_back(root.cell);
+        Node* node = &root;
+        for (auto c = s.begin(); c != s.end(); ++c)
+        {
+            auto child = node->children.find(*c);
+            if (child == node->children.end()) break;
+            node = child->second.get();
+            cells.push_back(node->cell);
+        }
+        touch(node);
+        reuse_count.fetch_add(cells.size(), std::memory_order_relaxed);
+        return cells.size();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief stores the processed cell @p depth of a sentence of signature
+     *        @p s; dropped unless the cells before it are stored and
+     *        @p depth is at most s.size()
+     * @tparam SET container of \b ITEM
+     */
+    template <typename SET>
+    void insert(const Signature& s, std::size_t depth, const SET& cell)
+    {
+        if (depth > s.size()) return;
+        CellPtr items(new Cell(cell.begin(), cell.end()));
+        std::lock_guard<std::mutex> lock(mutex);
+        Node* node = &root;
+        if (depth == 0)
+        {
+            if (root.cell) return;
+            root.cell = items;
+            bytes += footprint(*items);
+            store_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (!root.cell) return;
+        for (std::size_t i = 0; i+1 < depth; ++i)
+        {
+            auto child = node->children.find(s[i]);
+            if (child == node->children.end()) return;
+            node = child->second.get();
+        }
+        if (node->children.count(s[depth-1]) > 0) return;
+        Node* leaf = new Node(node, s[depth-1], items);
+        node->children[leaf->label].reset(leaf);
+        leaf->used = order.insert(order.end(), leaf);
+        bytes += footprint(*items);
+        store_count.fetch_add(1, std::memory_order_relaxed);
+        touch(leaf);
+        evict();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of cells handed out by find()
+    std::uint64_t reused() const
+    {
+        return reuse_count.load(std::memory_order_relaxed);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of cells stored by insert()
+    std::uint64_t stored() const
+    {
+        return store_count.load(std::memory_order_relaxed);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns approximate number of bytes held
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bytes;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+    struct Node;
+/// nodes below the root, most recently used first
+typedef std::list<Node*>                                              NodeList;
+////////////////////////////////////////////////////////////////////////////////
+    /// node of the trie
+    struct Node
+    {
+        Node()
+        :parent(nullptr), label(0)
+        {
+        }
+
+        Node(Node* parent, std::uint32_t label, CellPtr cell)
+        :parent(parent), label(label), cell(cell)
+        {
+        }
+
+        Node* parent;                    ///< nullptr for the root
+        std::uint32_t label;             ///< class of the word before
+        CellPtr cell;                    ///< items of the cell
+        std::unordered_map<std::uint32_t, std::unique_ptr<Node>> children;
+        typename NodeList::iterator used;///< position in \b order
+    };
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    PrefixCache(const PrefixCache&);
+    PrefixCache& operator=(const PrefixCache&);
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns bytes held for @p cell and its node
+    static std::size_t footprint(const Cell& cell)
+    {
+        return sizeof(Node) + sizeof(Cell) + cell.size()*sizeof(ITEM);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// marks @p node and the nodes above it as most recently used, the
+    /// upper ones more recently than the lower ones
+    void touch(Node* node)
+    {
+        for (; node != &root; node = node->parent)
+        {
+            order.splice(order.begin(), order, node->used);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// removes least recently used leaves until at most \b max_bytes are held
+    void evict()
+    {
+        while (bytes > max_bytes && !order.empty())
+        {
+            Node* leaf = order.back();
+            order.pop_back();
+            bytes -= footprint(*leaf->cell);
+            // frees the leaf
+            leaf->parent->children.erase(leaf->label);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    const std::size_t max_bytes;                 ///< bound of \b bytes
+    mutable std::mutex mutex;                    ///< guards the trie
+    Node root;                                   ///< holds cell 0
+    NodeList order;                              ///< nodes by last use
+    std::size_t bytes;                           ///< bytes held
+    std::atomic<std::uint64_t> reuse_count;      ///< cells found
+    std::atomic<std::uint64_t> store_count;      ///< cells stored
+////////////////////////////////////////////////////////////////////////////////
+}; // PrefixCache
+
+} // Earley
+
+#endif // __PREFIX__HPP
@@ -0,0 +1,179 @@
+/**
+ * @file registry.hpp
+ * Grammars served side by side. \b GrammarRegistry holds a base grammar,
+ * the lexicon loaded for it and any number of named variants of the base
+ * grammar. The variants share the sections and the symbols of the base
+ * grammar, see \b CompiledGrammar::variant(), and all grammars share the
+ * lexicon, so a variant takes the memory of its rule changes only. Every
+ * grammar has a result cache of its own.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __REGISTRY__HPP
+#define __REGISTRY__HPP
+
+#include "declarations.hpp"
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "cache.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               GrammarRegistry                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief base grammar and its variants by name, with one lexicon
+ * @details the base grammar is named "". Variants are added and changed
+ *          before the registry is used for parsing; after that, nothing
+ *          changes but the result caches, so any number of parsers may
+ *          use the registry in parallel.
+ * @tparam PARSER parser type, e.g. \b Earley::EarleyParser<GRAMMAR>
+ */
+template <typename PARSER>
+class GrammarRegistry
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef PARSER                                                           Parser;
+typedef typename Parser::Grammar                                        Grammar;
+typedef typename Parser::Lexicon                                        Lexicon;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// registers @p grammar as the base grammar and @p lexicon as the lexicon
+    /// of all grammars; @p lexicon has been loaded for @p grammar
+    GrammarRegistry(std::unique_ptr<Grammar> grammar, std::shared_ptr<Lexicon> lexicon)
+    :shared_lexicon(lexicon)
+    {
+        Entry& base = grammars[sstr()];
+        base.grammar = std::move(grammar);
+        base.cache.reset(new ResultCache);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief registers a variant of the base grammar as @p name
+     * @return the variant, to be changed before it is used for parsing
+     * @throws std::invalid_argument if @p name is empty or taken
+     */
+    Grammar& add_variant(const sstr& name)
+    {
+        if (name.empty() || grammars.count(name) > 0)
+        {
+            throw std::invalid_argument("grammar name '"+name+"' is empty or taken");
+        }
+        std::shared_ptr<Grammar> variant = Grammar::variant(grammars[sstr()].grammar);
+        Entry& e = grammars[name];
+        e.grammar = variant;
+        e.cache.reset(new ResultCache);
+        return *variant;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if a grammar is registered as @p name
+    bool has(const sstr& name) const
+    {
+        return grammars.count(name) > 0;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief grammar @p name; the base grammar for ""
+     * @throws std::out_of_range if there is no such grammar
+     */
+    Grammar& grammar(const sstr& name="") const
+    {
+        return *entry(name).grammar;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief result cache of grammar @p name
+     * @throws std::out_of_range if there is no such grammar
+     */
+    ResultCache& cache(const sstr& name="") const
+    {
+        return *entry(name).cache;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the lexicon of all grammars
+    const std::shared_ptr<Lexicon>& lexicon() const
+    {
+        return shared_lexicon;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns names of the grammars in alphabetical order, "" first
+    std::vector<sstr> names() const
+    {
+        std::vector<sstr> n;
+        for (auto g = grammars.begin(); g != grammars.end(); ++g) n.push_back(g->first);
+        return n;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns approximate number of bytes the variants hold for their
+    /// changes, see \b CompiledGrammar::variant_size()
+    std::size_t variant_size() const
+    {
+        std::size_t bytes = 0;
+        for (auto g = grammars.begin(); g != grammars.end(); ++g)
+        {
+            bytes += g->second.grammar->variant_size();
+        }
+        return bytes;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief a new parser on grammar @p name, using its result cache
+     * @throws std::out_of_range if there is no such grammar
+     */
+    std::unique_ptr<Parser> make_parser(const sstr& name="") const
+    {
+        const Entry& e = entry(name);
+        std::unique_ptr<Parser> p(new Parser(*e.grammar, shared_lexicon));
+        p->set_cache(e.cache.get());
+        return p;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+    /// registered grammar
+    struct Entry
+    {
+        std::shared_ptr<Grammar> grammar;
+        std::unique_ptr<ResultCache> cache;      ///< results on \b grammar
+    };
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    GrammarRegistry(const GrammarRegistry&);
+    GrammarRegistry& operator=(const GrammarRegistry&);
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the entry of grammar @p name
+    /// @throws std::out_of_range if there is no such grammar
+    const Entry& entry(const sstr& name) const
+    {
+        auto e = grammars.find(name);
+        if (e == grammars.end()) throw std::out_of_range("no grammar named '"+name+"'");
+        return e->second;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::shared_ptr<Lexicon> shared_lexicon;     ///< lexicon of all grammars
+    std::map<sstr, Entry> grammars;              ///< grammars by name
+////////////////////////////////////////////////////////////////////////////////
+}; // GrammarRegistry
+
+} // Earley
+
+#endif // __REGISTRY__HPP
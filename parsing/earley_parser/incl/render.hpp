@@ -0,0 +1,162 @@
+/**
+ * @file render.hpp
+ * Background drawing of indicators. A loop that wants to show its progress
+ * only counts its steps in a \b Counter; a \b Renderer thread samples the
+ * counter at a fixed frame rate and draws the indicator. Nothing is drawn
+ * and no thread is started, if stdout is not a terminal.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __RENDER__HPP
+#define __RENDER__HPP
+
+#include "declarations.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "helper.hpp"
+
+namespace RENDER
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                   Counter                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief progress counter written by one thread and read by another
+ * @details there is only one writer, so add() is a relaxed load and store
+ *          rather than a read-modify-write: as cheap as a plain increment
+ */
+class Counter
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    Counter()
+    :count(0)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// adds @p n; must only be called by one thread
+    void add(unsigned long n=1)
+    {
+        count.store(count.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the count
+    unsigned long get() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::atomic<unsigned long> count;
+////////////////////////////////////////////////////////////////////////////////
+}; // Counter
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  Renderer                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief thread calling a frame function at a fixed rate
+ * @details frames are drawn under a lock, which the owner takes through
+ *          locked() to draw from its own thread, e.g. to blank the line
+ *          before it writes output
+ */
+class Renderer
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// constructs renderer drawing @p hz frames per second once started
+    explicit Renderer(unsigned hz=10)
+    :period(1000/(hz > 0 ? hz : 1)),
+    stopping(false)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// stops the thread
+    ~Renderer()
+    {
+        stop();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the thread is running
+    bool running() const
+    {
+        return thread.joinable();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief starts the thread calling @p frame, unless it runs already or
+     *        stdout is not a terminal
+     */
+    void start(std::function<void()> frame)
+    {
+        if (running() || !helper::stdout_is_terminal()) return;
+        stopping = false;
+        this->frame = frame;
+        thread = std::thread([this]()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!wake.wait_for(lock, period, [this]() { return stopping; }))
+            {
+                this->frame();
+            }
+        });
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// stops the thread after its current frame
+    void stop()
+    {
+        if (!running()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// calls @p f while no frame is drawn
+    template <typename F>
+    void locked(F f)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        f();
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    Renderer(const Renderer&);
+    Renderer& operator=(const Renderer&);
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    std::chrono::milliseconds period;   ///< time between frames
+    std::function<void()> frame;        ///< draws a frame
+    std::thread thread;                 ///< calls \b frame
+    std::mutex mutex;                   ///< held while a frame is drawn
+    std::condition_variable wake;       ///< wakes the thread to stop
+    bool stopping;                      ///< whether the thread is to stop
+////////////////////////////////////////////////////////////////////////////////
+}; // Renderer
+
+} // RENDER
+
+#endif // __RENDER__HPP
@@ -0,0 +1,243 @@
+/**
+ * @file snapshot.hpp
+ * Grammar snapshots for long running processes. A \b Snapshot bundles a
+ * grammar and its variants with their tags and words; it is not changed
+ * once published.
+ * \b SnapshotStore holds the current snapshot and replaces it on reload in
+ * the manner of read-copy-update: the new snapshot is built on the side and
+ * then published with an atomic pointer swap. Parses that started on the
+ * old snapshot finish on it, new parses get the new one, and the old one is
+ * freed as soon as its last reader lets go of it.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __SNAPSHOT__HPP
+#define __SNAPSHOT__HPP
+
+#include "declarations.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "cache.hpp"
+#include "compiled.hpp"
+#include "registry.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  Snapshot                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief grammar, its variants, tags and words loaded together
+ * @details nothing changes after loading but the result caches, which are
+ *          safe to share, so any number of parsers may use a snapshot in
+ *          parallel.
+ * @tparam PARSER parser type, e.g. \b Earley::EarleyParser<GRAMMAR>
+ */
+template <typename PARSER>
+struct Snapshot
+{
+////////////////////////////////////////////////////////////////////////////////
+typedef PARSER                                                           Parser;
+typedef typename Parser::Grammar                                        Grammar;
+typedef typename Parser::Lexicon                                        Lexicon;
+typedef GrammarRegistry<PARSER>                                        Registry;
+/// files of rule edits by grammar name; "" names the grammar itself
+typedef std::vector<std::pair<sstr, sstr>>                                Edits;
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief loads grammar @p grammar, tags @p tags and words @p words.
+     *        The grammar and the words may be text files or images. The
+     *        rule edits of @p edits named "" change the grammar; each other
+     *        name gets a variant of the grammar with the edits of that name.
+     * @param generation number of reloads before this snapshot
+     * @throws LoadError if a file cannot be opened or is malformed
+     */
+    Snapshot(const sstr& grammar, const sstr& tags, const sstr& words,
+             const Edits& edits=Edits(), unsigned long generation=0)
+    :generation(generation)
+    {
+        std::ifstream tagfile(tags);
+        if (!tagfile.is_open()) throw LoadError("failed to open '"+tags+"'");
+        std::unique_ptr<Grammar> g = Grammar::load(grammar);
+        // the grammar is changed before tags and words are translated, which
+        // keeps them apart from the compiled symbols
+        for (auto e = edits.begin(); e != edits.end(); ++e)
+        {
+            if (e->first.empty()) g->edit(e->second);
+        }
+        std::shared_ptr<Lexicon> lexicon = std::make_shared<Lexicon>();
+        lexicon->load_tags(tagfile, *g);
+        lexicon->load_words(words, *g);
+        grammars.reset(new Registry(std::move(g), lexicon));
+        for (auto e = edits.begin(); e != edits.end(); ++e)
+        {
+            if (e->first.empty()) continue;
+            Grammar& v = grammars->has(e->first) ? grammars->grammar(e->first)
+                                                 : grammars->add_variant(e->first);
+            v.edit(e->second);
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief a new parser on grammar @p name of this snapshot, without busy
+     *        indicator, using the result cache of that grammar
+     * @throws std::out_of_range if there is no such grammar
+     */
+    std::unique_ptr<Parser> make_parser(const sstr& name="")
+    {
+        std::unique_ptr<Parser> p = grammars->make_parser(name);
+        p->set_busy_indicator(false);
+        return p;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    std::unique_ptr<Registry> grammars;        ///< grammar and its variants
+    const unsigned long generation;            ///< 0 for the first snapshot
+////////////////////////////////////////////////////////////////////////////////
+}; // Snapshot
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                SnapshotStore                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief publishes the current \b Snapshot and replaces it on reload
+ * @details readers call current() and hold on to the returned pointer for
+ *          the duration of a parse. This never blocks: the pointer is read
+ *          atomically. reload() waits until the snapshot it replaced last
+ *          time has been freed before it loads a new one, so at most two
+ *          snapshots are in memory at any time; the last reader of a
+ *          snapshot wakes it up by freeing it.
+ * @tparam PARSER parser type, e.g. \b Earley::EarleyParser<GRAMMAR>
+ */
+template <typename PARSER>
+class SnapshotStore
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef Earley::Snapshot<PARSER>                                       Snapshot;
+typedef std::shared_ptr<Snapshot>                                   SnapshotPtr;
+typedef typename Snapshot::Edits                                          Edits;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief loads the first snapshot from grammar @p grammar, tags @p tags,
+     *        words @p words and rule edits @p edits, see \b Snapshot. The
+     *        same files are read again on reload.
+     * @throws LoadError if the files cannot be loaded
+     */
+    SnapshotStore(const sstr& grammar, const sstr& tags, const sstr& words,
+                  const Edits& edits=Edits())
+    :grammar(grammar),
+    tags(tags),
+    words(words),
+    edits(edits),
+    census(std::make_shared<Census>()),
+    snapshot(load(0))
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the current snapshot
+    SnapshotPtr current() const
+    {
+        return std::atomic_load(&snapshot);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief loads the files again and publishes the result as the current
+     *        snapshot. Parses on the old snapshot are not disturbed. Only
+     *        one reload runs at a time.
+     * @return the new snapshot
+     * @throws LoadError if the files cannot be loaded; the current snapshot
+     *         stays in place then
+     */
+    SnapshotPtr reload()
+    {
+        std::lock_guard<std::mutex> lock(reloading);
+        // the snapshot replaced last time must be gone, or there would be
+        // three of them after this one has been loaded
+        {
+            std::unique_lock<std::mutex> count(census->mutex);
+            census->freed.wait(count, [this]{ return census->alive < 2; });
+        }
+        SnapshotPtr next = load(current()->generation+1);
+        std::atomic_store(&snapshot, next);
+        return next;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if a snapshot replaced by reload() is still in use
+    bool retiring() const
+    {
+        std::lock_guard<std::mutex> count(census->mutex);
+        return census->alive > 1;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+    /// number of snapshots in memory; signalled whenever one is freed
+    struct Census
+    {
+        std::mutex mutex;
+        std::condition_variable freed;
+        unsigned alive = 0;
+    };
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief loads the files as snapshot @p generation, which is counted in
+     *        \b census until its last reader lets go of it
+     * @throws LoadError if the files cannot be loaded
+     */
+    SnapshotPtr load(unsigned long generation)
+    {
+        std::unique_ptr<Snapshot> s(new Snapshot(grammar, tags, words, edits, generation));
+        std::shared_ptr<Census> c = census;
+        {
+            std::lock_guard<std::mutex> count(c->mutex);
+            ++c->alive;
+        }
+        // the census outlives the store as long as a snapshot does
+        return SnapshotPtr(s.release(), [c](Snapshot* freed)
+        {
+            delete freed;
+            {
+                std::lock_guard<std::mutex> count(c->mutex);
+                --c->alive;
+            }
+            c->freed.notify_all();
+        });
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    const sstr grammar;          ///< grammar file
+    const sstr tags;             ///< tags file
+    const sstr words;            ///< words file
+    const Edits edits;           ///< rule edits files
+    std::shared_ptr<Census> census; ///< snapshots in memory
+    SnapshotPtr snapshot;        ///< current snapshot; accessed atomically
+    std::mutex reloading;        ///< held during reload()
+////////////////////////////////////////////////////////////////////////////////
+}; // SnapshotStore
+
+} // Earley
+
+#endif // __SNAPSHOT__HPP
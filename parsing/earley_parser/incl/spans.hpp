@@ -0,0 +1,216 @@
+/**
+ * @file spans.hpp
+ * Index of the constituents found by a parse. Every complete item of the
+ * chart states that its category spans the words from its left to its
+ * right border. \b SpanIndex collects these spans cell by cell, as the
+ * parser finishes the cells, and answers which categories span i..j and
+ * which spans a category has without walking the chart.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __SPANS__HPP
+#define __SPANS__HPP
+
+#include "declarations.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  SpanIndex                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief categories by span and spans by category
+ * @details the categories of all spans ending in cells 0 to j are stored in
+ *          one array, ordered by right border, left border and category,
+ *          with the first position of every span (i, j) in a triangular
+ *          table. The spans of every category are kept in the order their
+ *          right borders have been added. Both queries return ranges into
+ *          these arrays, which stay valid until the index is changed.
+ * @tparam IS internal symbol type of the categories
+ */
+template <typename IS>
+class SpanIndex
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+/// left and right border of a span
+typedef std::pair<short, short>                                            Span;
+/// sorted categories of a span
+typedef std::pair<const IS*, const IS*>                           CategoryRange;
+/// spans of a category, ordered by right border
+typedef std::pair<const Span*, const Span*>                           SpanRange;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    SpanIndex()
+    :first(1, 0)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of cells indexed
+    short cells() const
+    {
+        return indexed;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief indexes the complete items of the processed cell @p j of
+     *        @p chart; nothing happens unless cells 0 to j-1 and not j have
+     *        been indexed
+     * @details in a grammar optimized by \b CompiledGrammar::optimize(),
+     *          the symbols of shared prefixes span no words, and a category
+     *          above a complete one in a collapsed chain of unary rules
+     *          spans its words as well, if an item at the left border
+     *          expects it, directly or through such a chain
+     * @tparam CHART chart type, e.g. \b Earley::EarleyChart<PARSER>
+     * @tparam GRAMMAR grammar of @p chart
+     */
+    template <typename CHART, typename GRAMMAR>
+    void add_cell(short j, const CHART& chart, const GRAMMAR& g)
+    {
+        if (j != indexed) return;
+        std::vector<std::pair<short, IS>> found;
+        // symbols expected in the cells of left borders, as far as needed
+        std::unordered_map<short, std::vector<IS>> expected;
+        for (auto item = chart[j].begin(); item != chart[j].end(); ++item)
+        {
+            if (!item->complete() || g.is_prefix(item->get_lhs())) continue;
+            found.push_back(std::make_pair(item->from, item->get_lhs()));
+            auto heads = g.chain_heads(item->get_lhs());
+            if (heads.first == heads.second) continue;
+            auto e = expected.find(item->from);
+            if (e == expected.end())
+            {
+                e = expected.insert(std::make_pair(item->from, std::vector<IS>())).first;
+                const auto& cell = chart[item->from];
+                for (auto i = cell.begin(); i != cell.end(); ++i)
+                {
+                    if (!i->complete()) e->second.push_back(i->next());
+                }
+                std::sort(e->second.begin(), e->second.end());
+            }
+            for (auto h = heads.first; h != heads.second; ++h)
+            {
+                if (expects(e->second, g, *h)) found.push_back(std::make_pair(item->from, *h));
+            }
+        }
+        // items of different rules may span the same words with one category
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+
+        auto f = found.begin();
+        for (short i = 0; i <= j; ++i)
+        {
+            for (; f != found.end() && f->first == i; ++f)
+            {
+                categories.push_back(f->second);
+                by_category[f->second].push_back(Span(i, j));
+            }
+            first.push_back(categories.size());
+        }
+        ++indexed;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// forgets the spans ending after cell @p j-1, keeping @p j cells
+    void truncate(short j)
+    {
+        if (j >= indexed) return;
+        std::size_t kept = first[triangle(j)];
+        first.resize(triangle(j)+1);
+        categories.resize(kept);
+        for (auto c = by_category.begin(); c != by_category.end(); ++c)
+        {
+            std::vector<Span>& spans = c->second;
+            while (!spans.empty() && spans.back().second >= j) spans.pop_back();
+        }
+        indexed = j;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// forgets all spans; keeps the memory for the next sentence
+    void clear()
+    {
+        truncate(0);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief categories spanning the words from @p i to @p j-1, i.e. those
+     *        of the complete items from @p i in cell @p j
+     * @return sorted categories; empty if the span has not been indexed
+     */
+    CategoryRange categories_of(short i, short j) const
+    {
+        if (i < 0 || j >= indexed || i > j) return CategoryRange(nullptr, nullptr);
+        const IS* c = categories.data();
+        std::size_t t = triangle(j)+i;
+        return CategoryRange(c+first[t], c+first[t+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if category @p category spans the words from @p i to
+    /// @p j-1
+    bool spans_category(short i, short j, const IS& category) const
+    {
+        CategoryRange r = categories_of(i, j);
+        return std::binary_search(r.first, r.second, category);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the spans of category @p category, ordered by right border
+    SpanRange spans_of(const IS& category) const
+    {
+        auto c = by_category.find(category);
+        if (c == by_category.end() || c->second.empty()) return SpanRange(nullptr, nullptr);
+        const Span* s = c->second.data();
+        return SpanRange(s, s+c->second.size());
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if the sorted symbols @p expected hold @p category or
+    /// a category above it in a chain of unary rules of @p g
+    template <typename GRAMMAR>
+    static bool expects(const std::vector<IS>& expected, const GRAMMAR& g, IS category)
+    {
+        if (std::binary_search(expected.begin(), expected.end(), category)) return true;
+        auto heads = g.chain_heads(category);
+        for (auto h = heads.first; h != heads.second; ++h)
+        {
+            if (std::binary_search(expected.begin(), expected.end(), *h)) return true;
+        }
+        return false;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns position of the spans ending in cell @p j in \b first
+    static std::size_t triangle(short j)
+    {
+        return std::size_t(j)*(j+1)/2;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    short indexed = 0;                   ///< number of cells indexed
+    std::vector<IS> categories;          ///< categories of all spans
+    /// position of the categories of span (i, j) in \b categories, at
+    /// triangle(j)+i; one past the last span at the end
+    std::vector<std::uint32_t> first;
+    /// spans of every category
+    std::unordered_map<IS, std::vector<Span>> by_category;
+////////////////////////////////////////////////////////////////////////////////
+}; // SpanIndex
+
+} // Earley
+
+#endif // __SPANS__HPP
@@ -0,0 +1,578 @@
+/**
+ * @file static.hpp
+ * Grammar built into the binary. generate_grammar() writes the tables of
+ * a \b CompiledGrammar as constexpr arrays into a C++ header, together
+ * with two tables derived from the rules and the tags:
+ *
+ *     predictions  for every category, the categories predicted from it,
+ *                  directly or through the first symbol of a predicted
+ *                  rule, itself included
+ *     first        for every symbol, the tags it can begin with
+ *
+ * The header defines the tables as \b Generated::<name>::Tables, and
+ * \b StaticGrammar parses on them, so a binary compiled with the header
+ * has its grammar ready without reading a single rule. The parser uses
+ * the prediction closures to predict all items of a cell at once.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __STATIC__HPP
+#define __STATIC__HPP
+
+#include "declarations.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "compiled.hpp"
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                StaticGrammar                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief read-only grammar on tables known at compile time
+ * @details the interface is that of \b CompiledGrammar, but the tables are
+ *          static members of @p TABLES, so every access to a rule record
+ *          is an access to a constant array. Symbols not known to the
+ *          grammar, such as words, can still be translated; they are kept
+ *          apart from the compiled symbols.
+ * @tparam TABLES tables written by generate_grammar()
+ */
+template <typename TABLES>
+class StaticGrammar
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef TABLES                                                           Tables;
+typedef long                                                                 IS;
+typedef sstr                                                                 ES;
+typedef std::vector<IS>                                                   ISVec;
+typedef std::vector<ES>                                                   ESVec;
+typedef std::set<IS>                                                      ISSET;
+/// symbol type within rule records
+typedef std::int32_t                                                        Sym;
+/// range of symbols or rule offsets
+typedef std::pair<const Sym*, const Sym*>                              SymRange;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    StaticGrammar()
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief @returns the grammar; for the drivers, which load grammars
+     *        by path
+     * @throws LoadError if @p path is not empty, as there is nothing to
+     *         load
+     */
+    static std::unique_ptr<StaticGrammar> load(const sstr& path, unsigned=0)
+    {
+        if (path.size() > 0)
+        {
+            throw LoadError("the grammar is built in; '"+path+"' is not loaded");
+        }
+        return std::unique_ptr<StaticGrammar>(new StaticGrammar);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief the rules of a built-in grammar cannot be changed
+     * @throws LoadError always
+     */
+    RuleEdits edit(const sstr& path)
+    {
+        throw LoadError("the grammar is built in; '"+path+"' cannot change its rules");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief a built-in grammar has no variants
+     * @throws LoadError always
+     */
+    static std::unique_ptr<StaticGrammar> variant(const std::shared_ptr<StaticGrammar>&)
+    {
+        throw LoadError("the grammar is built in and has no variants");
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns 0, as a built-in grammar has no variants
+    std::size_t variant_size() const
+    {
+        return 0;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns false, as a built-in grammar is not factored; the parser
+    /// calls none of scan_features(), agree(), expect() and unfactor() then
+    bool is_factored() const
+    {
+        return false;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    bool scan_features(IS, const ISVec&, std::uint16_t&) const
+    {
+        return false;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    bool agree(const Sym*, unsigned, std::uint16_t&, const Sym*, std::uint16_t) const
+    {
+        return false;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    bool expect(const Sym*, unsigned, std::uint16_t, const Sym*, std::uint16_t&) const
+    {
+        return false;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    void unfactor(const Sym*, unsigned, std::uint16_t, ISVec&) const
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns false, as a built-in grammar is not optimized
+    bool is_optimized() const
+    {
+        return false;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns an empty range, as a built-in grammar is not optimized and
+    /// has no collapsed chains of unary rules; nor has chain_tails()
+    std::pair<const IS*, const IS*> chain_heads(IS) const
+    {
+        return std::pair<const IS*, const IS*>(nullptr, nullptr);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    std::pair<const IS*, const IS*> chain_tails(IS) const
+    {
+        return std::pair<const IS*, const IS*>(nullptr, nullptr);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns false, as a built-in grammar has no symbols for prefixes
+    bool is_prefix(IS) const
+    {
+        return false;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns @p rule, as the rules of a built-in grammar are those written
+    const Sym* original(const Sym* rule, unsigned&) const
+    {
+        return rule;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of rules, without the start rule
+    std::size_t rule_count() const
+    {
+        return Tables::rule_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of compiled symbols
+    std::size_t symbol_count() const
+    {
+        return Tables::symbol_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns record of the start rule
+    const Sym* start_rule() const
+    {
+        return Tables::rules;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns begin and end of the offsets of the rules with LHS @p lhs;
+    /// the records are found with rule()
+    std::pair<const std::uint32_t*, const std::uint32_t*> rules_for(IS lhs) const
+    {
+        if (lhs < 0 || (std::size_t)lhs >= Tables::symbol_count)
+        {
+            return std::make_pair(Tables::lhs_rules, Tables::lhs_rules);
+        }
+        return std::make_pair(Tables::lhs_rules + Tables::lhs_index[lhs],
+                              Tables::lhs_rules + Tables::lhs_index[lhs+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns rule record at @p offset
+    const Sym* rule(std::uint32_t offset) const
+    {
+        return Tables::rules + offset;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns record of the lexical rule for tag @p tag
+    /// @pre @p tag is a compiled symbol
+    const Sym* lexical(IS tag) const
+    {
+        return Tables::lexical + 3*tag;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if @p r is the record of a lexical rule
+    bool is_lexical(const Sym* r) const
+    {
+        return r >= Tables::lexical && r < Tables::lexical + 3*Tables::symbol_count;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns LHS of rule record @p r
+    static IS lhs(const Sym* r) { return r[0]; }
+    /// @returns RHS length of rule record @p r
+    static unsigned length(const Sym* r) { return r[1]; }
+    /// @returns RHS of rule record @p r
+    static const Sym* rhs(const Sym* r) { return r+2; }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief @returns true, if the prediction closures hold for the tags of
+     *        @p lexicon, i.e. its tags among the compiled symbols are those
+     *        the tables were generated with. Never with SOVERLOAD, which
+     *        predicts from tags as well.
+     */
+    template <typename LEXICON>
+    bool closes_predictions(const LEXICON& lexicon) const
+    {
+        #if SOVERLOAD
+        (void)lexicon;
+        return false;
+        #else
+        for (std::size_t s = 0; s < Tables::symbol_count; ++s)
+        {
+            if (lexicon.is_tag(s) != (Tables::tags[s] != 0)) return false;
+        }
+        return true;
+        #endif
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the categories predicted from category @p lhs, itself
+    /// included; empty for tags
+    SymRange predictions(IS lhs) const
+    {
+        return range(Tables::predict_index, Tables::predictions, lhs);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns the tags symbol @p s can begin with, in ascending order
+    SymRange first(IS s) const
+    {
+        return range(Tables::first_index, Tables::first, s);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief looks up the symbol of @p n chars at @p p
+     * @return its ID or -1
+     */
+    IS find(const char* p, std::size_t n) const
+    {
+        typedef CompiledGrammar<IS, ES> Compiled;
+        std::uint32_t mask = Tables::hash_size-1;
+        for (std::uint32_t i = Compiled::image_hash(p, n) & mask;; i = (i+1) & mask)
+        {
+            std::uint32_t s = Tables::hash[i];
+            if (s == Compiled::empty()) break;
+            if (Tables::name_offsets[s+1]-Tables::name_offsets[s] == n &&
+                std::memcmp(Tables::names+Tables::name_offsets[s], p, n) == 0) return s;
+        }
+        auto e = extra_ids.find(ES(p, n));
+        return e == extra_ids.end() ? -1 : e->second;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief translates @p es into an \b IS. Symbols unknown to the grammar
+     *        get a new ID.
+     */
+    IS translate(const ES& es)
+    {
+        IS is = find(es.data(), es.size());
+        if (is != -1) return is;
+        is = Tables::symbol_count + extra.size();
+        extra.push_back(es);
+        extra_ids.insert(std::make_pair(es, is));
+        return is;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// translates @p is into an \b ES; @returns "<$>" for unknown IDs
+    ES translate(const IS& is) const
+    {
+        if (is >= 0 && (std::size_t)is < Tables::symbol_count)
+        {
+            return ES(Tables::names+Tables::name_offsets[is],
+                      Tables::names+Tables::name_offsets[is+1]);
+        }
+        std::size_t e = is - Tables::symbol_count;
+        if (is >= 0 && e < extra.size()) return extra[e];
+        return "<$>";
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// marks the symbols in @p lexicon as words
+    void inject_lexicon(const ISSET& lexicon)
+    {
+        for (auto w = lexicon.begin(); w != lexicon.end(); ++w)
+        {
+            if (*w < 0) continue;
+            if ((std::size_t)*w >= words.size()) words.resize(*w+1, false);
+            words[*w] = true;
+        }
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns true, if @p is has been marked as a word
+    bool is_word(const IS& is) const
+    {
+        return is >= 0 && (std::size_t)is < words.size() && words[is];
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// sends the rules in text form to @p o, one per line
+    friend sost& operator<<(sost& o, const StaticGrammar& g)
+    {
+        for (std::size_t s = 0; s < g.symbol_count(); ++s)
+        {
+            auto range = g.rules_for(s);
+            for (auto r = range.first; r != range.second; ++r)
+            {
+                const Sym* rule = g.rule(*r);
+                o << g.translate(lhs(rule)) << " -->";
+                for (unsigned i = 0; i < length(rule); ++i)
+                {
+                    o << " " << g.translate(rhs(rule)[i]);
+                }
+                o << "\n";
+            }
+        }
+        return o;
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //    PRIVATE METHODS
+////////////////////////////////////////////////////////////////////////////////
+    StaticGrammar(const StaticGrammar&);
+    StaticGrammar& operator=(const StaticGrammar&);
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns entries of symbol @p s in a table indexed by @p index
+    static SymRange range(const std::uint32_t* index, const Sym* table, IS s)
+    {
+        if (s < 0 || (std::size_t)s >= Tables::symbol_count)
+        {
+            return SymRange(table, table);
+        }
+        return SymRange(table + index[s], table + index[s+1]);
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    ESVec extra;                         ///< symbols added by translate()
+    std::unordered_map<ES, IS> extra_ids;///< IDs of \b extra
+    std::vector<bool> words;             ///< symbols marked as words
+////////////////////////////////////////////////////////////////////////////////
+}; // StaticGrammar
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                               generate_grammar                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+namespace generator
+{
+    /// sends @p v as the body of an array initialiser to @p o
+    inline void array(sost& o, const std::vector<long long>& v)
+    {
+        for (std::size_t i = 0; i < v.size(); ++i)
+        {
+            o << (i % 16 == 0 ? "\n        " : " ") << v[i];
+            if (i+1 < v.size()) o << ',';
+        }
+        o << "\n    ";
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// sends @p s as a string literal to @p o; every char that might not
+    /// survive as it is, trigraphs included, is escaped
+    inline void literal(sost& o, const sstr& s)
+    {
+        o << '"';
+        for (auto c = s.begin(); c != s.end(); ++c)
+        {
+            unsigned char u = *c;
+            if (u == '"' || u == '\\' || u == '?') o << '\\' << *c;
+            else if (u < 32 || u > 126)
+            {
+                const char* digits = "01234567";
+                o << '\\' << digits[u >> 6] << digits[(u >> 3) & 7] << digits[u & 7];
+            }
+            else o << *c;
+        }
+        o << '"';
+    }
+} // generator
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief writes the tables of grammar @p g as C++ header to @p o
+ * @details the header defines the tables in namespace
+ *          \b Earley::Generated::<name>, the grammar on them as \b Grammar
+ *          and the parser as \b Parser. It is to be included after this
+ *          file and parser.hpp.
+ * @param g grammar to write
+ * @param lexicon tags of the grammar; the prediction closures stop at them
+ * @param name name of the namespace; must be a C++ identifier
+ * @param source files the grammar has been generated from, for the header
+ *        comment
+ * @param o stream to send to
+ */
+template <typename COMPILED, typename LEXICON>
+void generate_grammar(const COMPILED& g, const LEXICON& lexicon, const sstr& name,
+                      const sstr& source, sost& o)
+{
+    typedef typename COMPILED::Sym Sym;
+    std::size_t n = g.symbol_count();
+
+    // names and hash table, as in the image
+    sstr names;
+    std::vector<std::uint32_t> offsets;
+    for (std::size_t s = 0; s < n; ++s)
+    {
+        offsets.push_back(names.size());
+        names += g.translate((typename COMPILED::IS)s);
+    }
+    offsets.push_back(names.size());
+    std::uint32_t hash_size = 16;
+    while (hash_size < 2*n) hash_size <<= 1;
+    std::vector<std::uint32_t> hash(hash_size, COMPILED::empty());
+    for (std::size_t s = 0; s < n; ++s)
+    {
+        if (offsets[s+1] == offsets[s]) continue;
+        std::uint32_t i = COMPILED::image_hash(names.data()+offsets[s], offsets[s+1]-offsets[s]) & (hash_size-1);
+        while (hash[i] != COMPILED::empty()) i = (i+1) & (hash_size-1);
+        hash[i] = s;
+    }
+
+    // rule records grouped by LHS, start rule first, and lexical rules
+    const Sym* start = g.start_rule();
+    std::vector<Sym> rules(start, start+2+COMPILED::length(start));
+    std::vector<std::uint32_t> lhs_index(1, 0), lhs_rules;
+    std::vector<Sym> lexical;
+    std::vector<int> tags;
+    for (std::size_t s = 0; s < n; ++s)
+    {
+        auto range = g.rules_for(s);
+        for (auto r = range.first; r != range.second; ++r)
+        {
+            const Sym* rule = g.rule(*r);
+            lhs_rules.push_back(rules.size());
+            rules.insert(rules.end(), rule, rule+2+COMPILED::length(rule));
+        }
+        lhs_index.push_back(lhs_rules.size());
+        lexical.push_back(s);
+        lexical.push_back(1);
+        lexical.push_back(s);
+        tags.push_back(lexicon.is_tag(s) ? 1 : 0);
+    }
+
+    // closure of the predictions of every category, and the tags every
+    // symbol can begin with
+    std::vector<std::uint32_t> predict_index(1, 0), first_index(1, 0);
+    std::vector<Sym> predictions, first;
+    std::vector<unsigned> seen(n, 0);
+    for (std::size_t s = 0; s < n; ++s)
+    {
+        std::set<Sym> tags_first;
+        if (tags[s]) tags_first.insert(s);
+        else
+        {
+            std::vector<Sym> todo(1, s);
+            seen[s] = s+1;
+            while (todo.size() > 0)
+            {
+                Sym c = todo.back();
+                todo.pop_back();
+                predictions.push_back(c);
+                auto range = g.rules_for(c);
+                for (auto r = range.first; r != range.second; ++r)
+                {
+                    Sym f = COMPILED::rhs(g.rule(*r))[0];
+                    if (f < 0 || (std::size_t)f >= n) continue;
+                    if (tags[f]) tags_first.insert(f);
+                    else if (seen[f] != s+1)
+                    {
+                        seen[f] = s+1;
+                        todo.push_back(f);
+                    }
+                }
+            }
+        }
+        predict_index.push_back(predictions.size());
+        first.insert(first.end(), tags_first.begin(), tags_first.end());
+        first_index.push_back(first.size());
+    }
+    // no array may be empty
+    lhs_rules.push_back(0);
+    predictions.push_back(0);
+    first.push_back(0);
+
+    o << "/**\n"
+      << " * @file " << name << "_grammar.hpp\n"
+      << " * Grammar '" << name << "', generated from " << source << ".\n"
+      << " * " << lhs_rules.size()-1 << " rules over " << n << " symbols. Do not edit;\n"
+      << " * include after static.hpp and parser.hpp.\n"
+      << " */\n\n"
+      << "#ifndef __GENERATED_" << name << "__HPP\n"
+      << "#define __GENERATED_" << name << "__HPP\n\n"
+      << "namespace Earley\n{\nnamespace Generated\n{\nnamespace " << name << "\n{\n"
+      << "/// tables of the grammar; a template, so the header can be included\n"
+      << "/// in more than one translation unit\n"
+      << "template <typename T=void>\n"
+      << "struct Tables\n{\n"
+      << "    static constexpr std::uint32_t symbol_count = " << n << ";\n"
+      << "    static constexpr std::uint32_t rule_count = " << lhs_rules.size()-1 << ";\n"
+      << "    static constexpr std::uint32_t hash_size = " << hash_size << ";\n"
+      << "    static constexpr char names[" << names.size()+1 << "] =";
+    for (std::size_t s = 0; s < n; ++s)
+    {
+        o << "\n        ";
+        generator::literal(o, names.substr(offsets[s], offsets[s+1]-offsets[s]));
+    }
+    if (n == 0) o << " \"\"";
+    o << ";\n";
+
+    struct Table { const char* type; const char* name; std::vector<long long> values; };
+    std::vector<Table> tables =
+    {
+        { "std::uint32_t", "name_offsets", std::vector<long long>(offsets.begin(), offsets.end()) },
+        { "std::uint32_t", "hash", std::vector<long long>(hash.begin(), hash.end()) },
+        { "std::int32_t", "rules", std::vector<long long>(rules.begin(), rules.end()) },
+        { "std::uint32_t", "lhs_index", std::vector<long long>(lhs_index.begin(), lhs_index.end()) },
+        { "std::uint32_t", "lhs_rules", std::vector<long long>(lhs_rules.begin(), lhs_rules.end()) },
+        { "std::int32_t", "lexical", std::vector<long long>(lexical.begin(), lexical.end()) },
+        { "std::uint8_t", "tags", std::vector<long long>(tags.begin(), tags.end()) },
+        { "std::uint32_t", "predict_index", std::vector<long long>(predict_index.begin(), predict_index.end()) },
+        { "std::int32_t", "predictions", std::vector<long long>(predictions.begin(), predictions.end()) },
+        { "std::uint32_t", "first_index", std::vector<long long>(first_index.begin(), first_index.end()) },
+        { "std::int32_t", "first", std::vector<long long>(first.begin(), first.end()) }
+    };
+    for (auto t = tables.begin(); t != tables.end(); ++t)
+    {
+        // a grammar without symbols still has a table of tags
+        if (t->values.empty()) t->values.push_back(0);
+        o << "    static constexpr " << t->type << " " << t->name
+          << "[" << t->values.size() << "] = {";
+        generator::array(o, t->values);
+        o << "};\n";
+    }
+    o << "};\n\n";
+    o << "template <typename T> constexpr std::uint32_t Tables<T>::symbol_count;\n"
+      << "template <typename T> constexpr std::uint32_t Tables<T>::rule_count;\n"
+      << "template <typename T> constexpr std::uint32_t Tables<T>::hash_size;\n"
+      << "template <typename T> constexpr char Tables<T>::names[];\n";
+    for (auto t = tables.begin(); t != tables.end(); ++t)
+    {
+        o << "template <typename T> constexpr " << t->type << " Tables<T>::" << t->name << "[];\n";
+    }
+    o << "\n"
+      << "typedef StaticGrammar<Tables<>>                                         Grammar;\n"
+      << "typedef EarleyParser<Grammar>                                            Parser;\n\n"
+      << "} // " << name << "\n} // Generated\n} // Earley\n\n"
+      << "#endif // __GENERATED_" << name << "__HPP\n";
+}
+
+} // Earley
+
+#endif // __STATIC__HPP
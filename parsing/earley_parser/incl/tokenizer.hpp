@@ -0,0 +1,278 @@
+/**
+ * @file tokenizer.hpp
+ * Tokenizer that does not copy. The tokens of a string are returned as
+ * \b StrView objects pointing into the string, so splitting a line costs
+ * no allocation if the caller provides the space for the views. The
+ * delimiters are found 16 or 32 bytes at a time with SSE2 or AVX2 byte
+ * compares where the compiler targets these instruction sets, and one byte
+ * at a time elsewhere. Tokens are separated either by a single character
+ * (\b CharDelim) or by any whitespace (\b SpaceDelim); runs of delimiters
+ * count as one, and leading and trailing delimiters are ignored.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __TOKENIZER__HPP
+#define __TOKENIZER__HPP
+
+#include "declarations.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TOKENIZER_AVX2
+#define TOKENIZER_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TOKENIZER_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace helper
+{
+////////////////////////////////////////////////////////////////////////////////
+/// read-only view of \b count chars owned by someone else
+struct StrView
+{
+    const char* first;      ///< first char
+    std::size_t count;      ///< number of chars
+
+    StrView()
+    :first(nullptr), count(0)
+    {
+    }
+
+    StrView(const char* first, std::size_t count)
+    :first(first), count(count)
+    {
+    }
+
+    StrView(const sstr& s)
+    :first(s.data()), count(s.size())
+    {
+    }
+
+    const char* data() const { return first; }
+    const char* begin() const { return first; }
+    const char* end() const { return first+count; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    char operator[](std::size_t i) const { return first[i]; }
+
+    /// @returns copy of the viewed chars
+    sstr str() const
+    {
+        return sstr(first, count);
+    }
+
+    bool operator==(const StrView& o) const
+    {
+        return count == o.count && std::memcmp(first, o.first, count) == 0;
+    }
+
+    bool operator!=(const StrView& o) const
+    {
+        return !(*this == o);
+    }
+};
+
+/// writes the chars viewed by @p v to @p o
+inline sost& operator<<(sost& o, const StrView& v)
+{
+    return o.write(v.data(), v.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+namespace detail
+{
+/// @returns index of the lowest set bit of @p m, which must not be 0
+inline unsigned lowest_bit(std::uint32_t m)
+{
+    #if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return i;
+    #else
+    return __builtin_ctz(m);
+    #endif
+}
+} // detail
+
+////////////////////////////////////////////////////////////////////////////////
+/// tokens are separated by the char \b d
+struct CharDelim
+{
+    char d;
+
+    explicit CharDelim(char d=' ')
+    :d(d)
+    {
+    }
+
+    bool is(char c) const
+    {
+        return c == d;
+    }
+
+    #ifdef TOKENIZER_SSE2
+    /// @returns bit i set for every delimiter p[i] of 16 bytes at @p p
+    std::uint32_t mask16(const char* p) const
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(d)));
+    }
+    #endif
+
+    #ifdef TOKENIZER_AVX2
+    /// @returns bit i set for every delimiter p[i] of 32 bytes at @p p
+    std::uint32_t mask32(const char* p) const
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        return _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(d)));
+    }
+    #endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// tokens are separated by whitespace: ' ', '\\t', '\\n', '\\v', '\\f', '\\r'
+struct SpaceDelim
+{
+    bool is(char c) const
+    {
+        return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+    }
+
+    #ifdef TOKENIZER_SSE2
+    std::uint32_t mask16(const char* p) const
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // c-'\t' <= 4, unsigned, holds for '\t' to '\r'
+        __m128i c = _mm_sub_epi8(x, _mm_set1_epi8('\t'));
+        __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(c, _mm_set1_epi8('\r'-'\t')), c);
+        __m128i sp = _mm_cmpeq_epi8(x, _mm_set1_epi8(' '));
+        return _mm_movemask_epi8(_mm_or_si128(ctl, sp));
+    }
+    #endif
+
+    #ifdef TOKENIZER_AVX2
+    std::uint32_t mask32(const char* p) const
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i c = _mm256_sub_epi8(x, _mm256_set1_epi8('\t'));
+        __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(c, _mm256_set1_epi8('\r'-'\t')), c);
+        __m256i sp = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' '));
+        return _mm256_movemask_epi8(_mm256_or_si256(ctl, sp));
+    }
+    #endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief calls @p f(StrView) for every token of the @p n chars at @p p,
+ *        in order
+ * @details the chars are classified a block at a time; the bits of the
+ *          block's delimiter mask are then walked from token to token
+ */
+template <typename DELIM, typename F>
+void for_each_token(const char* p, std::size_t n, const DELIM& d, F f)
+{
+    const char* end = p+n;
+    const char* token = nullptr;    // begin of the current token, if any
+
+    // walks the delimiter mask @p m of the @p w chars at @p b
+    auto walk = [&](const char* b, std::uint32_t m, unsigned w)
+    {
+        std::uint32_t all = w == 32 ? 0xffffffffu : (1u << w)-1;
+        std::uint32_t seen = 0;     // bits before the current position
+        for (;;)
+        {
+            std::uint32_t bits = (token ? m : ~m & all) & ~seen;
+            if (bits == 0) return;
+            unsigned i = detail::lowest_bit(bits);
+            if (token)
+            {
+                f(StrView(token, b+i-token));
+                token = nullptr;
+            }
+            else
+            {
+                token = b+i;
+            }
+            seen = i == 31 ? 0xffffffffu : (2u << i)-1;
+        }
+    };
+
+    #ifdef TOKENIZER_AVX2
+    for (; end-p >= 32; p += 32) walk(p, d.mask32(p), 32);
+    #endif
+    #ifdef TOKENIZER_SSE2
+    for (; end-p >= 16; p += 16) walk(p, d.mask16(p), 16);
+    #endif
+    for (; p != end; ++p)
+    {
+        if (d.is(*p) == (token != nullptr))
+        {
+            if (token) f(StrView(token, p-token));
+            token = token ? nullptr : p;
+        }
+    }
+    if (token) f(StrView(token, end-token));
+}
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief splits the @p n chars at @p p into tokens without allocating
+ * @param out receives the first @p cap tokens
+ * @return number of tokens, which may be larger than @p cap
+ */
+template <typename DELIM>
+std::size_t split(const char* p, std::size_t n, const DELIM& d, StrView* out, std::size_t cap)
+{
+    std::size_t count = 0;
+    for_each_token(p, n, d, [&](const StrView& t)
+    {
+        if (count < cap) out[count] = t;
+        ++count;
+    });
+    return count;
+}
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief splits @p s into tokens, which replace the contents of @p out.
+ *        Allocates only if @p out has to grow.
+ */
+template <typename DELIM>
+void split(StrView s, const DELIM& d, std::vector<StrView>& out)
+{
+    out.clear();
+    for_each_token(s.data(), s.size(), d, [&out](const StrView& t)
+    {
+        out.push_back(t);
+    });
+}
+////////////////////////////////////////////////////////////////////////////////
+/// splits @p s at char @p d; see split(StrView, const DELIM&, std::vector<StrView>&)
+inline void split(StrView s, char d, std::vector<StrView>& out)
+{
+    split(s, CharDelim(d), out);
+}
+////////////////////////////////////////////////////////////////////////////////
+/// @returns number of tokens of @p s
+template <typename DELIM>
+std::size_t count_tokens(StrView s, const DELIM& d)
+{
+    return split(s.data(), s.size(), d, nullptr, 0);
+}
+
+} // helper
+
+#endif // __TOKENIZER__HPP
@@ -79,11 +79,17 @@ public: // METHODS
         }
         throw 0;
     }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of translations
+    std::size_t size() const
+    {
+        return es_entries.size();
+    }
 ////////////////////////////////////////////////////////////////////////////////
 private: // METHODS
 ////////////////////////////////////////////////////////////////////////////////
     /// looks up index of @p es in \b es_entries, @returns -1 if @p es is unknown
-    int find(ES es)
+    int find(const ES& es)
     {
         int i = 0;
         for (auto e = es_entries.begin(); e != es_entries.end(); ++e, ++i)
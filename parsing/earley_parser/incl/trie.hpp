@@ -0,0 +1,184 @@
+/**
+ * @file trie.hpp
+ * Double-array trie. \b WordTrie maps byte strings to numbers through two
+ * arrays of integers, \b base and \b check: the child of state s for byte
+ * c is t = base[s]+c+1, which is valid if check[t] == s. A key ends in
+ * state s if the slot base[s] belongs to s; that slot stores the value of
+ * the key as -value-1. Looking up a key takes one step per byte and no
+ * hashing, and since the trie consists of two flat arrays it can be
+ * stored in an image and used from there as is.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#ifndef __TRIE__HPP
+#define __TRIE__HPP
+
+#include "declarations.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Earley
+{
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                                  WordTrie                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief read-only double-array trie over arrays it does not own
+ * @details the arrays are made by build() and may live in a vector or in
+ *          a mapped image
+ */
+class WordTrie
+{
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //    PUBLIC TYPEDEFS
+////////////////////////////////////////////////////////////////////////////////
+typedef std::int32_t                                                       Slot;
+typedef std::vector<Slot>                                               SlotVec;
+/// key and value
+typedef std::pair<const sstr*, std::uint32_t>                             Entry;
+////////////////////////////////////////////////////////////////////////////////
+public:                                                    //     PUBLIC METHODS
+////////////////////////////////////////////////////////////////////////////////
+    /// constructs empty trie
+    WordTrie()
+    :base(nullptr), check(nullptr), slots(0)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// constructs trie on the @p slots slots of @p base and @p check
+    WordTrie(const Slot* base, const Slot* check, std::uint32_t slots)
+    :base(base), check(check), slots(slots)
+    {
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns value of keys not in the trie
+    static std::uint32_t none()
+    {
+        return static_cast<std::uint32_t>(-1);
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief looks up the key of @p n bytes at @p p
+     * @return its value or none()
+     */
+    std::uint32_t find(const char* p, std::size_t n) const
+    {
+        if (slots == 0) return none();
+        Slot s = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            std::uint32_t t = base[s] + (unsigned char)p[i] + 1;
+            if (t >= slots || check[t] != s) return none();
+            s = t;
+        }
+        std::uint32_t t = base[s];
+        if (t >= slots || check[t] != s) return none();
+        return -base[t]-1;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /// @returns number of slots
+    std::uint32_t size() const
+    {
+        return slots;
+    }
+////////////////////////////////////////////////////////////////////////////////
+    /**
+     * @brief builds the arrays of a trie holding @p entries
+     * @param entries keys with their values; sorted by key, keys unique
+     * @param base receives the base array
+     * @param check receives the check array
+     */
+    static void build(const std::vector<Entry>& entries, SlotVec& base, SlotVec& check)
+    {
+        base.assign(1, 0);
+        check.assign(1, 0);   // the root is used, but has no parent
+        if (entries.empty()) return;
+
+        // a node is a range of entries sharing the first depth bytes
+        struct Node { Slot state; std::size_t lo, hi, depth; };
+        std::vector<Node> todo(1, Node{0, 0, entries.size(), 0});
+        std::vector<std::pair<unsigned, std::size_t>> labels;
+        std::size_t first_free = 1;
+
+        while (!todo.empty())
+        {
+            Node node = todo.back();
+            todo.pop_back();
+
+            // labels of the children and where their ranges begin; 0 marks
+            // the end of a key, which sorts before all of its extensions
+            labels.clear();
+            for (std::size_t i = node.lo; i < node.hi; ++i)
+            {
+                const sstr& key = *entries[i].first;
+                unsigned label = key.size() == node.depth ? 0
+                               : (unsigned char)key[node.depth] + 1;
+                if (labels.empty() || labels.back().first != label)
+                {
+                    labels.push_back(std::make_pair(label, i));
+                }
+            }
+
+            // find the first base for which all children are free
+            while (first_free < check.size() && check[first_free] != -1) ++first_free;
+            std::size_t b = first_free > labels[0].first ? first_free - labels[0].first : 1;
+            for (;; ++b)
+            {
+                if (b + 257 > check.size())
+                {
+                    base.resize(b + 2*257, 0);
+                    check.resize(b + 2*257, -1);
+                }
+                bool fits = true;
+                for (auto l = labels.begin(); l != labels.end() && fits; ++l)
+                {
+                    fits = check[b + l->first] == -1;
+                }
+                if (fits) break;
+            }
+
+            base[node.state] = b;
+            for (std::size_t l = 0; l < labels.size(); ++l)
+            {
+                Slot t = b + labels[l].first;
+                check[t] = node.state;
+                std::size_t hi = l+1 < labels.size() ? labels[l+1].second : node.hi;
+                if (labels[l].first == 0)
+                {
+                    base[t] = -Slot(entries[labels[l].second].second)-1;
+                }
+                else
+                {
+                    todo.push_back(Node{t, labels[l].second, hi, node.depth+1});
+                }
+            }
+        }
+
+        // drop the unused slots at the end
+        std::size_t n = check.size();
+        while (n > 1 && check[n-1] == -1) --n;
+        base.resize(n);
+        check.resize(n);
+    }
+////////////////////////////////////////////////////////////////////////////////
+private:                                                   //     PRIVATE FIELDS
+////////////////////////////////////////////////////////////////////////////////
+    const Slot* base;       ///< base of the children of each state
+    const Slot* check;      ///< parent of each state; -1 for free slots
+    std::uint32_t slots;    ///< number of slots
+////////////////////////////////////////////////////////////////////////////////
+}; // WordTrie
+
+} // Earley
+
+#endif // __TRIE__HPP
@@ -0,0 +1,239 @@
+/**
+ * @file chartdump.cpp
+ * Reads chart dumps written by parse.out -b. Shows their charts, finds the
+ * items of a category and compares the charts of two dumps, e.g. of the
+ * same sentences parsed with two versions of a grammar. Items are compared
+ * by their symbol names, so the grammars may number their symbols
+ * differently.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma warning(disable : 4503)
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "../incl/dump.hpp"
+
+using namespace std;
+
+typedef Earley::ChartDump                      DUMP;
+
+void usage()
+{
+    cerr << "Usage:\n"
+    << "    info <chart dump>\n"
+    << "    show <chart dump> [<chart> [<first cell>[:<last cell>]]]\n"
+    << "    find <chart dump> <category>\n"
+    << "    diff <chart dump> <chart dump>\n"
+    << "\nCommands:\n"
+    << "    info  show the number of charts, cells, items, rules and symbols\n"
+    << "    show  show all charts, one chart or some cells of one chart\n"
+    << "    find  show the items of every chart with this left hand side\n"
+    << "    diff  show the items in the cells of one dump but not the other;\n"
+    << "          exits with 1 if there are any\n";
+    exit(1);
+}
+
+/// @returns dump @p path; exits if it cannot be read
+unique_ptr<DUMP> open_dump(const string& path)
+{
+    try
+    {
+        return unique_ptr<DUMP>(new DUMP(path));
+    }
+    catch (const Earley::LoadError& e)
+    {
+        helper::msg("error:", e.what(), __FILE__, __LINE__);
+        exit(1);
+    }
+}
+
+/// sends the tokens of chart @p c of @p d to @p out
+void show_tokens(const DUMP& d, size_t c, ostream& out)
+{
+    for (size_t t = 0; t+1 < d.chart(c).cell_count; ++t)
+    {
+        if (t > 0) out << ' ';
+        out << d.token(c, t);
+    }
+}
+
+/// sends cells @p first to @p last of chart @p c of @p d to @p out
+void show_chart(const DUMP& d, size_t c, size_t first, size_t last, ostream& out)
+{
+    const Earley::DumpChart& chart = d.chart(c);
+    out << "chart " << c << ": '";
+    show_tokens(d, c, out);
+    out << "'" << (chart.recognised ? ", recognised\n" : ", not recognised\n");
+    for (size_t i = first; i <= last && i < chart.cell_count; ++i)
+    {
+        DUMP::Cell cell = d.cell(c, i);
+        out << "\nCHART[" << i << "] ('";
+        if (i+1 < chart.cell_count) out << d.token(c, i);
+        else out << "$";
+        out << "')\n";
+        for (const Earley::DumpItem* item = cell.first; item != cell.second; ++item)
+        {
+            out << d.show(*item) << '\n';
+        }
+    }
+    out << '\n';
+}
+
+/// @returns items of cell @p i of chart @p c of @p d, shown and sorted
+vector<string> cell_items(const DUMP& d, size_t c, size_t i)
+{
+    vector<string> items;
+    if (i < d.chart(c).cell_count)
+    {
+        DUMP::Cell cell = d.cell(c, i);
+        for (const Earley::DumpItem* item = cell.first; item != cell.second; ++item)
+        {
+            items.push_back(d.show(*item));
+        }
+    }
+    sort(items.begin(), items.end());
+    return items;
+}
+
+/// @returns true, if chart @p c has the same tokens in @p a and @p b
+bool same_tokens(const DUMP& a, const DUMP& b, size_t c)
+{
+    if (a.chart(c).cell_count != b.chart(c).cell_count) return false;
+    for (size_t t = 0; t+1 < a.chart(c).cell_count; ++t)
+    {
+        if (a.token(c, t) != b.token(c, t)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief sends the items of every cell of @p a that are not in @p b, and
+ *        vice versa, to @p out
+ * @return number of items found in one dump only
+ */
+size_t diff(const DUMP& a, const DUMP& b, ostream& out)
+{
+    size_t differences = 0;
+    size_t charts = min(a.size(), b.size());
+    for (size_t c = 0; c < charts; ++c)
+    {
+        if (!same_tokens(a, b, c))
+        {
+            out << "chart " << c << ": different sentences, skipped\n";
+            continue;
+        }
+        if (a.chart(c).recognised != b.chart(c).recognised)
+        {
+            out << "chart " << c << ": "
+                << (a.chart(c).recognised ? "recognised" : "not recognised") << " -> "
+                << (b.chart(c).recognised ? "recognised" : "not recognised") << '\n';
+        }
+        for (size_t i = 0; i < a.chart(c).cell_count; ++i)
+        {
+            vector<string> ia = cell_items(a, c, i), ib = cell_items(b, c, i), only;
+            set_difference(ia.begin(), ia.end(), ib.begin(), ib.end(), back_inserter(only));
+            for (auto o = only.begin(); o != only.end(); ++o)
+            {
+                out << "chart " << c << " cell " << i << ": - " << *o << '\n';
+            }
+            differences += only.size();
+            only.clear();
+            set_difference(ib.begin(), ib.end(), ia.begin(), ia.end(), back_inserter(only));
+            for (auto o = only.begin(); o != only.end(); ++o)
+            {
+                out << "chart " << c << " cell " << i << ": + " << *o << '\n';
+            }
+            differences += only.size();
+        }
+    }
+    if (a.size() != b.size())
+    {
+        out << "charts " << charts << " to " << max(a.size(), b.size())-1 << " in "
+            << (a.size() > b.size() ? "the first" : "the second") << " dump only\n";
+        ++differences;
+    }
+    out << differences << " difference(s) in " << charts << " chart(s)\n";
+    return differences;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) usage();
+    string command = argv[1];
+    if (command == "info" && argc == 3)
+    {
+        unique_ptr<DUMP> d = open_dump(argv[2]);
+        const Earley::ChartDumpHeader& h = d->info();
+        size_t recognised = 0;
+        for (size_t c = 0; c < d->size(); ++c) recognised += d->chart(c).recognised;
+        cout << h.chart_count << " charts (" << recognised << " recognised), "
+             << h.cell_count << " cells, " << h.item_count << " items, "
+             << h.token_count << " tokens, " << h.symbol_count << " symbols, "
+             << h.size << " bytes\n";
+    }
+    else if (command == "show" && argc >= 3 && argc <= 5)
+    {
+        unique_ptr<DUMP> d = open_dump(argv[2]);
+        size_t first = 0, last = (size_t)-1;
+        if (argc == 5)
+        {
+            long f = 0, l = -1;
+            if (sscanf(argv[4], "%ld:%ld", &f, &l) < 1 || f < 0) usage();
+            first = f;
+            if (l >= 0) last = l;
+        }
+        if (argc >= 4)
+        {
+            size_t c = atol(argv[3]);
+            if (c >= d->size())
+            {
+                helper::msg("error:", "the dump has "+helper::to_string(d->size())+" charts\n");
+                exit(1);
+            }
+            show_chart(*d, c, first, last, cout);
+        }
+        else
+        {
+            for (size_t c = 0; c < d->size(); ++c) show_chart(*d, c, first, last, cout);
+        }
+    }
+    else if (command == "find" && argc == 4)
+    {
+        unique_ptr<DUMP> d = open_dump(argv[2]);
+        helper::StrView category(argv[3], strlen(argv[3]));
+        for (size_t c = 0; c < d->size(); ++c)
+        {
+            for (size_t i = 0; i < d->chart(c).cell_count; ++i)
+            {
+                DUMP::Cell cell = d->cell(c, i);
+                for (const Earley::DumpItem* item = cell.first; item != cell.second; ++item)
+                {
+                    if (d->lhs(*item) != category) continue;
+                    cout << "chart " << c << " cell " << i << ": " << d->show(*item) << '\n';
+                }
+            }
+        }
+    }
+    else if (command == "diff" && argc == 4)
+    {
+        unique_ptr<DUMP> a = open_dump(argv[2]);
+        unique_ptr<DUMP> b = open_dump(argv[3]);
+        return diff(*a, *b, cout) > 0 ? 1 : 0;
+    }
+    else usage();
+    return 0;
+}
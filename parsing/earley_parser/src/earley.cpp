@@ -0,0 +1,327 @@
+/*
+ * C interface of the Earley parser, compiled into libearley. Wraps the
+ * header only parser classes behind the opaque handles of "earley.h".
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma warning(disable : 4503)
+#endif
+
+#define EARLEY_BUILD
+
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "../incl/earley.h"
+#include "../incl/parser.hpp"
+#include "../incl/compiled.hpp"
+#include "../incl/lexicon.hpp"
+
+namespace
+{
+typedef std::string                                 ES;
+typedef long                                        IS;
+typedef Earley::CompiledGrammar<IS, ES>             GRAMMAR;
+typedef Earley::EarleyParser<GRAMMAR>               PARSER;
+typedef PARSER::Lexicon                             LEXICON;
+
+/// last error of the calling thread
+thread_local std::string last_error;
+
+/// stores @p what as the last error
+void fail(const std::string& what)
+{
+    last_error = what;
+}
+
+/// opens @p path into @p f; stores an error if that fails
+bool open(std::ifstream& f, const char* path)
+{
+    if (!path)
+    {
+        fail("no file given");
+        return false;
+    }
+    f.open(path, std::ifstream::in);
+    if (!f.is_open())
+    {
+        fail(std::string("failed to open '")+path+"'");
+        return false;
+    }
+    return true;
+}
+} // anonymous namespace
+
+struct earley_grammar
+{
+    std::unique_ptr<GRAMMAR> grammar;   ///< compiled grammar
+    std::shared_ptr<LEXICON> lexicon;   ///< shared with the parsers
+};
+
+struct earley_parser
+{
+    explicit earley_parser(earley_grammar* g)
+    :parser(*g->grammar, g->lexicon)
+    {
+        parser.set_busy_indicator(false);
+    }
+
+    PARSER parser;                      ///< parser with its own chart
+    size_t unknown = 0;                 ///< unknown tokens of last sentence
+};
+
+int earley_api_version(void)
+{
+    return EARLEY_API_VERSION;
+}
+
+const char* earley_last_error(void)
+{
+    return last_error.c_str();
+}
+
+earley_grammar* earley_grammar_load(const char* grammar,
+                                    const char* tags,
+                                    const char* words)
+{
+    std::ifstream tagfile;
+    if (!grammar || !words)
+    {
+        fail("no file given");
+        return nullptr;
+    }
+    if (!open(tagfile, tags)) return nullptr;
+    try
+    {
+        std::unique_ptr<earley_grammar> g(new earley_grammar);
+        g->grammar = GRAMMAR::load(grammar);
+        g->lexicon = std::make_shared<LEXICON>();
+        g->lexicon->load_tags(tagfile, *g->grammar);
+        g->lexicon->load_words(words, *g->grammar);
+        last_error.clear();
+        return g.release();
+    }
+    catch (const std::exception& e)
+    {
+        fail(e.what());
+    }
+    return nullptr;
+}
+
+void earley_grammar_free(earley_grammar* g)
+{
+    delete g;
+}
+
+size_t earley_grammar_words(const earley_grammar* g)
+{
+    return g ? g->lexicon->word_count() : 0;
+}
+
+earley_parser* earley_parser_new(earley_grammar* g)
+{
+    if (!g)
+    {
+        fail("no grammar given");
+        return nullptr;
+    }
+    try
+    {
+        return new earley_parser(g);
+    }
+    catch (const std::exception& e)
+    {
+        fail(e.what());
+    }
+    return nullptr;
+}
+
+void earley_parser_free(earley_parser* p)
+{
+    delete p;
+}
+
+int earley_parse(earley_parser* p,
+                 const char* const* tokens,
+                 const size_t* lengths,
+                 size_t n)
+{
+    if (!p || (n > 0 && (!tokens || !lengths)))
+    {
+        fail("invalid argument");
+        return -1;
+    }
+    // chart indices are of type short
+    if (n >= 0x7fff)
+    {
+        fail("sentence too long");
+        return -1;
+    }
+    try
+    {
+        p->parser.begin(tokens, lengths, n);
+        p->unknown = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (p->parser.get_entry(i) == LEXICON::none()) ++p->unknown;
+        }
+        p->parser.advance();
+        return p->parser.accepted() ? 1 : 0;
+    }
+    catch (const std::exception& e)
+    {
+        fail(e.what());
+    }
+    return -1;
+}
+
+int earley_begin(earley_parser* p)
+{
+    if (!p)
+    {
+        fail("invalid argument");
+        return -1;
+    }
+    p->parser.begin();
+    p->unknown = 0;
+    return 0;
+}
+
+int earley_push(earley_parser* p, const char* token, size_t length)
+{
+    if (!p || !token)
+    {
+        fail("invalid argument");
+        return -1;
+    }
+    // chart indices are of type short
+    if (p->parser.cell_count() >= 0x7fff)
+    {
+        fail("sentence too long");
+        return -1;
+    }
+    try
+    {
+        int viable = p->parser.push(token, length) ? 1 : 0;
+        if (p->parser.get_entry(p->parser.cell_count()-2) == LEXICON::none()) ++p->unknown;
+        return viable;
+    }
+    catch (const std::exception& e)
+    {
+        fail(e.what());
+    }
+    return -1;
+}
+
+int earley_finish(earley_parser* p)
+{
+    if (!p)
+    {
+        fail("invalid argument");
+        return -1;
+    }
+    try
+    {
+        return p->parser.finish() ? 1 : 0;
+    }
+    catch (const std::exception& e)
+    {
+        fail(e.what());
+    }
+    return -1;
+}
+
+int earley_edit(earley_parser* p, size_t index, size_t count,
+                const char* const* tokens, const size_t* lengths, size_t n)
+{
+    if (!p || (n > 0 && (!tokens || !lengths)))
+    {
+        fail("invalid argument");
+        return -1;
+    }
+    // chart indices are of type short
+    if (index >= 0x7fff || count >= 0x7fff ||
+        (n > count && p->parser.cell_count() + (n - count) >= 0x7fff))
+    {
+        fail("sentence too long");
+        return -1;
+    }
+    try
+    {
+        p->parser.edit(index, count, tokens, lengths, n);
+        p->unknown = 0;
+        for (short i = 0; i+1 < p->parser.cell_count(); ++i)
+        {
+            if (p->parser.get_entry(i) == LEXICON::none()) ++p->unknown;
+        }
+        p->parser.advance();
+        return p->parser.accepted() ? 1 : 0;
+    }
+    catch (const std::exception& e)
+    {
+        fail(e.what());
+    }
+    return -1;
+}
+
+size_t earley_reused_cells(const earley_parser* p)
+{
+    return p ? p->parser.resumed() : 0;
+}
+
+size_t earley_expected_words(earley_parser* p, const char** words,
+                             size_t* lengths, size_t max)
+{
+    if (!p || (max > 0 && (!words || !lengths)))
+    {
+        fail("invalid argument");
+        return 0;
+    }
+    try
+    {
+        std::vector<unsigned> expected = p->parser.expected_words();
+        const LEXICON& lexicon = p->parser.get_lexicon();
+        for (size_t i = 0; i < expected.size() && i < max; ++i)
+        {
+            helper::StrView w = lexicon.view_word(expected[i]);
+            words[i] = w.data();
+            lengths[i] = w.size();
+        }
+        return expected.size();
+    }
+    catch (const std::exception& e)
+    {
+        fail(e.what());
+    }
+    return 0;
+}
+
+size_t earley_unknown_tokens(const earley_parser* p)
+{
+    return p ? p->unknown : 0;
+}
+
+int earley_token_known(const earley_parser* p, size_t i)
+{
+    if (!p || i+1 >= (size_t)p->parser.cell_count()) return 0;
+    return p->parser.get_entry(i) != LEXICON::none();
+}
+
+size_t earley_chart_cells(const earley_parser* p)
+{
+    return p ? p->parser.cell_count() : 0;
+}
+
+size_t earley_chart_items(const earley_parser* p, size_t i)
+{
+    if (!p || i >= (size_t)p->parser.cell_count()) return 0;
+    return p->parser.item_count(i);
+}
@@ -0,0 +1,208 @@
+/*
+ * Checks of the compiled grammar that the parse driver cannot make from
+ * the command line: a grammar with variants refuses to be changed, the
+ * variants keep parsing as before, the symbols a variant adds are its own,
+ * and a factored or optimized grammar expects the same tags after every
+ * token of the corpus of 'make regress' as the grammar it has been made
+ * from.
+ * Prints a line per check and exits with 1 if one fails; run from the
+ * directory above src.
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma warning(disable : 4503)
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "../incl/parser.hpp"
+#include "../incl/compiled.hpp"
+
+using namespace std;
+
+typedef string                                 ES;
+typedef long                                   IS;
+typedef Earley::CompiledGrammar<IS, ES>        GRAMMAR;
+typedef Earley::EarleyParser<GRAMMAR>          PARSER;
+typedef PARSER::Lexicon                        LEXICON;
+
+/// number of checks failed
+int failures = 0;
+
+/// reports check @p what, which passed if @p ok
+void check(bool ok, const string& what)
+{
+    cout << (ok ? "ok      " : "FAILED  ") << what << "\n";
+    if (!ok) ++failures;
+}
+
+/// @returns true, if @p f throws std::runtime_error
+template <typename F>
+bool throws(F f)
+{
+    try
+    {
+        f();
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+    return false;
+}
+
+/// @returns the grammar and lexicon of data/@p name, e.g. data/example1
+shared_ptr<GRAMMAR> load(shared_ptr<LEXICON>& lexicon, const string& name="example1")
+{
+    shared_ptr<GRAMMAR> g = GRAMMAR::load("data/"+name+".cfg");
+    ifstream tags("data/"+name+".pos");
+    lexicon = make_shared<LEXICON>();
+    lexicon->load_tags(tags, *g);
+    lexicon->load_words("data/"+name+".words", *g);
+    return g;
+}
+
+/**
+ * @brief parses the sentences of file @p path, one per line, token by token
+ * @return a line per token with the names of the tags expected after it,
+ *         and a line per sentence whether it is accepted
+ */
+string expectations(const GRAMMAR& g, const shared_ptr<LEXICON>& lexicon, const char* path)
+{
+    PARSER p(g, lexicon);
+    p.set_busy_indicator(false);
+    ostringstream o;
+    ifstream in(path);
+    string line;
+    while (getline(in, line))
+    {
+        vector<string> tokens = helper::tokenise(line);
+        if (tokens.empty()) continue;
+        p.begin();
+        for (auto t = tokens.begin(); t != tokens.end(); ++t)
+        {
+            p.push(*t);
+            vector<IS> tags = p.expected_tags();
+            for (auto s = tags.begin(); s != tags.end(); ++s) o << g.translate(*s) << ' ';
+            o << '\n';
+        }
+        o << (p.finish() ? "accepted\n" : "rejected\n");
+    }
+    return o.str();
+}
+
+/// @returns whether @p sentence is accepted with grammar @p g
+bool accepts(const GRAMMAR& g, const shared_ptr<LEXICON>& lexicon, const ES& sentence)
+{
+    PARSER p(g, lexicon);
+    p.set_busy_indicator(false);
+    return p.parse(helper::tokenise(sentence));
+}
+
+/// a grammar with variants is neither changed, factored nor optimized
+void variants_keep_their_grammar()
+{
+    shared_ptr<LEXICON> lexicon;
+    shared_ptr<GRAMMAR> g = load(lexicon);
+    const ES sentence = "der Frosch frisst die Katze";
+    bool accepted = accepts(*g, lexicon, sentence);
+
+    unique_ptr<GRAMMAR> v = GRAMMAR::variant(g);
+    unique_ptr<GRAMMAR> w = GRAMMAR::variant(shared_ptr<GRAMMAR>(GRAMMAR::variant(g)));
+    check(throws([&] { g->add_rule("NP", { "N" }); }), "adding a rule to a grammar with variants throws");
+    check(throws([&] { g->remove_rule("NP", { "Det", "N'" }); }), "removing a rule from a grammar with variants throws");
+    check(throws([&] { g->factor(*lexicon); }), "factoring a grammar with variants throws");
+    check(throws([&] { g->optimize(*lexicon); }), "optimizing a grammar with variants throws");
+    check(accepts(*v, lexicon, sentence) == accepted && accepts(*w, lexicon, sentence) == accepted,
+          "the variants parse as their grammar");
+
+    // the variant of a variant still counts for the grammar
+    v.reset();
+    check(throws([&] { g->add_rule("NP", { "N" }); }), "a variant of a variant keeps the grammar from changing");
+    w.reset();
+    check(!throws([&] { g->add_rule("NP", { "N" }); }), "the grammar changes once its variants are freed");
+}
+
+/// the symbols a variant adds are neither symbols of its grammar nor of
+/// other variants
+void variants_keep_their_symbols()
+{
+    shared_ptr<LEXICON> lexicon;
+    shared_ptr<GRAMMAR> g = load(lexicon);
+    const ES sentence = "der Frosch frisst die Katze";
+    bool accepted = accepts(*g, lexicon, sentence);
+    // a word is translated like a lexicon does with SOVERLOAD
+    IS word = g->translate(ES("Frosch"));
+
+    unique_ptr<GRAMMAR> v = GRAMMAR::variant(g);
+    shared_ptr<GRAMMAR> w = GRAMMAR::variant(g);
+    v->add_rule("NP", { "NX" });
+    v->add_rule("NX", { "N", "N" });
+    w->add_rule("NY", { "Det" });
+    IS nx = v->find("NX", 2);
+    IS ny = w->find("NY", 2);
+    check(g->find("NX", 2) == -1 && g->find("NY", 2) == -1, "the grammar does not get the symbols of its variants");
+    check(w->find("NX", 2) == -1 && v->find("NY", 2) == -1, "a variant does not get the symbols of another");
+    check(nx != -1 && ny != -1 && v->translate(nx) == "NX" && w->translate(ny) == "NY",
+          "a variant translates the symbols it adds");
+    check(v->find("Frosch", 6) == word && v->translate(word) == "Frosch",
+          "a variant translates the words of its grammar");
+    check(g->translate(nx) != "NX", "the grammar does not translate the IDs of a variant");
+    check(throws([&] { g->translate(ES("NZ")); }), "a grammar with variants gets no new symbols");
+
+    // a variant of a variant has the symbols of the latter
+    unique_ptr<GRAMMAR> u = GRAMMAR::variant(w);
+    check(u->find("NY", 2) == ny && u->translate(ny) == "NY", "a variant of a variant keeps its symbols");
+    check(accepts(*g, lexicon, sentence) == accepted, "the grammar parses as before");
+}
+
+/// a factored grammar expects the tags and accepts the sentences of the
+/// grammar it has been factored from
+void factoring_keeps_the_language(const string& reference)
+{
+    shared_ptr<LEXICON> lexicon;
+    shared_ptr<GRAMMAR> g = load(lexicon, "bitpar");
+    g->factor(*lexicon);
+    check(expectations(*g, lexicon, "data/regress.input") == reference,
+          "a factored grammar expects the tags of its rules on data/regress.input");
+}
+
+/// an optimized grammar expects the tags and accepts the sentences of the
+/// grammar it has been optimized from
+void optimizing_keeps_the_language(const string& reference)
+{
+    shared_ptr<LEXICON> lexicon;
+    shared_ptr<GRAMMAR> g = load(lexicon, "bitpar");
+    g->optimize(*lexicon);
+    check(expectations(*g, lexicon, "data/regress.input") == reference,
+          "an optimized grammar expects the tags of its rules on data/regress.input");
+}
+
+int main()
+{
+    try
+    {
+        variants_keep_their_grammar();
+        variants_keep_their_symbols();
+        shared_ptr<LEXICON> lexicon;
+        shared_ptr<GRAMMAR> g = load(lexicon, "bitpar");
+        const string reference = expectations(*g, lexicon, "data/regress.input");
+        factoring_keeps_the_language(reference);
+        optimizing_keeps_the_language(reference);
+    }
+    catch (const std::exception& e)
+    {
+        check(false, e.what());
+    }
+    return failures > 0 ? 1 : 0;
+}
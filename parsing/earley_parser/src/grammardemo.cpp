@@ -4,35 +4,67 @@
 
 #include <iostream>
 #include <chrono>
+#include <thread>
 
 #include "../incl/rule.hpp"
+#include "../incl/loader.hpp"
 
 using namespace std;
 using namespace std::chrono;
 
+typedef string ES;
+typedef long IS;
+typedef Earley::CFGRuleParser<IS, ES>          RP;
+typedef Earley::CFGValidator<RP::ES>           V;
+typedef Earley::Grammar<V, RP>                 GRAMMAR;
+typedef Earley::RuleTable<ES>                  TABLE;
 
+/// @returns milliseconds since @p t1
+long int elapsed(high_resolution_clock::time_point t1)
+{
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>( t2 - t1 ).count();
+
+    return duration/(float)1000;
+}
 
 int main()
 {
-    std::ifstream gr("data/temp/gramrules");
+    const char* path = "data/temp/gramrules";
+    std::ifstream gr(path);
 
     if(!gr) exit(1);
 
+    // sequential reference: fill a Grammar line by line
     high_resolution_clock::time_point t1 = high_resolution_clock::now();
 
-    typedef string ES;
-    typedef long IS;
-    typedef Earley::CFGRuleParser<IS, ES>          RP;
-    typedef Earley::CFGValidator<RP::ES>           V;
-    typedef Earley::Grammar<V, RP>                 GRAMMAR;
-
     GRAMMAR g(gr);
 
-    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    long int sequential = elapsed(t1);
+    std::cout << "rules processed in " << sequential << " milliseconds\n";
 
-    auto duration = std::chrono::duration_cast<std::chrono::microseconds>( t2 - t1 ).count();
+    // parallel loader with 1, 2, 4, ... threads up to the number of cores
+    unsigned cores = Earley::ParallelLoader::thread_count(0);
+    TABLE reference;
+    long int single = 0;
+    for (unsigned threads = 1; ; threads = std::min(2*threads, cores))
+    {
+        t1 = high_resolution_clock::now();
 
-    long int elapsed = duration/(float)1000;
+        TABLE t = Earley::ParallelLoader::load_rules<V, RP>(path, threads);
 
-    std::cout << "rules processed in " << elapsed << " milliseconds\n";
+        long int ms = elapsed(t1);
+        if (threads == 1)
+        {
+            single = ms;
+            reference = t;
+        }
+        bool same = t.symbols == reference.symbols && t.rules == reference.rules;
+        std::cout << t.order.size() << " rules loaded on " << threads
+                  << " thread(s) in " << ms << " milliseconds, speedup "
+                  << (ms > 0 ? single/(float)ms : 1.0f)
+                  << (same ? "" : ", RESULT DIFFERS") << "\n";
+        if (threads == cores) break;
+    }
 }
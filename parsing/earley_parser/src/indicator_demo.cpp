@@ -62,4 +62,28 @@ int main()
         progressbar.run(i);
     }
 
+
+    // the loops below only count their steps; the indicators are drawn by
+    // a render thread, so the loops don't pay for terminal output
+    BUSY::Indicator<BUSY::Variant2> indicator;
+    std::cout << "\nDemonstrating the busy indicator drawn by a render thread:\n";
+    indicator.start();
+    for (long i = 0; i < 20000; ++i)
+    {
+        secondsleep(0.1);
+        indicator.tick();
+    }
+    indicator.pause();
+
+
+    std::cout << "Demonstrating the load indicator drawn by a render thread:\n";
+    {
+        LOAD::Progress progress(500);
+        for (long i = 0; i < 500; ++i)
+        {
+            secondsleep(1.2);
+            progress.add();
+        }
+    }
+
 }
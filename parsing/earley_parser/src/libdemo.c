@@ -0,0 +1,102 @@
+/*
+ * Demonstrates the C interface of libearley. Parses every line of a file
+ * as one sentence, passing the tokens as pointers into the line.
+ *
+ * usage: libdemo.out grammar tags words input
+ *
+ * Matthias Bisping
+ *
+ * compilers: - clang-700.0.72
+ *            - clang 3.5.2 / 3.5.0
+ *            - GCC 5.2.0 / 4.8.3
+ *            - Microsoft C/C++ 19.00.23026 for x86
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../incl/earley.h"
+
+#define MAX_TOKENS 256
+
+int main(int argc, char** argv)
+{
+    char line[4096];
+    const char* tokens[MAX_TOKENS];
+    size_t lengths[MAX_TOKENS];
+    earley_grammar* g;
+    earley_parser* p;
+    FILE* in;
+
+    if (argc != 5)
+    {
+        fprintf(stderr, "usage: %s grammar tags words input\n", argv[0]);
+        return 1;
+    }
+    g = earley_grammar_load(argv[1], argv[2], argv[3]);
+    if (!g)
+    {
+        fprintf(stderr, "%s\n", earley_last_error());
+        return 1;
+    }
+    p = earley_parser_new(g);
+    in = fopen(argv[4], "r");
+    if (!p || !in)
+    {
+        fprintf(stderr, "failed to set up parser or input\n");
+        return 1;
+    }
+    earley_begin(p);
+    printf("libearley %d, %lu words, %lu of them can begin a sentence\n",
+           earley_api_version(), (unsigned long)earley_grammar_words(g),
+           (unsigned long)earley_expected_words(p, NULL, NULL, 0));
+
+    while (fgets(line, sizeof line, in))
+    {
+        size_t n = 0, i, viable = 0;
+        char* c = line;
+        int result;
+        for (;;)
+        {
+            c += strspn(c, " \t\r\n");
+            if (*c == '\0' || n == MAX_TOKENS) break;
+            tokens[n] = c;
+            lengths[n] = strcspn(c, " \t\r\n");
+            c += lengths[n++];
+        }
+        if (n == 0) continue;
+
+        result = earley_parse(p, tokens, lengths, n);
+        if (result < 0)
+        {
+            fprintf(stderr, "%s\n", earley_last_error());
+            continue;
+        }
+        /* the same sentence token by token, as it would arrive: the prefix
+           stays viable as long as each token can continue it */
+        earley_begin(p);
+        for (i = 0; i < n; ++i)
+        {
+            if (earley_push(p, tokens[i], lengths[i]) == 1 && viable == i) viable = i+1;
+        }
+        if (earley_finish(p) != result) fprintf(stderr, "streamed result differs\n");
+
+        /* replacing the last token by itself keeps the cells before it */
+        if (earley_edit(p, n-1, 1, tokens+n-1, lengths+n-1, 1) != result)
+        {
+            fprintf(stderr, "edited result differs\n");
+        }
+
+        printf("%-10s %lu tokens, %lu unknown, %lu items in last cell, %lu viable, %lu kept\n",
+               result ? "accepted" : "rejected", (unsigned long)n,
+               (unsigned long)earley_unknown_tokens(p),
+               (unsigned long)earley_chart_items(p, earley_chart_cells(p)-1),
+               (unsigned long)viable,
+               (unsigned long)earley_reused_cells(p));
+    }
+
+    fclose(in);
+    earley_parser_free(p);
+    earley_grammar_free(g);
+    return 0;
+}
@@ -22,10 +22,28 @@
 #include <set>
 #include <unordered_set>
 #include <map>
+#include <deque>
+#include <memory>
 #include <fstream>
+#include <csignal>
+#include <sstream>
+#include <chrono>
+#include <cctype>
 
 #include "../incl/parser.hpp"
-#include "../incl/grammar.hpp"
+#include "../incl/compiled.hpp"
+#include "../incl/io.hpp"
+#include "../incl/async.hpp"
+#include "../incl/daemon.hpp"
+#include "../incl/static.hpp"
+// a binary with a built-in grammar is compiled with the header written by
+// 'generate' and the name passed to it, e.g. -DBUILTIN_GRAMMAR=bitpar
+// -DBUILTIN_GRAMMAR_HEADER='"../bin/bitpar_grammar.hpp"'
+#ifdef BUILTIN_GRAMMAR
+#include BUILTIN_GRAMMAR_HEADER
+#define BUILTIN_NAME_(name) #name
+#define BUILTIN_NAME(name) BUILTIN_NAME_(name)
+#endif
 #ifdef _WIN32
 #include "../incl/getopt.h"
 #include <io.h>
@@ -41,8 +59,20 @@ using namespace std;
 void usage()
 {
     cerr << "Usage:\n"
-    << "   ( -f <input file> | -s <input string> ) -g <grammar> -t <POS-tags> -w <words> [-v <verbosity>]\n"
-    << "    -g <grammar> -t <POS-tags> -w <words> [-v <verbosity>] < <input stream>\n";
+    << "   ( -f <input file> | -s <input string> ) -g <grammar> [<grammar options>] -t <POS-tags> -w <words> [-v <verbosity>] [-j <threads>] [-a <result cache>] [-p <megabytes>] [<chart options>]\n"
+    << "    -g <grammar> [<grammar options>] -t <POS-tags> -w <words> [-v <verbosity>] [-j <threads>] [-a <result cache>] [-p <megabytes>] [<chart options>] < <input stream>\n"
+    << "    -d <socket> -g <grammar> [-e [<name>=]<rule edits>]... -t <POS-tags> -w <words> [-j <threads>]\n"
+    << "    -c <socket> ( -f <input file> | -s <input string> | -q | -r ) [-n <name>] [-v <verbosity>]\n"
+    << "    -c <socket> [-n <name>] [-v <verbosity>] < <input stream>\n"
+    << "    compile ( -g <grammar> [-e <rule edits>] | -w <words> ) -o <image>\n"
+    << "    compile -f <input file> -w <words> -o <binary corpus>\n"
+    << "    generate -g <grammar> -t <POS-tags> -n <name> -o <header>\n"
+    #ifdef BUILTIN_GRAMMAR
+    << "the grammar '" BUILTIN_NAME(BUILTIN_GRAMMAR) "' is built in; leave out -g and -e\n"
+    #endif
+    << "grammar options: [-e [<name>=]<rule edits>]... [-n <name>] [-F | -O]\n"
+    << "chart options: [-x <chart format>] [-y <first cell>[:<last cell>]] [-k <category>[,<category>...]]\n"
+    << "               [-b <chart dump> [-m <milliseconds>]]\n";
     exit(1);
 }
 
@@ -50,26 +80,63 @@ void help()
 {
     cerr << "\nEarley Parser\n\n"
     << "Usage:\n"
-    << "    ( -f <input file> | -s <input string> ) -g <grammar> -t <POS-tags> -w <words> [-v <verbosity>]\n"
-    << "    -g <grammar> -t <POS-tags> -w <words> [-v <verbosity>] < <input stream>\n"
+    << "    ( -f <input file> | -s <input string> ) -g <grammar> [<grammar options>] -t <POS-tags> -w <words> [-v <verbosity>] [-j <threads>] [-a <result cache>] [-p <megabytes>] [<chart options>]\n"
+    << "    -g <grammar> [<grammar options>] -t <POS-tags> -w <words> [-v <verbosity>] [-j <threads>] [-a <result cache>] [-p <megabytes>] [<chart options>] < <input stream>\n"
+    << "    -d <socket> -g <grammar> [-e [<name>=]<rule edits>]... -t <POS-tags> -w <words> [-j <threads>]\n"
+    << "    -c <socket> ( -f <input file> | -s <input string> | -q | -r ) [-n <name>] [-v <verbosity>]\n"
+    << "    -c <socket> [-n <name>] [-v <verbosity>] < <input stream>\n"
+    << "    compile ( -g <grammar> [-e <rule edits>] | -w <words> ) -o <image>\n"
+    << "    compile -f <input file> -w <words> -o <binary corpus>\n"
+    << "    generate -g <grammar> -t <POS-tags> -n <name> -o <header>\n"
+    #ifdef BUILTIN_GRAMMAR
+    << "\nThe grammar '" BUILTIN_NAME(BUILTIN_GRAMMAR) "' is built into this binary; leave out -g and -e.\n"
+    #endif
     << "\nOptions:\n"
+    << "    -a    keep the results, by ambiguity classes of the words, in this file from run to run; not with charts\n"
+    << "    -b    append the chart of every sentence to this binary chart dump; read it with bin/chartdump.out\n"
+    << "    -c    send the input to the daemon listening on this socket instead of loading a grammar\n"
+    << "    -d    run as daemon serving requests on this socket until interrupted; SIGHUP reloads the grammar\n"
+    << "    -e    file of rules to add ('+ <rule>') or remove ('- <rule>'), one per line, after loading the grammar;\n"
+    << "          with compile: before writing the image. May be given more than once. Prefixed with '<name>=',\n"
+    << "          the changes make a variant of the grammar called <name>, which shares symbols and words with it\n"
     << "    -f    file with text to parse; tokens separated by space or new line. Sentences separated by empty line\n"
+    << "          may also be a binary corpus made with 'compile' for the words given with -w\n"
+    << "    -F    factor the features out of the categories, e.g. NN-HD-Gen.Sg.Fem into NN-HD and Gen.Sg.Fem, and parse\n"
+    << "          with the factored rules, which check that features agree; not with -n or -d\n"
+    << "    -O    optimize the rules: drop useless rules, collapse chains of unary rules and share the prefixes of rules\n"
+    << "          of one left hand side; charts show the rules as written. Not with -n or -d\n"
     #if SOVERLOAD
     << "    -g    grammar (CFG) file; max 1 rule per line\n"
 
     #else
     << "    -g    grammar (CFG) file; max 1 rule per line. May NOT contain terminal rules for words (e.g. 'V --> goes')\n"
     #endif
+    << "          may also be a grammar image made with 'compile', which loads without reading any rule\n"
     << "    -h    show this message\n"
+    << "    -j    parse sentences in parallel on this many threads; not with charts\n"
+    << "    -k    show only chart items of these categories (left hand sides), separated by commas\n"
+    << "    -m    with -b: dump only the charts of sentences that take at least this many milliseconds\n"
+    << "    -n    parse with the grammar variant of this name, see -e; with -c: one the daemon has been started with\n"
+    << "          with generate: name of the grammar; its namespace in the header, so a C++ identifier\n"
+    << "    -o    with compile: grammar image, lexicon image or binary corpus to write\n"
+    << "          with generate: C++ header with the tables of the grammar, see 'make bin/parse_bitpar.out'\n"
+    << "    -p    resume sentences after the longest prefix of ambiguity classes parsed before, keeping the chart\n"
+    << "          cells of recent sentences in at most this many megabytes\n"
+    << "    -q    with -c: show the counters of the daemon\n"
+    << "    -r    with -c: make the daemon reload its grammar, tags and words\n"
     << "    -s    string to parse; tokens separated by spaces\n"
     << "    -t    POS-tag file; max 1 tag per line\n"
-    << "    -v    verbosity [default: 0]\n"
+    << "    -v    verbosity [default: 0]; 3 shows the chart of every sentence\n"
     #if SOVERLOAD
     << "    -w    words file; max(min 1 token followed by exactly 1 tag) per line"
     #else
     << "    -w    words file; max(min 1 token followed by exactly 1 tag) per line. The terminal rules for words banned"
        " from the grammar are represented here.\n"
     #endif
+    << "          may also be a lexicon image made with 'compile', which is used without reading the words\n"
+    << "    -x    show the chart of every sentence in this format: text (as for verbosity 3), jsonl (one\n"
+    << "          JSON object per item) or dot (Graphviz graph with an edge per item)\n"
+    << "    -y    show only these chart cells; the last cell defaults to the end of the chart\n"
     << "\n";
 }
 
@@ -85,9 +152,461 @@ void failed_to_open(sstr s)
     exit(1);
 }
 
+/// sends the tokens of sentence @p s, separated by spaces, to @p out
+template <typename SENTENCE>
+void show_sentence(const SENTENCE& s, sost& out)
+{
+    for (auto t = s.begin(); t != s.end(); ++t)
+    {
+        if (t != s.begin()) out << ' ';
+        out << *t;
+    }
+}
+
+/// @returns copies of the tokens of @p s
+svec_s copy_tokens(const svec_s& s)
+{
+    return s;
+}
+
+template <typename SENTENCE>
+svec_s copy_tokens(const SENTENCE& s)
+{
+    svec_s tokens;
+    for (auto t = s.begin(); t != s.end(); ++t) tokens.push_back((*t).str());
+    return tokens;
+}
+
+/// sends result @p p for sentence @p s to @p out
+template <typename SENTENCE>
+void show_result(const SENTENCE& s, bool p, int verbosity, sost& out)
+{
+    if (verbosity > 1)
+    {
+        out << "'";
+        show_sentence(s, out);
+        out << "'\n";
+        if(p) out << "parse complete, input recognised.\n\n";
+        else out << "parse incomplete, input not recognised.\n\n";
+    }
+    else if (verbosity > 0) out << p << '\n';
+}
+
+/// where the charts of the parsed sentences go
+template <typename PARSER>
+struct ChartOutput
+{
+    typename PARSER::Exporter* exporter;    ///< renders the charts, if set
+    typename PARSER::DumpWriter* dump;      ///< dumps the charts, if set
+    long dump_ms;                           ///< dump charts of sentences
+                                            ///< taking this long only
+
+    ChartOutput()
+    :exporter(nullptr), dump(nullptr), dump_ms(0)
+    {
+    }
+
+    /// @returns true, if charts are needed at all
+    bool any() const
+    {
+        return exporter || dump;
+    }
+};
+
+/**
+ * @brief parses sentence @p s with @p parser and sends the result to @p out
+ * @param charts if not null, receives the chart of @p s after the parse
+ */
+template <typename PARSER, typename SENTENCE>
+void parse_sentence(PARSER& parser, const SENTENCE& s, int verbosity, sost& out,
+                    const ChartOutput<PARSER>* charts=nullptr)
+{
+    if (!charts || !charts->any())
+    {
+        show_result(s, parser.parse(s), verbosity, out);
+        return;
+    }
+    if (verbosity > 2)
+    {
+        out << "'";
+        show_sentence(s, out);
+        out << "'\n";
+    }
+    // the chart shows the tokens, so it needs copies of them
+    auto start = std::chrono::steady_clock::now();
+    bool p = parser.parse(copy_tokens(s));
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start).count();
+    if (charts->exporter) parser.export_chart(*charts->exporter);
+    if (charts->dump && ms >= charts->dump_ms) parser.dump_chart(*charts->dump);
+    if (verbosity > 2)
+    {
+        if(p) out << "parse complete, input recognised.\n\n";
+        else out << "parse incomplete, input not recognised.\n\n";
+    }
+    else show_result(s, p, verbosity, out);
+}
+
+/**
+ * @brief parses all sentences of @p reader on @p threads threads and sends
+ *        the results to @p out in input order. At most a few sentences per
+ *        thread are in flight at any time.
+ */
+template <typename PARSER, typename READER>
+void parse_parallel(PARSER& parser, READER& reader,
+                    unsigned threads, int verbosity, sost& out)
+{
+    typedef Earley::AsyncParser<PARSER>                 ASYNC;
+    typedef typename READER::Sentence                   SENTENCE;
+    typedef std::pair<SENTENCE, typename ASYNC::Request> PENDING;
+
+    ASYNC async(parser, threads);
+    std::deque<PENDING> window;
+    SENTENCE sentence;
+    while (reader.next(sentence))
+    {
+        window.push_back(PENDING(sentence, async.parse(sentence)));
+        if (window.size() < 4*threads) continue;
+        show_result(window.front().first, window.front().second.get(), verbosity, out);
+        window.pop_front();
+    }
+    for (auto p = window.begin(); p != window.end(); ++p)
+    {
+        show_result(p->first, p->second.get(), verbosity, out);
+    }
+}
+
+/// parses all sentences of @p reader, on @p threads threads if > 0
+template <typename PARSER, typename READER>
+void parse_corpus(PARSER& parser, READER& reader, unsigned threads, int verbosity,
+                  sost& out, const ChartOutput<PARSER>* charts=nullptr)
+{
+    // charts are only kept by the sequential parser
+    if (threads > 0 && !(charts && charts->any()))
+    {
+        parse_parallel(parser, reader, threads, verbosity, out);
+        return;
+    }
+    typename READER::Sentence sentence;
+    while (reader.next(sentence))
+    {
+        parse_sentence(parser, sentence, verbosity, out, charts);
+    }
+}
+
+#ifdef UNIXLIKE
+/// set by SIGINT and SIGTERM to stop the daemon
+volatile sig_atomic_t stop_daemon = 0;
+/// set by SIGHUP to make the daemon reload its grammar
+volatile sig_atomic_t reload_daemon = 0;
+
+extern "C" void on_stop_signal(int)
+{
+    stop_daemon = 1;
+}
+
+extern "C" void on_reload_signal(int)
+{
+    reload_daemon = 1;
+}
+
+/**
+ * @brief sends all sentences of @p reader to the daemon on @p client and
+ *        the results to @p out in input order. Up to a window of sentences
+ *        is sent before waiting for results, so the daemon can batch them.
+ */
+template <typename READER>
+void parse_remote(Earley::DaemonClient& client, READER& reader,
+                  int verbosity, sost& out, const string& grammar="")
+{
+    typedef typename READER::Sentence SENTENCE;
+
+    const std::uint32_t window = 64;
+    std::deque<SENTENCE> sentences;        // sent, result not shown yet
+    std::map<std::uint32_t, bool> results; // received, not shown yet
+    std::uint32_t first = 0;               // id of sentences.front()
+    SENTENCE sentence;
+    bool more = true;
+    while (more || !sentences.empty())
+    {
+        while (more && sentences.size() < window && (more = reader.next(sentence)))
+        {
+            if (!client.send(first + sentences.size(), sentence, grammar))
+            {
+                throw std::runtime_error("connection to daemon lost");
+            }
+            sentences.push_back(sentence);
+        }
+        if (sentences.empty()) break;
+        std::uint32_t id;
+        bool accepted;
+        client.receive(id, accepted);
+        results[id] = accepted;
+        for (auto r = results.begin(); r != results.end() && r->first == first;
+             r = results.erase(r), ++first)
+        {
+            show_result(sentences.front(), r->second, verbosity, out);
+            sentences.pop_front();
+        }
+    }
+}
+#endif
+
+
+/**
+ * @brief adds rules to and removes rules from grammar @p g as listed in
+ *        file @p path, see CompiledGrammar::edit(), and reports the changes
+ *        as those of grammar @p name
+ * @throws LoadError if the file cannot be read or is malformed
+ */
+template <typename GRAMMAR>
+void edit_rules(GRAMMAR& g, const string& path, const string& name="")
+{
+    auto t1 = std::chrono::steady_clock::now();
+    Earley::RuleEdits counts = g.edit(path);
+    auto t2 = std::chrono::steady_clock::now();
+    cerr << "rule edits" << (name.size() > 0 ? " of '"+name+"'" : "") << ": "
+         << counts.added << " added, " << counts.removed << " removed, "
+         << counts.unchanged << " unchanged in "
+         << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
+         << " milliseconds\n";
+}
+
+
+/**
+ * @brief factors the features out of the categories of grammar @p g, for
+ *        the tags of @p lexicon, and reports the numbers of rules and
+ *        categories before and after
+ */
+template <typename GRAMMAR, typename LEXICON>
+void factor_categories(GRAMMAR& g, LEXICON& lexicon)
+{
+    auto t1 = std::chrono::steady_clock::now();
+    Earley::FactorCounts counts = g.factor(lexicon);
+    auto t2 = std::chrono::steady_clock::now();
+    cerr << "factored " << counts.rules << " rules over " << counts.categories
+         << " categories into " << counts.factored << " rules over " << counts.bases
+         << " categories in "
+         << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
+         << " milliseconds\n";
+}
+
+
+/**
+ * @brief optimizes the rules of grammar @p g, for the tags of @p lexicon,
+ *        and reports the numbers of rules and categories before and after
+ */
+template <typename GRAMMAR, typename LEXICON>
+void optimize_rules(GRAMMAR& g, const LEXICON& lexicon)
+{
+    auto t1 = std::chrono::steady_clock::now();
+    Earley::OptimizeCounts counts = g.optimize(lexicon);
+    auto t2 = std::chrono::steady_clock::now();
+    cerr << "optimized " << counts.rules << " rules over " << counts.categories
+         << " categories into " << counts.optimized << " rules over " << counts.remaining
+         << " categories in "
+         << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
+         << " milliseconds: " << counts.useless << " useless rules dropped, "
+         << counts.collapsed << " unary rules collapsed, " << counts.prefixes
+         << " shared prefixes added\n";
+}
+
+
+/**
+ * @brief compiles a grammar file into a grammar image, a words file into
+ *        a lexicon image or a text corpus into a binary corpus; the
+ *        arguments are those following 'compile' on the command line
+ */
+int compile(int argc, char* argv[])
+{
+    typedef string                                 ES;
+    typedef long                                   IS;
+    typedef Earley::CompiledGrammar<IS, ES>        COMPILED;
+    typedef Earley::Lexicon<IS, ES>                LEXICON;
+    typedef Earley::BinaryCorpus<LEXICON>          CORPUS;
+
+    string grammar_path, word_path, image_path, corpus_path, edit_path;
+    int option;
+    while ((option = getopt(argc, argv, "f:g:w:o:e:")) != -1)
+    {
+        switch (option) {
+            case 'e':
+                if (edit_path.size() > 0) usage();
+                edit_path = optarg;
+                break;
+
+            case 'f':
+                if (corpus_path.size() > 0) usage();
+                corpus_path = optarg;
+                break;
+
+            case 'g':
+                if (grammar_path.size() > 0) usage();
+                grammar_path = optarg;
+                break;
+
+            case 'w':
+                if (word_path.size() > 0) usage();
+                word_path = optarg;
+                break;
+
+            case 'o':
+                if (image_path.size() > 0) usage();
+                image_path = optarg;
+                break;
+
+            default:
+                usage();
+                break;
+        }
+    }
+    if ((grammar_path.size() > 0) == (word_path.size() > 0) ||
+        (corpus_path.size() > 0 && word_path.size() == 0) ||
+        (edit_path.size() > 0 && grammar_path.size() == 0) ||
+        image_path.size() == 0 || optind != argc) usage();
+
+    try
+    {
+        auto t1 = std::chrono::steady_clock::now();
+        if (grammar_path.size() > 0)
+        {
+            unique_ptr<COMPILED> g = COMPILED::load(grammar_path);
+            if (edit_path.size() > 0) edit_rules(*g, edit_path);
+            g->save(image_path);
+            cerr << "compiled " << g->rule_count() << " rules over "
+                 << g->symbol_count() << " symbols";
+        }
+        else if (corpus_path.size() > 0)
+        {
+            // the tokens are only looked up, so the tags can be translated
+            // by a grammar that has nothing but its start rule
+            COMPILED::RuleTable t;
+            #if SOVERLOAD
+            t.symbols = { "", "$", "S" };
+            t.start = { 1, 1, 2 };
+            #else
+            t.symbols = { "$", "S" };
+            t.start = { 0, 1, 1 };
+            #endif
+            COMPILED g(t);
+            LEXICON lexicon;
+            lexicon.load_words(word_path, g);
+            cerr << "converted " << CORPUS::convert(corpus_path, lexicon, image_path)
+                 << " sentences";
+        }
+        else
+        {
+            ifstream wordfile(word_path);
+            if (!wordfile.is_open()) failed_to_open(word_path);
+            cerr << "compiled " << LEXICON::compile(wordfile, image_path) << " words";
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        cerr << " into '" << image_path << "' in "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
+             << " milliseconds\n";
+    }
+    catch (const std::exception& e)
+    {
+        msg("error:", e.what(), __FILE__, __LINE__);
+        exit(1);
+    }
+    return 0;
+}
+
+
+/**
+ * @brief writes the tables of a grammar and its tags as C++ header, for a
+ *        binary with the grammar built in; the arguments are those
+ *        following 'generate' on the command line
+ */
+int generate(int argc, char* argv[])
+{
+    typedef string                                 ES;
+    typedef long                                   IS;
+    typedef Earley::CompiledGrammar<IS, ES>        COMPILED;
+    typedef Earley::Lexicon<IS, ES>                LEXICON;
+
+    string grammar_path, tag_path, name, header_path;
+    int option;
+    while ((option = getopt(argc, argv, "g:t:n:o:")) != -1)
+    {
+        switch (option) {
+            case 'g':
+                if (grammar_path.size() > 0) usage();
+                grammar_path = optarg;
+                break;
+
+            case 't':
+                if (tag_path.size() > 0) usage();
+                tag_path = optarg;
+                break;
+
+            case 'n':
+                if (name.size() > 0) usage();
+                name = optarg;
+                break;
+
+            case 'o':
+                if (header_path.size() > 0) usage();
+                header_path = optarg;
+                break;
+
+            default:
+                usage();
+                break;
+        }
+    }
+    if (grammar_path.size() == 0 || tag_path.size() == 0 || header_path.size() == 0 ||
+        optind != argc) usage();
+    bool identifier = name.size() > 0 && !isdigit((unsigned char)name[0]);
+    for (auto c = name.begin(); c != name.end(); ++c)
+    {
+        if (!isalnum((unsigned char)*c) && *c != '_') identifier = false;
+    }
+    if (!identifier)
+    {
+        helper::msg("error:","the name of the grammar must be a C++ identifier\n");
+        exit(1);
+    }
+
+    try
+    {
+        auto t1 = std::chrono::steady_clock::now();
+        unique_ptr<COMPILED> g = COMPILED::load(grammar_path);
+        ifstream tagfile(tag_path);
+        if (!tagfile.is_open()) failed_to_open(tag_path);
+        LEXICON lexicon;
+        lexicon.load_tags(tagfile, *g);
+        ofstream header(header_path, std::ios::trunc);
+        Earley::generate_grammar(*g, lexicon, name, grammar_path+" and "+tag_path, header);
+        header.close();
+        if (!header) throw std::runtime_error("failed to write '"+header_path+"'");
+        auto t2 = std::chrono::steady_clock::now();
+        cerr << "generated " << g->rule_count() << " rules over " << g->symbol_count()
+             << " symbols into '" << header_path << "' in "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(t2-t1).count()
+             << " milliseconds\n";
+    }
+    catch (const std::exception& e)
+    {
+        msg("error:", e.what(), __FILE__, __LINE__);
+        exit(1);
+    }
+    return 0;
+}
+
 
 int main(int argc, char* argv[])
 {
+    // 'compile' takes its own options
+    if (argc > 1 && string(argv[1]) == "compile")
+    {
+        return compile(argc-1, argv+1);
+    }
+    if (argc > 1 && string(argv[1]) == "generate")
+    {
+        return generate(argc-1, argv+1);
+    }
 
     int verbosity = 0;
 
@@ -95,10 +614,8 @@ int main(int argc, char* argv[])
     ifstream NTfile; // stream with all non-terminals
     ifstream tagfile; // stream with tags
     ifstream wordfile; // stream with words and tags
-    ifstream inputstream; // input stream to parse
+    string input_path; // file to parse, mapped into memory
     string inputstring; // string with words to parse
-    vector<string> sentence; // vector of tokens to parse
-    vector<vector<string>> sentences; // vector with all sentences to parse
 
     int option;
     int iflag = 0;
@@ -106,6 +623,26 @@ int main(int argc, char* argv[])
     int tflag = 0;
     int wflag = 0;
     int vflag = 0;
+    int jflag = 0;
+    int xflag = 0;
+    int bflag = 0;
+    Earley::ChartFormat chart_format = Earley::ChartFormat::text;
+    long first_cell = 0, last_cell = -1; // cells of the charts to show
+    svec_s categories; // categories of the chart items to show
+    vector<pair<string, string>> edits; // rule edits files by grammar name
+    string grammar_name; // parse with the grammar variant of this name, if set
+    bool factor = false; // whether to factor the features out of the categories
+    bool optimize = false; // whether to optimize the rules
+    string cache_path; // load and save the result cache here, if set
+    unsigned long prefix_mb = 0; // megabytes of chart cells to reuse, if > 0
+    string dump_path; // write the charts to this chart dump, if set
+    long dump_ms = 0; // dump only charts of sentences taking this long
+    unsigned threads = 0; // parse in parallel on this many threads, if > 0
+    string daemon_socket; // serve requests on this socket, if set
+    string client_socket; // send input to the daemon on this socket, if set
+    bool query_stats = false; // whether to show the counters of the daemon
+    bool query_reload = false; // whether to make the daemon reload
+    string grammar_path, tag_path, word_path; // reread by the daemon on reload
 
     // show help if only -h is passed
     if (argc == 2)
@@ -122,16 +659,34 @@ int main(int argc, char* argv[])
                     break;
             }
     }
-    else if (argc >= 7 && argc < 12)
+    else if (argc >= 3 && argc < 64)
     {
-        while ((option = getopt(argc, argv, "f:s:g:n:t:w:v:")) != -1)
+        while ((option = getopt(argc, argv, "f:s:g:n:t:w:v:j:a:p:e:d:c:qrx:y:k:b:m:FO")) != -1)
         {
             switch (option) {
+                case 'd':
+                    if (daemon_socket.size() > 0 || client_socket.size() > 0) usage();
+                    daemon_socket = optarg;
+                    break;
+
+                case 'c':
+                    if (daemon_socket.size() > 0 || client_socket.size() > 0) usage();
+                    client_socket = optarg;
+                    break;
+
+                case 'q':
+                    query_stats = true;
+                    break;
+
+                case 'r':
+                    query_reload = true;
+                    break;
+
                 case 'f':
                     if (!iflag)
                     {
-                        inputstream.open(optarg, std::ifstream::in);
-                        if (!inputstream.is_open()) failed_to_open(optarg);
+                        if (!ifstream(optarg).is_open()) failed_to_open(optarg);
+                        input_path = optarg;
                     }
                     else { input_error(); }
                     iflag++;
@@ -148,6 +703,7 @@ int main(int argc, char* argv[])
                     {
                         grammarfile.open(optarg, std::ifstream::in);
                         if (!grammarfile.is_open()) failed_to_open(optarg);
+                        grammar_path = optarg;
                     }
                     else
                     {
@@ -162,6 +718,7 @@ int main(int argc, char* argv[])
                     {
                         tagfile.open(optarg, std::ifstream::in);
                         if (!tagfile.is_open()) failed_to_open(optarg);
+                        tag_path = optarg;
                     }
                     else
                     {
@@ -176,6 +733,7 @@ int main(int argc, char* argv[])
                     {
                         wordfile.open(optarg, std::ifstream::in);
                         if (!wordfile.is_open()) failed_to_open(optarg);
+                        word_path = optarg;
                     }
                     else
                     {
@@ -195,153 +753,407 @@ int main(int argc, char* argv[])
                     vflag++;
                     break;
 
+                case 'j':
+                    if (!jflag) threads = atoi(optarg);
+                    else
+                    {
+                        helper::msg("error:","thread count already specified");
+                        exit(1);
+                    }
+                    jflag++;
+                    break;
+
+                case 'a':
+                    if (cache_path.size() > 0) usage();
+                    cache_path = optarg;
+                    break;
+
+                case 'p':
+                    if (prefix_mb > 0 || atol(optarg) <= 0) usage();
+                    prefix_mb = atol(optarg);
+                    break;
+
+                case 'e':
+                {
+                    // "<name>=<rule edits>" changes the variant <name>,
+                    // unless a file of that name exists
+                    string e = optarg;
+                    size_t eq = e.find('=');
+                    if (eq != string::npos && eq > 0 && !ifstream(e).good())
+                    {
+                        edits.push_back(make_pair(e.substr(0, eq), e.substr(eq+1)));
+                    }
+                    else edits.push_back(make_pair(string(), e));
+                    if (!ifstream(edits.back().second).good()) failed_to_open(edits.back().second);
+                    break;
+                }
+
+                case 'n':
+                    if (grammar_name.size() > 0) usage();
+                    grammar_name = optarg;
+                    break;
+
+                case 'F':
+                    factor = true;
+                    break;
+
+                case 'O':
+                    optimize = true;
+                    break;
+
+                case 'x':
+                    if (xflag || !Earley::parse_chart_format(optarg, chart_format)) usage();
+                    xflag++;
+                    break;
+
+                case 'y':
+                    if (sscanf(optarg, "%ld:%ld", &first_cell, &last_cell) < 1 ||
+                        first_cell < 0 || (last_cell >= 0 && last_cell < first_cell))
+                    {
+                        helper::msg("error:","malformed cell range '"+string(optarg)+"'\n");
+                        exit(1);
+                    }
+                    xflag++;
+                    break;
+
+                case 'k':
+                    helper::for_each_token(optarg, strlen(optarg), CharDelim(','),
+                                           [&categories](const StrView& c)
+                    {
+                        categories.push_back(c.str());
+                    });
+                    xflag++;
+                    break;
+
+                case 'b':
+                    if (dump_path.size() > 0) usage();
+                    dump_path = optarg;
+                    bflag++;
+                    break;
+
+                case 'm':
+                    dump_ms = atol(optarg);
+                    bflag++;
+                    break;
+
                 default:
                     usage();
                     break;
             }
         }
-        // tokenise input string
-        if (inputstring.size() > 0)
+        // a client needs no grammar, everyone else needs all three files
+        if (client_socket.size() > 0)
         {
-            sentence = helper::tokenise(inputstring);
-            // append sentence to sentences
-            sentences.push_back(sentence);
+            if (gflag || tflag || wflag || jflag || xflag || bflag) usage();
         }
-        // tokenise input stream
-        else if (inputstream.is_open())
-        {
-            string line;
-            while(getline(inputstream, line))
-            {
-                svec_s line_tokens = helper::tokenise(line);
-                // append line tokens to vector of tokens of single sentence
-                sentence.insert(sentence.end(), line_tokens.begin(), line_tokens.end());
-                if (line.size() == 0)
-                {
-                    // append sentence to sentences
-                    sentences.push_back(sentence);
-                    sentence.clear();
-                }
-            }
-            sentences.push_back(sentence);
-        }
-        #ifdef _WIN32
-        else if (!_isatty(_fileno(stdin)))
+        #ifdef BUILTIN_GRAMMAR
+        else if (gflag || !(tflag && wflag) || query_stats || query_reload) usage();
         #else
-        else if (!isatty(STDIN_FILENO))
+        else if (!(gflag && tflag && wflag) || query_stats || query_reload) usage();
         #endif
+        if (query_stats && query_reload) usage();
+        if (bflag && dump_path.size() == 0) usage();
+        // the daemon reads requests from its socket only
+        if (daemon_socket.size() > 0 && (iflag || vflag || xflag || bflag)) usage();
+        // a built-in grammar keeps its rules and has no variants. The
+        // daemon serves the variants it has been started with
+        #ifdef BUILTIN_GRAMMAR
+        if (edits.size() > 0 || grammar_name.size() > 0 || factor || optimize) usage();
+        #endif
+        // a factored or optimized grammar has no variants
+        if ((factor || optimize) && (grammar_name.size() > 0 || daemon_socket.size() > 0 ||
+                                     client_socket.size() > 0)) usage();
+        if (factor && optimize) usage();
+        if (edits.size() > 0 && client_socket.size() > 0) usage();
+        if (grammar_name.size() > 0 && daemon_socket.size() > 0) usage();
+        if (grammar_name.size() > 0 && client_socket.size() == 0 &&
+            none_of(edits.begin(), edits.end(), [&grammar_name](const pair<string, string>& e)
+            {
+                return e.first == grammar_name;
+            }))
         {
-            string line;
-            while(getline(cin, line))
+            helper::msg("error:","no rule edits for grammar '"+grammar_name+"'; see -e\n");
+            exit(1);
+        }
+        // cached results come without charts
+        if (prefix_mb > 0 && (daemon_socket.size() > 0 || client_socket.size() > 0)) usage();
+        if (cache_path.size() > 0 &&
+            (daemon_socket.size() > 0 || client_socket.size() > 0 ||
+             verbosity > 2 || xflag || bflag)) usage();
+
+        // without input string or file, input is read from stdin, unless
+        // stdin is a terminal. Input is read sentence by sentence once the
+        // grammar has been loaded
+        if (daemon_socket.size() == 0 && !query_stats && !query_reload &&
+            inputstring.size() == 0 && input_path.size() == 0)
+        {
+            #ifdef _WIN32
+            if (_isatty(_fileno(stdin))) usage();
+            #else
+            if (isatty(STDIN_FILENO)) usage();
+            #endif
+        }
+    }
+    // arg count doesn't match
+    else usage();
+
+    #ifndef UNIXLIKE
+    if (daemon_socket.size() > 0 || client_socket.size() > 0)
+    {
+        helper::msg("error:","daemon and client require a Unix-like system\n");
+        exit(1);
+    }
+    #else
+    // in client mode, the daemon does all the parsing
+    if (client_socket.size() > 0)
+    {
+        IO::BufferedOut out;
+        try
+        {
+            Earley::DaemonClient client(client_socket);
+            if (query_stats) out << client.stats();
+            else if (query_reload) out << client.reload();
+            else if (inputstring.size() > 0)
+            {
+                std::istringstream is(inputstring);
+                IO::SentenceReader reader(is);
+                parse_remote(client, reader, verbosity, out, grammar_name);
+            }
+            else if (input_path.size() > 0)
             {
-                cout << line << endl;
-                svec_s line_tokens = helper::tokenise(line);
-                // append line tokens to vector of tokens of single sentence
-                sentence.insert(sentence.end(), line_tokens.begin(), line_tokens.end());
-                if (line.size() == 0)
+                if (Earley::BinaryCorpus<Earley::Lexicon<long, string>>::is_corpus(input_path))
                 {
-                    // append sentence to sentences
-                    sentences.push_back(sentence);
-                    sentence.clear();
+                    throw std::runtime_error("'"+input_path+"' is a binary corpus; "
+                                             "pass the text to the daemon");
                 }
+                IO::CorpusReader reader(input_path);
+                parse_remote(client, reader, verbosity, out, grammar_name);
+            }
+            else
+            {
+                IO::SentenceReader reader(cin, &out);
+                parse_remote(client, reader, verbosity, out, grammar_name);
             }
-            sentences.push_back(sentence);
         }
-        // arg count matches, but no input to parse
-        else usage();
+        catch (const std::exception& e)
+        {
+            out.flush();
+            msg("error:", e.what(), __FILE__, __LINE__);
+            exit(1);
+        }
+        out.flush();
+        return 0;
     }
-    // arg count doesn't match
-    else usage();
+    #endif
 
 
+    #ifdef BUILTIN_GRAMMAR
+    typedef Earley::Generated::BUILTIN_GRAMMAR::Grammar GRAMMAR;
+    #else
     typedef string                                 ES;
     typedef long                                   IS;
-    typedef Earley::CFGRuleParser<IS, ES>          RP;
-    typedef Earley::CFGValidator<RP::ES>           V;
-    typedef Earley::Grammar<V, RP>                 GRAMMAR;
+    typedef Earley::CompiledGrammar<IS, ES>        GRAMMAR;
+    #endif
     typedef Earley::EarleyParser<GRAMMAR>          PARSER;
 
-    // create grammar instance
-    GRAMMAR g(grammarfile);
-
-    set<IS> tag_set; // stores tags as IDs of type IS
+    typedef PARSER::Lexicon                        LEXICON;
 
-    // build a set of tags
-    string line;
-    while(getline(tagfile, line))
+    #ifdef UNIXLIKE
+    // in daemon mode, the grammar stays loaded until the process is stopped.
+    // It is held by a snapshot store, so that it can be reloaded
+    if (daemon_socket.size() > 0)
     {
-        if (line.size() == 0) continue;
-        svec_s tokens = tokenise(line);
-        if (tokens.size() != 1)
+        signal(SIGINT, on_stop_signal);
+        signal(SIGTERM, on_stop_signal);
+        signal(SIGHUP, on_reload_signal);
+        try
+        {
+            Earley::SnapshotStore<PARSER> store(grammar_path, tag_path, word_path, edits);
+            Earley::Daemon<PARSER> daemon(store, threads);
+            daemon.serve(daemon_socket, &stop_daemon, &reload_daemon);
+        }
+        catch (const std::exception& e)
         {
-            msg("error:", "'"+to_string(line)+"' in tags file. Invalid format",
-                __FILE__, __LINE__);
+            msg("error:", e.what(), __FILE__, __LINE__);
             exit(1);
         }
-
-        tag_set.insert(g.translate(line));
+        return 0;
     }
-
-
-    map<IS, unordered_set<ES>> TagID_Words_Map; // mapps tag IDs (which have type IS) to sets of words
-
-    // if overloaded symbols are enabled, make a lexicon of all words
-    #if SOVERLOAD
-    set<IS> lexicon;
     #endif
 
-    // build a map from tags to sets of words
-    while(getline(wordfile, line))
+    // load the grammar, compiling it unless it is a grammar image, and load
+    // tags and words
+    shared_ptr<GRAMMAR> g;
+    shared_ptr<LEXICON> lexicon(new LEXICON);
+    try
     {
-        if (line.size() == 0) continue;
-        svec_s tokens = tokenise(line);
-        if (tokens.size() < 2)
+        g = GRAMMAR::load(grammar_path);
+        // rules are changed before the tags and words are translated, so
+        // that these stay apart from the compiled symbols
+        #ifndef BUILTIN_GRAMMAR
+        for (auto e = edits.begin(); e != edits.end(); ++e)
         {
-            msg("error:", "'"+to_string(line)+"' in words file. Invalid format",
-                __FILE__, __LINE__);
-            exit(1);
+            if (e->first.empty()) edit_rules(*g, e->second);
         }
-        sstr nl_string;
-        for (auto i = tokens.begin(); i != tokens.end()-1; ++i)
+        #endif
+        lexicon->load_tags(tagfile, *g);
+        lexicon->load_words(word_path, *g);
+        // the features are factored out, or the rules optimized, for the
+        // tags of the lexicon
+        #ifndef BUILTIN_GRAMMAR
+        if (factor) factor_categories(*g, *lexicon);
+        if (optimize) optimize_rules(*g, *lexicon);
+        #endif
+        // with -n, the variant of that name is parsed with; it translates
+        // symbols through the grammar, so the lexicon serves it as well
+        #ifndef BUILTIN_GRAMMAR
+        if (grammar_name.size() > 0)
         {
-            nl_string += *i;
-            if (!(i+1 == tokens.end()-1)) nl_string += " ";
+            g = GRAMMAR::variant(g);
+            for (auto e = edits.begin(); e != edits.end(); ++e)
+            {
+                if (e->first == grammar_name) edit_rules(*g, e->second, grammar_name);
+            }
         }
-        // translate the tag into an ID of type IS
-        IS tagID = g.translate(*(tokens.end()-1));
-
-        TagID_Words_Map[tagID].insert(nl_string);
-
-        #if SOVERLOAD
-        lexicon.insert(g.translate(nl_string));
         #endif
     }
+    catch (const Earley::LoadError& e)
+    {
+        msg("error:", e.what(), __FILE__, __LINE__);
+        exit(1);
+    }
 
-    #if SOVERLOAD
-    g.inject_lexicon(lexicon);
-    #endif
+    // create a parser instance
+    PARSER parser(*g, lexicon);
 
+    // all output goes through one large buffer
+    IO::BufferedOut out;
 
-    // create a parser instance
-    PARSER parser(g, tag_set, TagID_Words_Map);
+    // charts are shown at verbosity 3 or with a chart option; symbol names
+    // stay cached from sentence to sentence
+    unique_ptr<PARSER::Exporter> exporter;
+    unique_ptr<PARSER::DumpWriter> dump;
+    ChartOutput<PARSER> charts;
+    if (verbosity > 2 || xflag)
+    {
+        exporter.reset(new PARSER::Exporter(*g, out, chart_format));
+        exporter->set_cells(first_cell, last_cell);
+        for (auto c = categories.begin(); c != categories.end(); ++c) exporter->add_category(*c);
+        charts.exporter = exporter.get();
+    }
+    if (dump_path.size() > 0)
+    {
+        try
+        {
+            dump.reset(new PARSER::DumpWriter(dump_path, *g));
+        }
+        catch (const std::runtime_error& e)
+        {
+            msg("error:", e.what(), __FILE__, __LINE__);
+            exit(1);
+        }
+        charts.dump = dump.get();
+        charts.dump_ms = dump_ms;
+    }
 
-    // parse all sentences
-    for (auto s = sentences.begin(); s != sentences.end(); ++s)
+    // unless charts are needed, the results are cached by the ambiguity
+    // classes of the words; with -a from run to run. A cache that does not
+    // fit the grammar and the lexicon is replaced
+    Earley::ResultCache cache;
+    std::uint64_t fingerprint = 0;
+    if (!charts.any())
     {
-        if (verbosity > 1)
+        parser.set_cache(&cache);
+    }
+    if (cache_path.size() > 0)
+    {
+        fingerprint = Earley::ResultCache::fingerprint(*g, *lexicon);
+        if (ifstream(cache_path).good())
         {
-            cout << "'" << helper::to_string(*s) << "'\n";
+            try
+            {
+                cache.load(cache_path, fingerprint);
+            }
+            catch (const Earley::LoadError& e)
+            {
+                msg("warning:", string(e.what())+"; starting with an empty cache\n");
+            }
         }
+    }
 
-        bool p = parser.parse(*s);
+    // with -p, sentences resume after the cells of a prefix parsed before
+    unique_ptr<PARSER::Prefixes> prefixes;
+    if (prefix_mb > 0)
+    {
+        prefixes.reset(new PARSER::Prefixes(prefix_mb << 20));
+        parser.set_prefix_cache(prefixes.get());
+    }
 
-        if (verbosity > 2) parser.show_chart();
-        if (verbosity > 1)
+    // parse sentences as soon as they have been read, so memory use does
+    // not depend on the size of the input
+    if (inputstring.size() > 0)
+    {
+        parse_sentence(parser, helper::tokenise(inputstring), verbosity, out, &charts);
+    }
+    else if (input_path.size() > 0)
+    {
+        // the input file is mapped, its tokens are parsed where they are.
+        // Those of a binary corpus have been looked up in the lexicon too
+        std::unique_ptr<IO::CorpusReader> reader;
+        std::unique_ptr<PARSER::Corpus> corpus;
+        try
         {
-            if(p) std::cout << "parse complete, input recognised.\n\n";
-            else std::cout << "parse incomplete, input not recognised.\n\n";
+            if (PARSER::Corpus::is_corpus(input_path))
+            {
+                corpus.reset(new PARSER::Corpus(input_path, *lexicon));
+            }
+            else reader.reset(new IO::CorpusReader(input_path));
+        }
+        catch (const Earley::LoadError& e)
+        {
+            msg("error:", e.what(), __FILE__, __LINE__);
+            exit(1);
+        }
+        if (corpus) parse_corpus(parser, *corpus, threads, verbosity, out, &charts);
+        else parse_corpus(parser, *reader, threads, verbosity, out, &charts);
+    }
+    else
+    {
+        // lines read from stdin are echoed
+        IO::SentenceReader reader(cin, &out);
+        parse_corpus(parser, reader, threads, verbosity, out, &charts);
+    }
+    out.flush();
+    if (cache_path.size() > 0)
+    {
+        try
+        {
+            cache.save(cache_path, fingerprint);
+        }
+        catch (const std::runtime_error& e)
+        {
+            msg("error:", e.what(), __FILE__, __LINE__);
+            exit(1);
+        }
+        cerr << "result cache: " << cache.hits() << " hits, " << cache.misses()
+             << " misses, " << cache.size() << " results in '" << cache_path << "'\n";
+    }
+    if (prefixes)
+    {
+        cerr << "prefix cache: " << prefixes->reused() << " cells reused, "
+             << prefixes->stored() << " cells stored, "
+             << (prefixes->size() >> 20) << " MB held\n";
+    }
+    if (dump)
+    {
+        try
+        {
+            dump->close();
+        }
+        catch (const std::runtime_error& e)
+        {
+            msg("error:", e.what(), __FILE__, __LINE__);
+            exit(1);
         }
-        else if (verbosity > 0) std::cout << p << std::endl;
     }
-
 }